@@ -0,0 +1,222 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2008-2020 YAMAMOTO Naoki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#define API_INTERNAL
+#include "common.h"
+#include "arena.h"
+
+/*
+ * 領域をブロック単位にまとめて確保するアリーナの関数群です。
+ * スレッドセーフではありません。
+ *
+ * 確保した領域は個別に解放せずに、アリーナの終了時にブロック単位で
+ * まとめて解放します。ブロックはゼロで初期化されて再利用されないため、
+ * arena_alloc() で確保した領域はゼロで初期化されています。
+ */
+
+#define ARENA_DEFAULT_BLOCK_SIZE    (1024*1024)
+
+struct arena_block_t {
+    struct arena_block_t* next;
+    void* align;                        /* データ部の境界調整 */
+};
+
+static struct arena_block_t* block_alloc(int size)
+{
+    return (struct arena_block_t*)calloc(1, sizeof(struct arena_block_t) + size);
+}
+
+/*
+ * アリーナの初期処理を行ないます。
+ *
+ * block_size: ブロックのバイト数(ゼロの場合は1MB)
+ *
+ * 戻り値
+ *  アリーナ構造体のポインタ
+ */
+APIEXPORT struct arena_t* arena_initialize(int block_size)
+{
+    struct arena_t* ar;
+
+    ar = (struct arena_t*)calloc(1, sizeof(struct arena_t));
+    if (ar == NULL) {
+        err_write("arena: No memory.");
+        return NULL;
+    }
+    ar->block_size = (block_size > 0)? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    return ar;
+}
+
+/*
+ * アリーナの使用を終了します。
+ * arena_alloc() で確保したすべての領域が解放されます。
+ *
+ * ar: アリーナ構造体のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void arena_finalize(struct arena_t* ar)
+{
+    struct arena_block_t* b;
+
+    if (ar == NULL)
+        return;
+
+    b = ar->block;
+    while (b) {
+        struct arena_block_t* next = b->next;
+        free(b);
+        b = next;
+    }
+    free(ar);
+}
+
+/*
+ * アリーナから領域を確保します。
+ * 領域はゼロで初期化されています。
+ * ブロックのサイズを超える場合はその領域だけのブロックを確保します。
+ *
+ * ar: アリーナ構造体のポインタ
+ * size: バイト数
+ *
+ * 戻り値
+ *  確保した領域のポインタを返します。
+ *  メモリが確保できない場合は NULL を返します。
+ */
+APIEXPORT void* arena_alloc(struct arena_t* ar, int size)
+{
+    void* p;
+
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (size > ar->block_remain) {
+        struct arena_block_t* b;
+
+        if (size > ar->block_size / 4) {
+            /* 大きな領域は専用のブロックにして使用中のブロックはそのまま使います。*/
+            b = block_alloc(size);
+            if (b == NULL) {
+                err_write("arena: No memory.");
+                return NULL;
+            }
+            if (ar->block) {
+                b->next = ar->block->next;
+                ar->block->next = b;
+            } else {
+                ar->block = b;
+            }
+            return b + 1;
+        }
+        b = block_alloc(ar->block_size);
+        if (b == NULL) {
+            err_write("arena: No memory.");
+            return NULL;
+        }
+        b->next = ar->block;
+        ar->block = b;
+        ar->block_ptr = (char*)(b + 1);
+        ar->block_remain = ar->block_size;
+    }
+    p = ar->block_ptr;
+    ar->block_ptr += size;
+    ar->block_remain -= size;
+    return p;
+}
+
+/*
+ * アリーナから確保したすべての領域を解放して、空の状態に戻します。
+ * 使用中のブロックは解放せずに次の arena_alloc() で再利用します。
+ * 確保済みの領域のポインタは無効になります。
+ *
+ * ar: アリーナ構造体のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void arena_reset(struct arena_t* ar)
+{
+    struct arena_block_t* keep = NULL;
+    struct arena_block_t* b;
+
+    b = ar->block;
+    if (b && ar->block_ptr) {
+        /* 使用中のブロックは使用した部分をゼロに戻して残します。*/
+        keep = b;
+        b = b->next;
+        memset(keep + 1, '\0', ar->block_size - ar->block_remain);
+        keep->next = NULL;
+    }
+    while (b) {
+        struct arena_block_t* next = b->next;
+        free(b);
+        b = next;
+    }
+    ar->block = keep;
+    if (keep) {
+        ar->block_ptr = (char*)(keep + 1);
+        ar->block_remain = ar->block_size;
+    } else {
+        ar->block_ptr = NULL;
+        ar->block_remain = 0;
+    }
+}
+
+/*
+ * アリーナのブロックをすべて別のアリーナに移します。
+ * 確保済みの領域のポインタはそのまま有効で、移動先のアリーナの終了時に
+ * 解放されます。移動元のアリーナは空になります。
+ *
+ * ar: 移動先のアリーナ構造体のポインタ
+ * src: 移動元のアリーナ構造体のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void arena_move(struct arena_t* ar, struct arena_t* src)
+{
+    struct arena_block_t* tail;
+
+    if (src->block == NULL)
+        return;
+
+    if (ar->block == NULL) {
+        ar->block = src->block;
+        ar->block_ptr = src->block_ptr;
+        ar->block_remain = src->block_remain;
+    } else {
+        /* 移動先の使用中のブロックの後ろに連結します。*/
+        for (tail = src->block; tail->next; tail = tail->next)
+            ;
+        tail->next = ar->block->next;
+        ar->block->next = src->block;
+    }
+    src->block = NULL;
+    src->block_ptr = NULL;
+    src->block_remain = 0;
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2008-2020 YAMAMOTO Naoki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include "apiexp.h"
+
+#define ARENA_ALIGN     8   /* 確保する領域の境界 */
+
+struct arena_block_t;
+
+struct arena_t {
+    int block_size;                     /* ブロックのバイト数 */
+    struct arena_block_t* block;        /* 確保したブロックのリスト(先頭が使用中) */
+    char* block_ptr;                    /* 使用中のブロックの空き位置 */
+    int block_remain;                   /* 使用中のブロックの残りバイト数 */
+};
+
+/* prototypes */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+APIEXPORT struct arena_t* arena_initialize(int block_size);
+APIEXPORT void arena_finalize(struct arena_t* ar);
+APIEXPORT void* arena_alloc(struct arena_t* ar, int size);
+APIEXPORT void arena_reset(struct arena_t* ar);
+APIEXPORT void arena_move(struct arena_t* ar, struct arena_t* src);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ARENA_H_ */
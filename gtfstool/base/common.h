@@ -231,6 +231,8 @@ struct response_t {
 #include "memutil.h"
 #include "hash.h"
 #include "vector.h"
+#include "intern.h"
+#include "arena.h"
 #include "syscall.h"
 #include "cgiutils.h"
 
@@ -46,4 +46,16 @@
 #define CS_DELETE(x)    pthread_mutex_destroy(x)
 #endif
 
+/* atomic macros (32bit integer)
+ * ATOMIC_STORE_RELEASE() より前の書き込みは、同じ値を ATOMIC_LOAD_ACQUIRE() で
+ * 読み込んだスレッドから参照できることが保証されます。
+ */
+#ifdef _WIN32
+#define ATOMIC_LOAD_ACQUIRE(p)      (unsigned int)InterlockedOr((volatile LONG*)(p), 0)
+#define ATOMIC_STORE_RELEASE(p, v)  InterlockedExchange((volatile LONG*)(p), (LONG)(v))
+#else
+#define ATOMIC_LOAD_ACQUIRE(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE_RELEASE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
 #endif  /* _INCLUDE_CSECT_ */
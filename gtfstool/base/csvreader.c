@@ -0,0 +1,448 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2008-2019 YAMAMOTO Naoki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#define API_INTERNAL
+#include "common.h"
+#include "csvreader.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CSV_SCAN_AVX2
+#define CSV_SCAN_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CSV_SCAN_SSE2
+#endif
+#if defined(CSV_SCAN_SSE2) && defined(_WIN32)
+#include <intrin.h>
+#endif
+
+/*
+ * RFC 4180 形式の CSV をバッファ上で一度だけ走査してフィールドに分割します。
+ *
+ * フィールドはバッファ内の位置と長さで表されるため、文字列のコピーは
+ * 行いません。引用符で囲まれたフィールド内のカンマ、改行、二重の引用符("")
+ * および CRLF の改行に対応しています。
+ * 引用符で囲まれていないフィールドは前後のホワイトスペース(0x20以下)を除きます。
+ *
+ * データを分割して供給する場合は csv_reader_stream_init() で初期化して
+ * csv_reader_feed() でデータを追加します。途中で切れているレコードは
+ * 次のデータが供給されるまで保留されます。
+ */
+
+#define INIT_FIELDS  32
+
+#ifdef CSV_SCAN_SSE2
+static int first_bit(unsigned int mask)
+{
+#ifdef _WIN32
+    unsigned long index;
+
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+/*
+ * p から endptr までの範囲で文字 c1 または c2 の位置を返します。
+ * 見つからない場合は endptr を返します。
+ *
+ * SSE2 では16バイト、AVX2 では32バイトずつ比較して一致した位置を
+ * ビットマスクで求めます。残りのバイトは1バイトずつ比較します。
+ * 区切り文字(カンマ、改行、引用符)は ASCII のため、0x80以上のバイトで
+ * 構成される UTF-8 のマルチバイト文字の途中に一致することはありません。
+ */
+static const char* find_char2(const char* p, const char* endptr, char c1, char c2)
+{
+#ifdef CSV_SCAN_SSE2
+    if (endptr - p >= 16) {
+        __m128i v1 = _mm_set1_epi8(c1);
+        __m128i v2 = _mm_set1_epi8(c2);
+        __m128i b;
+        unsigned int mask;
+
+        /* 短いフィールドが多いため最初の16バイトを先に調べます。*/
+        b = _mm_loadu_si128((const __m128i*)p);
+        mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(b, v1), _mm_cmpeq_epi8(b, v2)));
+        if (mask)
+            return p + first_bit(mask);
+        p += 16;
+#ifdef CSV_SCAN_AVX2
+        if (endptr - p >= 32) {
+            __m256i w1 = _mm256_set1_epi8(c1);
+            __m256i w2 = _mm256_set1_epi8(c2);
+
+            do {
+                __m256i w = _mm256_loadu_si256((const __m256i*)p);
+                mask = (unsigned int)_mm256_movemask_epi8(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(w, w1), _mm256_cmpeq_epi8(w, w2)));
+                if (mask)
+                    return p + first_bit(mask);
+                p += 32;
+            } while (endptr - p >= 32);
+        }
+#endif
+        while (endptr - p >= 16) {
+            b = _mm_loadu_si128((const __m128i*)p);
+            mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(b, v1), _mm_cmpeq_epi8(b, v2)));
+            if (mask)
+                return p + first_bit(mask);
+            p += 16;
+        }
+    }
+#endif
+    while (p < endptr && *p != c1 && *p != c2)
+        p++;
+    return p;
+}
+
+static int add_field(struct csv_reader_t* csv, const char* ptr, int len, int escaped)
+{
+    struct csv_field_t* fld;
+
+    if (csv->count >= csv->capacity) {
+        int n;
+
+        n = (csv->capacity > 0)? csv->capacity * 2 : INIT_FIELDS;
+        fld = (struct csv_field_t*)realloc(csv->fields, n * sizeof(struct csv_field_t));
+        if (fld == NULL) {
+            err_write("csv_read_record: no memory.");
+            return -1;
+        }
+        csv->fields = fld;
+        csv->capacity = n;
+    }
+    fld = &csv->fields[csv->count++];
+    fld->ptr = ptr;
+    fld->len = len;
+    fld->escaped = escaped;
+    return 0;
+}
+
+static int is_blank_line(const char* p, const char* endptr, int eof)
+{
+    while (p < endptr && *p != '\n') {
+        if ((unsigned char)*p > 0x20)
+            return 0;
+        p++;
+    }
+    /* 改行がない場合は後続のデータを待ちます。*/
+    return (p < endptr || eof);
+}
+
+/*
+ * CSV読み込み構造体を初期化します。
+ *
+ * csv: struct csv_reader_t のポインタ
+ * ptr: CSVデータのポインタ('\0'で終端されている必要はありません)
+ * size: CSVデータのバイト数
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void csv_reader_init(struct csv_reader_t* csv, const char* ptr, size_t size)
+{
+    memset(csv, '\0', sizeof(struct csv_reader_t));
+    csv->ptr = ptr;
+    csv->endptr = ptr + size;
+    csv->next_lineno = 1;
+    csv->eof = 1;
+}
+
+/*
+ * データを分割して供給するためにCSV読み込み構造体を初期化します。
+ * データは csv_reader_feed() で供給します。
+ *
+ * csv: struct csv_reader_t のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void csv_reader_stream_init(struct csv_reader_t* csv)
+{
+    memset(csv, '\0', sizeof(struct csv_reader_t));
+    csv->next_lineno = 1;
+}
+
+/*
+ * CSVデータを追加します。
+ * 未処理のデータ(途中で切れているレコード)はバッファの先頭に移動します。
+ * それまでに取得したフィールドのポインタは無効になります。
+ *
+ * csv: struct csv_reader_t のポインタ
+ * ptr: 追加するデータのポインタ
+ * size: 追加するデータのバイト数
+ *
+ * 戻り値
+ *  正常に追加された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+APIEXPORT int csv_reader_feed(struct csv_reader_t* csv, const char* ptr, size_t size)
+{
+    size_t remain = 0;
+    size_t need;
+
+    if (csv->ptr) {
+        remain = csv->endptr - csv->ptr;
+        if (remain > 0 && csv->ptr != csv->buf)
+            memmove(csv->buf, csv->ptr, remain);
+    }
+    need = remain + size;
+    if (need > csv->buf_capacity) {
+        char* tp;
+        size_t n;
+
+        n = (csv->buf_capacity * 2 > need)? csv->buf_capacity * 2 : need;
+        tp = (char*)realloc(csv->buf, n);
+        if (tp == NULL) {
+            err_write("csv_reader_feed: no memory.");
+            return -1;
+        }
+        csv->buf = tp;
+        csv->buf_capacity = n;
+    }
+    memcpy(csv->buf + remain, ptr, size);
+    csv->ptr = csv->buf;
+    csv->endptr = csv->buf + need;
+    return 0;
+}
+
+/*
+ * すべてのデータが供給されたことを設定します。
+ * 保留されていた最後のレコードが読み込めるようになります。
+ *
+ * csv: struct csv_reader_t のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void csv_reader_feed_end(struct csv_reader_t* csv)
+{
+    csv->eof = 1;
+}
+
+/*
+ * CSV読み込み構造体で確保した領域を解放します。
+ *
+ * csv: struct csv_reader_t のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void csv_reader_free(struct csv_reader_t* csv)
+{
+    if (csv->fields)
+        free(csv->fields);
+    if (csv->buf)
+        free(csv->buf);
+    csv->fields = NULL;
+    csv->buf = NULL;
+    csv->buf_capacity = 0;
+    csv->capacity = 0;
+    csv->count = 0;
+}
+
+/*
+ * 次のレコードを読み込んでフィールドに分割します。
+ * 空行(ホワイトスペースのみの行)は読み飛ばします。
+ *
+ * 分割されたフィールドは csv->fields に csv->count 個設定されます。
+ * レコードの開始行番号は csv->lineno に設定されます。
+ *
+ * csv: struct csv_reader_t のポインタ
+ *
+ * 戻り値
+ *  フィールド数を返します。
+ *  データの終わりの場合はゼロを返します。
+ *  分割して供給している場合はレコードが途中で切れているときもゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+APIEXPORT int csv_read_record(struct csv_reader_t* csv)
+{
+    const char* p = csv->ptr;
+    const char* endptr = csv->endptr;
+    int lines = 0;
+
+    /* 空行をスキップします。*/
+    while (p < endptr && is_blank_line(p, endptr, csv->eof)) {
+        while (p < endptr && *p != '\n')
+            p++;
+        if (p < endptr)
+            p++;
+        csv->next_lineno++;
+    }
+    csv->count = 0;
+    csv->ptr = p;
+    if (p >= endptr)
+        return 0;
+    csv->lineno = csv->next_lineno;
+    csv->rec_ptr = p;
+
+    while (1) {
+        const char* fptr;
+        int flen;
+        int escaped = 0;
+
+        /* 先頭のホワイトスペース */
+        while (p < endptr && *p != '\n' && *p != ',' && (unsigned char)*p <= 0x20)
+            p++;
+
+        if (p < endptr && *p == '"') {
+            const char* qp = p;
+            int lf = 0;
+
+            fptr = ++p;
+            while ((p = find_char2(p, endptr, '"', '\n')) < endptr) {
+                if (*p == '"') {
+                    if (p+1 < endptr && *(p+1) == '"') {
+                        escaped = 1;
+                        p += 2;
+                        continue;
+                    }
+                    break;
+                }
+                lf++;
+                p++;
+            }
+            flen = (int)(p - fptr);
+            if (p < endptr)
+                p++;    /* 閉じる引用符 */
+
+            /* 閉じる引用符の後のホワイトスペース */
+            while (p < endptr && *p != '\n' && *p != ',' && (unsigned char)*p <= 0x20)
+                p++;
+            if (p < endptr && *p != '\n' && *p != ',') {
+                /* 引用符の後に文字がある場合は引用符を含めてそのまま扱います。*/
+                p = find_char2(fptr, endptr, ',', '\n');
+                fptr = qp;
+                flen = (int)(p - fptr);
+                while (flen > 0 && (unsigned char)fptr[flen-1] <= 0x20)
+                    flen--;
+                escaped = 0;
+            } else {
+                lines += lf;
+            }
+        } else {
+            fptr = p;
+            p = find_char2(p, endptr, ',', '\n');
+            flen = (int)(p - fptr);
+            /* 末尾のホワイトスペース(CRを含む) */
+            while (flen > 0 && (unsigned char)fptr[flen-1] <= 0x20)
+                flen--;
+        }
+
+        if (add_field(csv, fptr, flen, escaped) < 0)
+            return -1;
+
+        if (p < endptr && *p == ',') {
+            p++;
+            continue;
+        }
+        break;
+    }
+
+    if (p >= endptr && ! csv->eof) {
+        /* レコードが途中で切れているため後続のデータを待ちます。*/
+        csv->ptr = csv->rec_ptr;
+        csv->count = 0;
+        return 0;
+    }
+    csv->rec_len = (int)(p - csv->rec_ptr);
+    if (p < endptr)
+        p++;    /* LF */
+    csv->ptr = p;
+    csv->next_lineno += lines + 1;
+    return csv->count;
+}
+
+/*
+ * フィールドの内容を '\0' で終端された文字列としてコピーします。
+ * 二重の引用符("")は一つの引用符に変換されます。
+ * バッファに収まらない場合は dst_size-1 バイトで切り詰められます。
+ *
+ * dst: コピー先のバッファ
+ * dst_size: コピー先のバッファサイズ
+ * fld: struct csv_field_t のポインタ
+ *
+ * 戻り値
+ *  変換後のフィールドのバイト数を返します(切り詰められる前のバイト数)。
+ */
+APIEXPORT int csv_field_copy(char* dst, int dst_size, const struct csv_field_t* fld)
+{
+    int n;
+
+    if (! fld->escaped) {
+        n = (fld->len < dst_size)? fld->len : dst_size - 1;
+        if (n < 0)
+            return fld->len;
+        memcpy(dst, fld->ptr, n);
+        dst[n] = '\0';
+        return fld->len;
+    } else {
+        const char* p = fld->ptr;
+        const char* endptr = fld->ptr + fld->len;
+        int len = 0;
+
+        n = 0;
+        while (p < endptr) {
+            if (*p == '"' && p+1 < endptr && *(p+1) == '"')
+                p++;
+            if (n < dst_size - 1)
+                dst[n++] = *p;
+            len++;
+            p++;
+        }
+        if (dst_size > 0)
+            dst[n] = '\0';
+        return len;
+    }
+}
+
+/*
+ * フィールドの内容と文字列を大文字小文字を区別せずに比較します。
+ *
+ * fld: struct csv_field_t のポインタ
+ * str: 比較する文字列
+ *
+ * 戻り値
+ *  一致した場合はゼロを返します。
+ */
+APIEXPORT int csv_field_icmp(const struct csv_field_t* fld, const char* str)
+{
+    int len;
+
+    len = (int)strlen(str);
+    if (fld->len != len || fld->escaped)
+        return -1;
+    return strnicmp(fld->ptr, str, len);
+}
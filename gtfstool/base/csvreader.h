@@ -0,0 +1,70 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2008-2019 YAMAMOTO Naoki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _CSVREADER_H_
+#define _CSVREADER_H_
+
+#include "apiexp.h"
+
+/* フィールド(バッファ内の位置と長さ) */
+struct csv_field_t {
+    const char* ptr;            /* フィールドの先頭(囲みの引用符は含まない) */
+    int len;                    /* フィールドのバイト数 */
+    int escaped;                /* 二重の引用符("")を含む場合は 1 */
+};
+
+struct csv_reader_t {
+    const char* ptr;            /* 次に解析する位置 */
+    const char* endptr;         /* バッファの終端 */
+    int next_lineno;            /* 次のレコードの開始行番号 */
+    int lineno;                 /* 現在のレコードの開始行番号(1〜) */
+    const char* rec_ptr;        /* 現在のレコードの先頭 */
+    int rec_len;                /* 現在のレコードのバイト数(改行は含まない) */
+    int count;                  /* 現在のレコードのフィールド数 */
+    int capacity;               /* fields の確保数 */
+    struct csv_field_t* fields; /* フィールド配列 */
+    int eof;                    /* データの終わりまで供給されている場合は 1 */
+    char* buf;                  /* 分割して供給されるデータのバッファ */
+    size_t buf_capacity;        /* buf の確保サイズ */
+};
+
+/* prototypes */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+APIEXPORT void csv_reader_init(struct csv_reader_t* csv, const char* ptr, size_t size);
+APIEXPORT void csv_reader_stream_init(struct csv_reader_t* csv);
+APIEXPORT int csv_reader_feed(struct csv_reader_t* csv, const char* ptr, size_t size);
+APIEXPORT void csv_reader_feed_end(struct csv_reader_t* csv);
+APIEXPORT void csv_reader_free(struct csv_reader_t* csv);
+APIEXPORT int csv_read_record(struct csv_reader_t* csv);
+APIEXPORT int csv_field_copy(char* dst, int dst_size, const struct csv_field_t* fld);
+APIEXPORT int csv_field_icmp(const struct csv_field_t* fld, const char* str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CSVREADER_H_ */
@@ -31,6 +31,7 @@
 #include <mbstring.h>
 #else
 #include <dirent.h>
+#include <sys/mman.h>
 #endif
 
 #include "common.h"
@@ -186,3 +187,105 @@ char* takedir(const char* fullpath, char* dir)
     }
     return dir;
 }
+
+int is_directory(const char* path)
+{
+    struct stat sb;
+
+    if (stat(path, &sb) != 0)
+        return 0;
+    return S_ISDIR(sb.st_mode)? 1 : 0;
+}
+
+static char* map_file(const char* path, int64* size, int is_private)
+{
+    char* ptr = NULL;
+#ifdef _WIN32
+    HANDLE fh, mh;
+    LARGE_INTEGER fsize;
+
+    *size = -1;
+    fh = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE)
+        return NULL;
+    if (! GetFileSizeEx(fh, &fsize)) {
+        CloseHandle(fh);
+        return NULL;
+    }
+    *size = fsize.QuadPart;
+    if (*size > 0) {
+        mh = CreateFileMapping(fh, NULL, is_private? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+        if (mh) {
+            ptr = (char*)MapViewOfFile(mh, is_private? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mh);
+        }
+        if (ptr == NULL)
+            *size = -1;
+    }
+    CloseHandle(fh);
+#else
+    int fd;
+    struct stat sb;
+
+    *size = -1;
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &sb) != 0 || ! S_ISREG(sb.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+    *size = sb.st_size;
+    if (*size > 0) {
+        ptr = (char*)mmap(NULL, (size_t)*size, is_private? (PROT_READ|PROT_WRITE) : PROT_READ,
+                          MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            ptr = NULL;
+            *size = -1;
+        } else if (! is_private) {
+            // 先頭から順に読み込むため先読みさせます。
+            madvise(ptr, (size_t)*size, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+#endif
+    return ptr;
+}
+
+/*
+ * ファイルを読み込み専用でメモリにマッピングします。
+ * マッピングした領域は file_unmap() で解放します。
+ *
+ * path: ファイル名
+ * size: ファイルサイズが設定されます。
+ *
+ * 戻り値
+ *  マッピングした領域のポインタを返します。
+ *  空のファイルの場合は NULL を返して size にゼロを設定します。
+ *  エラーの場合は NULL を返して size に -1 を設定します。
+ */
+char* file_map(const char* path, int64* size)
+{
+    return map_file(path, size, 0);
+}
+
+/*
+ * ファイルをコピーオンライトでメモリにマッピングします。
+ * マッピングした領域は書き換えることができますが、ファイルには反映されません。
+ * 戻り値は file_map() と同じです。
+ */
+char* file_map_private(const char* path, int64* size)
+{
+    return map_file(path, size, 1);
+}
+
+void file_unmap(char* ptr, int64 size)
+{
+    if (ptr == NULL)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, (size_t)size);
+#endif
+}
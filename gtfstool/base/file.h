@@ -35,6 +35,10 @@ void catpath(char* dir, const char* name);
 void rmfile(const char* name);
 void remove_files(char* dir);
 char* takedir(const char* fullpath, char* dir);
+int is_directory(const char* path);
+char* file_map(const char* path, int64* size);
+char* file_map_private(const char* path, int64* size);
+void file_unmap(char* ptr, int64 size);
 
 #ifdef __cplusplus
 }
@@ -35,176 +35,262 @@
  * スレッドセーフで動作します。
  *
  * キーの最大サイズの制限はありません（2020/09/25以前は255バイトでした）。
- * キーの衝突が起こった場合はリンクリストで管理されます。
  *
- * ハッシュとして追加できる要素数に制限はありませんが、
- * capacity(ハッシュ要素数)が小さい場合はキー値からハッシュ値の変換で
- * 衝突が起きてしまい、同じハッシュ値にリンクリストでつながれるので
- * 検索コストが大きくなります。
+ * オープンアドレス法(Robin Hood hashing)のハッシュ表で管理します。
+ * スロットにはハッシュ値と要素の位置を格納して、ハッシュ値が一致した場合だけ
+ * キーを比較します。スロットの使用率が 7/8 を超えると自動的に２倍に拡張されるため、
+ * 要素数が増えても検索コストは一定です。
+ * 削除はスロットを後方から詰めるため(backward shift deletion)、削除済みの印は残りません。
+ *
+ * 一つのスレッドだけが使用するハッシュテーブルはロックしない hash_put_unlocked()、
+ * hash_get_unlocked()関数を使用できます。作成後に参照だけを行うハッシュテーブルは
+ * hash_freeze()関数で凍結すると、hash_get()関数がロックせずに参照します。
+ *
+ * 要素は追加した順に配列に格納されます。hash_iter_begin()、hash_iter_next()関数は
+ * メモリを確保せずに要素を追加した順に列挙します。hash_keylist()関数と hash_list()関数も
+ * 要素を追加した順に列挙します。ハッシュ表の大きさによって列挙の順序は変わりません。
+ *
+ * キーはハッシュテーブルごとの格納領域(arena)にコピーされ、
+ * ハッシュテーブルを終了するまで解放されません。
  *
  * ハッシュ関数には MurmurHash2A, by Austin Appleby を使用しています。
  */
 
+#define HASH_SEED           1487
+#define HASH_MIN_SLOTS      16
+#define HASH_EMPTY          -1
+
+/* スロットの使用率の上限(7/8) */
+#define SLOT_LIMIT(capacity)    ((capacity) - ((capacity) >> 3))
+
+static unsigned int hash_value(const char* key, int len)
+{
+    return MurmurHash2A(key, len, HASH_SEED);
+}
+
+/* ハッシュ値の本来の位置からの距離 */
+static int probe_distance(struct hash_t* ht, unsigned int hash, int index)
+{
+    return (index - (int)(hash & (ht->capacity - 1))) & (ht->capacity - 1);
+}
+
 /*
- * ハッシュ要素のメモリを解放します。
+ * 要素数を格納できるスロット数(2のべき乗)を求めます。
  *
- * e: ハッシュ要素構造体のポインタ
+ * count: 要素数
  *
  * 戻り値
- *  なし
+ *  スロット数を返します。
  */
-static void free_element(struct hash_element_t* e)
+static int slot_capacity(int count)
 {
-    if (e == NULL)
-        return;
+    int capacity = HASH_MIN_SLOTS;
 
-    if (e->next != NULL) {
-        while (e != NULL) {
-            struct hash_element_t* en;
-
-            en = e->next;
-            free(e->key);
-            free(e);
-            e = en;
-        }
-    } else {
-        free(e->key);
-        free(e);
-    }
+    while (SLOT_LIMIT(capacity) < count && capacity < (INT_MAX >> 1) + 1)
+        capacity <<= 1;
+    return capacity;
 }
 
 /*
- * ハッシュ値を算出します。
+ * ハッシュ表からキーのスロットを検索します。
  *
  * ht: ハッシュテーブル構造体のポインタ
  * key: キー値
+ * len: キーのバイト数
+ * hash: キーのハッシュ値
  *
  * 戻り値
- *  ハッシュテーブルのインデックスを返します。
+ *  スロットの位置を返します。
+ *  存在しない場合は -1 を返します。
  */
-#define HASH_SEED 1487
-static int hash_calc(struct hash_t* ht, const char* key)
+static int find_slot(struct hash_t* ht, const char* key, int len, unsigned int hash)
 {
-    unsigned int hash_val;
-
-    hash_val = MurmurHash2A(key, (int)strlen(key), HASH_SEED);
-    return (hash_val % ht->capacity);
+    int mask = ht->capacity - 1;
+    int index;
+    int dist;
+
+    index = (int)(hash & mask);
+    for (dist = 0; ; dist++) {
+        struct hash_slot_t* slot = &ht->slots[index];
+
+        if (slot->entry == HASH_EMPTY)
+            return -1;
+        /* 本来の位置からの距離が短い要素に達した場合は存在しません。*/
+        if (probe_distance(ht, slot->hash, index) < dist)
+            return -1;
+        if (slot->hash == hash) {
+            struct hash_entry_t* e = &ht->entries[slot->entry];
+
+            if (e->key_len == len && memcmp(e->key, key, len) == 0)
+                return index;
+        }
+        index = (index + 1) & mask;
+    }
 }
 
 /*
- * ハッシュテーブルからキーの要素を取得します。
+ * ハッシュ表に要素の位置を登録します。
+ * 本来の位置からの距離が短い要素と入れ替えながら空きスロットを探します。
  *
  * ht: ハッシュテーブル構造体のポインタ
- * key: キー値
+ * hash: キーのハッシュ値
+ * entry: 要素の位置
  *
  * 戻り値
- *  ハッシュ要素構造体のポインタを返します。
- *  存在しない場合は NULL を返します。
+ *  なし
  */
-static struct hash_element_t* get_element(struct hash_t* ht, const char* key)
+static void insert_slot(struct hash_t* ht, unsigned int hash, int entry)
 {
+    int mask = ht->capacity - 1;
+    struct hash_slot_t cur;
     int index;
-    struct hash_element_t* e;
+    int dist;
+
+    cur.hash = hash;
+    cur.entry = entry;
+    index = (int)(hash & mask);
+    for (dist = 0; ; dist++) {
+        struct hash_slot_t* slot = &ht->slots[index];
+        int slot_dist;
+
+        if (slot->entry == HASH_EMPTY) {
+            *slot = cur;
+            return;
+        }
+        slot_dist = probe_distance(ht, slot->hash, index);
+        if (slot_dist < dist) {
+            struct hash_slot_t tmp = *slot;
 
-    index = hash_calc(ht, key);
-    if (index < 0 || index >= ht->capacity)
-        return NULL;
-    e = ht->table[index];
-    while (e) {
-        if (strcmp(e->key, key) == 0) {
-            return e;
+            *slot = cur;
+            cur = tmp;
+            dist = slot_dist;
         }
-        e = e->next;
+        index = (index + 1) & mask;
     }
-    return NULL;
 }
 
 /*
- * ハッシュテーブルから要素の数を取得します。
+ * ハッシュ表からスロットを削除して、後続のスロットを前に詰めます。
  *
  * ht: ハッシュテーブル構造体のポインタ
+ * index: 削除するスロットの位置
  *
  * 戻り値
- *  要素数を返します。
+ *  なし
  */
-static int element_count(struct hash_t* ht)
+static void remove_slot(struct hash_t* ht, int index)
 {
-    int n = 0;
-    int i;
-
-    for (i = 0; i < ht->capacity; i++) {
-        struct hash_element_t* e;
-
-        e = ht->table[i];
-        while (e) {
-            n++;
-            e = e->next;
-        }
+    int mask = ht->capacity - 1;
+    int next;
+
+    next = (index + 1) & mask;
+    while (ht->slots[next].entry != HASH_EMPTY &&
+           probe_distance(ht, ht->slots[next].hash, next) > 0) {
+        ht->slots[index] = ht->slots[next];
+        index = next;
+        next = (next + 1) & mask;
     }
-    return n;
+    ht->slots[index].entry = HASH_EMPTY;
 }
 
 /*
- * ハッシュテーブルからキーのポインタを配列に列挙します。
+ * 削除済みの要素を詰めて、指定されたスロット数でハッシュ表を作り直します。
  *
  * ht: ハッシュテーブル構造体のポインタ
- * list: ポインタ配列
- * count: ポインタ配列の数
+ * capacity: スロット数(2のべき乗)
  *
  * 戻り値
- *  なし
+ *  正常に作成された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
  */
-static void key_list(struct hash_t* ht, char** list, int count)
+static int rebuild_slots(struct hash_t* ht, int capacity)
 {
-    int i;
-    int n = 0;
+    struct hash_slot_t* slots;
+    int i, n;
 
-    for (i = 0; i < ht->capacity; i++) {
-        struct hash_element_t* e;
+    slots = (struct hash_slot_t*)malloc(capacity * sizeof(struct hash_slot_t));
+    if (slots == NULL) {
+        err_write("hash: No memory.");
+        return -1;
+    }
+    for (i = 0; i < capacity; i++)
+        slots[i].entry = HASH_EMPTY;
+    free(ht->slots);
+    ht->slots = slots;
+    ht->capacity = capacity;
 
-        e = ht->table[i];
-        while (e) {
-            list[n++] = e->key;
-            if (n >= count)
-                return;
-            e = e->next;
-        }
+    /* 追加順を保ったまま削除済みの要素を詰めます。*/
+    n = 0;
+    for (i = 0; i < ht->entry_count; i++) {
+        if (ht->entries[i].key == NULL)
+            continue;
+        if (n != i)
+            ht->entries[n] = ht->entries[i];
+        insert_slot(ht, ht->entries[n].hash, n);
+        n++;
     }
+    ht->entry_count = n;
+    return 0;
 }
 
 /*
- * ハッシュテーブルから要素のポインタを配列に列挙します。
+ * 要素の配列を指定された数まで確保します。
  *
  * ht: ハッシュテーブル構造体のポインタ
- * list: ポインタ配列
- * count: ポインタ配列の数
+ * capacity: 要素数
  *
  * 戻り値
- *  なし
+ *  正常に確保された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
  */
-static void element_list(struct hash_t* ht, void** list, int count)
+static int resize_entries(struct hash_t* ht, int capacity)
 {
-    int i;
-    int n = 0;
+    struct hash_entry_t* entries;
 
-    for (i = 0; i < ht->capacity; i++) {
-        struct hash_element_t* e;
+    entries = (struct hash_entry_t*)realloc(ht->entries, capacity * sizeof(struct hash_entry_t));
+    if (entries == NULL) {
+        err_write("hash: No memory.");
+        return -1;
+    }
+    ht->entries = entries;
+    ht->entry_capacity = capacity;
+    return 0;
+}
 
-        e = ht->table[i];
-        while (e) {
-            list[n++] = e->value;
-            if (n >= count)
-                return;
-            e = e->next;
+/*
+ * 要素を一つ追加できるように要素の配列とハッシュ表を拡張します。
+ *
+ * ht: ハッシュテーブル構造体のポインタ
+ *
+ * 戻り値
+ *  正常に拡張された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+static int grow(struct hash_t* ht)
+{
+    if (ht->count + 1 > SLOT_LIMIT(ht->capacity)) {
+        if (rebuild_slots(ht, ht->capacity << 1) < 0)
+            return -1;
+    }
+    if (ht->entry_count >= ht->entry_capacity) {
+        if (ht->count < ht->entry_count - (ht->entry_count >> 2)) {
+            /* 削除済みの要素が多い場合は詰めて再利用します。*/
+            if (rebuild_slots(ht, ht->capacity) < 0)
+                return -1;
+        } else {
+            if (resize_entries(ht, ht->entry_capacity * 2) < 0)
+                return -1;
         }
     }
+    return 0;
 }
 
 /*
  * ハッシュテーブルの初期処理を行ないます。
  * データを管理するためのメモリを確保します。
+ * ハッシュ表は要素数に合わせて自動的に拡張されます。
  *
- * capacity: ハッシュ要素数
+ * capacity: 要素数の見込み
  *
  * 戻り値
  *  ハッシュテーブル構造体のポインタ
@@ -212,20 +298,40 @@ static void element_list(struct hash_t* ht, void** list, int count)
 APIEXPORT struct hash_t* hash_initialize(int capacity)
 {
     struct hash_t *ht;
+    int block_size;
+    int i;
 
-    ht = (struct hash_t*)malloc(sizeof(struct hash_t));
+    if (capacity < HASH_MIN_SLOTS)
+        capacity = HASH_MIN_SLOTS;
+
+    ht = (struct hash_t*)calloc(1, sizeof(struct hash_t));
     if (ht == NULL) {
         err_write("hash: No memory.");
         return NULL;
     }
 
-    ht->table = (struct hash_element_t**)calloc(capacity, sizeof(struct hash_element_t*));
-    if (ht->table == NULL) {
+    ht->capacity = slot_capacity(capacity);
+    ht->slots = (struct hash_slot_t*)malloc(ht->capacity * sizeof(struct hash_slot_t));
+    ht->entry_capacity = capacity;
+    ht->entries = (struct hash_entry_t*)malloc(capacity * sizeof(struct hash_entry_t));
+    /* キーの格納領域は要素数の見込みに合わせて小さなブロックから始めます。*/
+    block_size = capacity * 16;
+    if (block_size > 64 * 1024)
+        block_size = 64 * 1024;
+    ht->key_arena = arena_initialize(block_size);
+    if (ht->slots == NULL || ht->entries == NULL || ht->key_arena == NULL) {
+        if (ht->slots)
+            free(ht->slots);
+        if (ht->entries)
+            free(ht->entries);
+        if (ht->key_arena)
+            arena_finalize(ht->key_arena);
         free(ht);
         err_write("hash: No memory.");
         return NULL;
     }
-    ht->capacity = capacity;
+    for (i = 0; i < ht->capacity; i++)
+        ht->slots[i].entry = HASH_EMPTY;
 
     /* クリティカルセクションの初期化 */
     CS_INIT(&ht->critical_section);
@@ -244,25 +350,117 @@ APIEXPORT struct hash_t* hash_initialize(int capacity)
  */
 APIEXPORT void hash_finalize(struct hash_t* ht)
 {
-    int i;
+    if (ht == NULL)
+        return;
 
     /* クリティカルセクションの削除 */
     CS_DELETE(&ht->critical_section);
 
-    if (ht == NULL)
-        return;
+    arena_finalize(ht->key_arena);
+    free(ht->entries);
+    free(ht->slots);
+    free(ht);
+}
+
+/*
+ * 追加する要素数に合わせてハッシュ表と要素の配列を拡張します。
+ * 現在の大きさが十分な場合は何もしません。
+ * 要素数がわかっているテーブルを作成する前に呼び出すことで
+ * 追加の途中で拡張が繰り返されることを防ぎます。
+ *
+ * ht: ハッシュテーブル構造体のポインタ
+ * count: 追加する要素数
+ *
+ * 戻り値
+ *  正常に拡張された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+APIEXPORT int hash_reserve(struct hash_t* ht, int count)
+{
+    int result = 0;
+
+    CS_START(&ht->critical_section);
+    if (ht->frozen)
+        goto final;
+    if (count > ht->entry_capacity)
+        result = resize_entries(ht, count);
+    if (result == 0 && count > SLOT_LIMIT(ht->capacity))
+        result = rebuild_slots(ht, slot_capacity(count));
+final:
+    CS_END(&ht->critical_section);
+    return result;
+}
 
-    for (i = 0; i < ht->capacity; i++) {
-        if (ht->table[i] != NULL)
-            free_element(ht->table[i]);
+/*
+ * ハッシュテーブルに要素を追加します(ロックは呼び出し側で行います)。
+ *
+ * 戻り値
+ *  正常に追加された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+static int put_element(struct hash_t* ht, const char* key, const void* value)
+{
+    struct hash_entry_t* e;
+    unsigned int hash;
+    int len;
+    int index;
+
+    if (ht->frozen) {
+        err_write("hash: put to frozen table.");
+        return -1;
     }
-    free(ht->table);
-    free(ht);
+    len = (int)strlen(key);
+    hash = hash_value(key, len);
+
+    /* すでにキーが登録済みであれば置き換えます。*/
+    index = find_slot(ht, key, len, hash);
+    if (index >= 0) {
+        ht->entries[ht->slots[index].entry].value = (void*)value;
+        return 0;
+    }
+
+    /* 存在しないので新規に登録します。 */
+    if (grow(ht) < 0)
+        return -1;
+    e = &ht->entries[ht->entry_count];
+    e->key = (char*)arena_alloc(ht->key_arena, len + 1);
+    if (e->key == NULL) {
+        err_write("hash: No memory.");
+        return -1;
+    }
+    memcpy(e->key, key, len + 1);
+    e->key_len = len;
+    e->hash = hash;
+    e->value = (void*)value;
+    insert_slot(ht, hash, ht->entry_count);
+    ht->entry_count++;
+    ht->count++;
+    return 0;
+}
+
+/*
+ * ハッシュテーブルからキーの値を取得します(ロックは呼び出し側で行います)。
+ *
+ * 戻り値
+ *  キー値に対応した値を返します。
+ *  存在しない場合は NULL を返します。
+ */
+static void* get_value(struct hash_t* ht, const char* key)
+{
+    int len;
+    int index;
+
+    len = (int)strlen(key);
+    index = find_slot(ht, key, len, hash_value(key, len));
+    if (index < 0)
+        return NULL;
+    return ht->entries[ht->slots[index].entry].value;
 }
 
 /*
  * ハッシュテーブルに追加します。
  * キーがすでに存在する場合は値が置換されます。
+ * 凍結されたハッシュテーブルには追加できません。
  *
  * ht: ハッシュテーブル構造体のポインタ
  * key: キー値
@@ -274,51 +472,34 @@ APIEXPORT void hash_finalize(struct hash_t* ht)
  */
 APIEXPORT int hash_put(struct hash_t* ht, const char* key, const void* value)
 {
-    int index;
-    struct hash_element_t* e;
-    struct hash_element_t* new_e;
-    int result = 0;
+    int result;
 
     CS_START(&ht->critical_section);
-
-    /* すでにキーが登録済みであれば置き換えます。*/
-    e = get_element(ht, key);
-    if (e) {
-        e->value = (void*)value;
-    } else {
-        /* 存在しないので新規に登録します。 */
-        new_e = (struct hash_element_t*)malloc(sizeof(struct hash_element_t));
-        if (new_e == NULL) {
-            err_write("hash: No memory.");
-            result = -1;
-            goto final;
-        }
-        new_e->key = malloc(strlen(key)+1);
-        strcpy(new_e->key, key);
-        new_e->value = (void*)value;
-        new_e->next = NULL;
-
-        index = hash_calc(ht, key);
-        e = ht->table[index];
-
-        if (e) {
-            /* キーの衝突が起きたのでリストの最後に追加します。*/
-            while (e->next) {
-                e = e->next;
-            }
-            e->next = new_e;
-        } else {
-            ht->table[index] = new_e;
-        }
-    }
-
-final:
+    result = put_element(ht, key, value);
     CS_END(&ht->critical_section);
     return result;
 }
 
+/*
+ * ハッシュテーブルに追加します(ロックしません)。
+ * 一つのスレッドだけが使用するハッシュテーブルに使用します。
+ *
+ * ht: ハッシュテーブル構造体のポインタ
+ * key: キー値
+ * value: 値
+ *
+ * 戻り値
+ *  正常に追加された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+APIEXPORT int hash_put_unlocked(struct hash_t* ht, const char* key, const void* value)
+{
+    return put_element(ht, key, value);
+}
+
 /*
  * ハッシュテーブルからキーの値を取得します。
+ * 凍結されたハッシュテーブルはロックせずに参照します。
  *
  * ht: ハッシュテーブル構造体のポインタ
  * key: キー値
@@ -329,20 +510,85 @@ final:
  */
 APIEXPORT void* hash_get(struct hash_t* ht, const char* key)
 {
-    struct hash_element_t* e;
-    void* v = NULL;
+    void* v;
 
-    CS_START(&ht->critical_section);
-    e = get_element(ht, key);
-    if (e)
-        v = e->value;
+    if (ht->frozen)
+        return get_value(ht, key);
 
+    CS_START(&ht->critical_section);
+    v = get_value(ht, key);
     CS_END(&ht->critical_section);
     return v;
 }
 
+/*
+ * ハッシュテーブルからキーの値を取得します(ロックしません)。
+ * 一つのスレッドだけが使用するハッシュテーブルに使用します。
+ *
+ * ht: ハッシュテーブル構造体のポインタ
+ * key: キー値
+ *
+ * 戻り値
+ *  キー値に対応した値を返します。
+ *  存在しない場合は NULL を返します。
+ */
+APIEXPORT void* hash_get_unlocked(struct hash_t* ht, const char* key)
+{
+    return get_value(ht, key);
+}
+
+/*
+ * ハッシュテーブルを凍結して読み込み専用にします。
+ *
+ * 凍結後は追加と削除がエラーになり、hash_get() はロックせずに参照します。
+ * 作成が終わったハッシュテーブルを凍結してから複数のスレッドで参照すると
+ * ロックの競合なしに検索できます。凍結はスレッドを開始する前に行います。
+ *
+ * ht: ハッシュテーブル構造体のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void hash_freeze(struct hash_t* ht)
+{
+    CS_START(&ht->critical_section);
+    ht->frozen = 1;
+    CS_END(&ht->critical_section);
+}
+
+/*
+ * ハッシュテーブルのすべての要素を削除して空にします。
+ * ハッシュ表と要素の配列、キーの格納領域は解放せずに再利用します。
+ * 繰り返し作成して破棄する作業用のテーブルに使用します。
+ *
+ * ht: ハッシュテーブル構造体のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void hash_clear(struct hash_t* ht)
+{
+    int i;
+
+    CS_START(&ht->critical_section);
+    if (ht->frozen) {
+        err_write("hash: clear frozen table.");
+        goto final;
+    }
+    if (ht->entry_count > 0) {
+        for (i = 0; i < ht->capacity; i++)
+            ht->slots[i].entry = HASH_EMPTY;
+        ht->count = 0;
+        ht->entry_count = 0;
+        arena_reset(ht->key_arena);
+    }
+final:
+    CS_END(&ht->critical_section);
+}
+
 /*
  * ハッシュテーブルから要素を削除します。
+ * キーの領域はハッシュテーブルを終了するまで解放されません。
  *
  * ht: ハッシュテーブル構造体のポインタ
  * key: キー値
@@ -353,30 +599,30 @@ APIEXPORT void* hash_get(struct hash_t* ht, const char* key)
  */
 APIEXPORT int hash_delete(struct hash_t* ht, const char* key)
 {
+    unsigned int hash;
+    int len;
     int index;
-    struct hash_element_t* e;
-    struct hash_element_t* tmp = NULL;
     int result = -1;
 
+    len = (int)strlen(key);
+    hash = hash_value(key, len);
+
     CS_START(&ht->critical_section);
-    index = hash_calc(ht, key);
-    e = ht->table[index];
-
-    while (e) {
-        if (strcmp(e->key, key) == 0) {
-            if (tmp == NULL) {
-                ht->table[index] = e->next;
-            } else {
-                tmp->next = e->next;
-            }
-            free(e->key);
-            free(e);
-            result = 0;
-            break;
-        }
-        tmp = e;
-        e = e->next;
+    if (ht->frozen) {
+        err_write("hash: delete from frozen table.");
+        goto final;
+    }
+    index = find_slot(ht, key, len, hash);
+    if (index >= 0) {
+        struct hash_entry_t* e = &ht->entries[ht->slots[index].entry];
+
+        e->key = NULL;
+        e->value = NULL;
+        remove_slot(ht, index);
+        ht->count--;
+        result = 0;
     }
+final:
     CS_END(&ht->critical_section);
     return result;
 }
@@ -391,16 +637,12 @@ APIEXPORT int hash_delete(struct hash_t* ht, const char* key)
  */
 APIEXPORT int hash_count(struct hash_t* ht)
 {
-    int n;
-
-    CS_START(&ht->critical_section);
-    n = element_count(ht);
-    CS_END(&ht->critical_section);
-    return n;
+    /* 要素数は追加と削除の際に更新されるため、ロックせずに返します。*/
+    return ht->count;
 }
 
 /*
- * ハッシュテーブルのキーをリストとして列挙して返します。
+ * ハッシュテーブルのキーを追加順にリストとして列挙して返します。
  *
  * 戻り値は以下のようなポインタ配列になります。
  * リストの最後に NULL が入ります。
@@ -425,16 +667,16 @@ APIEXPORT int hash_count(struct hash_t* ht)
 APIEXPORT char** hash_keylist(struct hash_t* ht)
 {
     char** list = NULL;
-    int n;
+    int i, n;
 
     CS_START(&ht->critical_section);
-
-    /* 要素の数を調べます。*/
-    n = element_count(ht);
-    list = (char**)malloc((n+1) * sizeof(void*));
+    list = (char**)malloc((ht->count+1) * sizeof(void*));
     if (list != NULL) {
-        if (n > 0)
-            key_list(ht, list, n);
+        n = 0;
+        for (i = 0; i < ht->entry_count; i++) {
+            if (ht->entries[i].key)
+                list[n++] = ht->entries[i].key;
+        }
         list[n] = NULL;
     }
     CS_END(&ht->critical_section);
@@ -442,7 +684,7 @@ APIEXPORT char** hash_keylist(struct hash_t* ht)
 }
 
 /*
- * ハッシュテーブルの要素をリストとして列挙して返します。
+ * ハッシュテーブルの要素を追加順にリストとして列挙して返します。
  *
  * 戻り値は以下のようなポインタ配列になります。
  * リストの最後に NULL が入ります。
@@ -467,16 +709,16 @@ APIEXPORT char** hash_keylist(struct hash_t* ht)
 APIEXPORT void** hash_list(struct hash_t* ht)
 {
     void** list = NULL;
-    int n;
+    int i, n;
 
     CS_START(&ht->critical_section);
-
-    /* 要素の数を調べます。*/
-    n = element_count(ht);
-    list = (void**)malloc((n+1) * sizeof(void*));
+    list = (void**)malloc((ht->count+1) * sizeof(void*));
     if (list != NULL) {
-        if (n > 0)
-            element_list(ht, list, n);
+        n = 0;
+        for (i = 0; i < ht->entry_count; i++) {
+            if (ht->entries[i].key)
+                list[n++] = ht->entries[i].value;
+        }
         list[n] = NULL;
     }
     CS_END(&ht->critical_section);
@@ -497,6 +739,55 @@ APIEXPORT void hash_list_free(void** list)
         free(list);
 }
 
+/*
+ * ハッシュテーブルの要素の列挙を開始します。
+ * 要素は hash_iter_next()関数で追加順に取得します。
+ *
+ * 列挙はメモリを確保せず、ロックも行いません。列挙している間は
+ * ハッシュテーブルに要素を追加または削除しないでください（値の置換はできます）。
+ * 複数のスレッドから参照する場合は hash_freeze()関数で凍結したハッシュテーブルを使用します。
+ *
+ * ht: ハッシュテーブル構造体のポインタ
+ * it: 列挙の状態を格納する構造体のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void hash_iter_begin(struct hash_t* ht, struct hash_iter_t* it)
+{
+    it->ht = ht;
+    it->index = 0;
+}
+
+/*
+ * ハッシュテーブルの次の要素を取得します。
+ *
+ * it: hash_iter_begin()関数で開始した列挙の状態
+ * key: キーのポインタが設定される領域のポインタ(NULLの場合は設定しません)
+ * value: 値が設定される領域のポインタ(NULLの場合は設定しません)
+ *
+ * 戻り値
+ *  要素を取得した場合は 1 を返します。
+ *  すべての要素を列挙した場合はゼロを返します。
+ */
+APIEXPORT int hash_iter_next(struct hash_iter_t* it, const char** key, void** value)
+{
+    struct hash_t* ht = it->ht;
+
+    while (it->index < ht->entry_count) {
+        struct hash_entry_t* e = &ht->entries[it->index++];
+
+        if (e->key == NULL)
+            continue;   /* 削除済み */
+        if (key)
+            *key = e->key;
+        if (value)
+            *value = e->value;
+        return 1;
+    }
+    return 0;
+}
+
 /*
 //-----------------------------------------------------------------------------
 // MurmurHash2A, by Austin Appleby
@@ -538,7 +829,9 @@ APIEXPORT unsigned int MurmurHash2A ( const void * key, int len, unsigned int se
     switch(len)
     {
     case 3: t ^= data[2] << 16;
+        /* FALLTHROUGH */
     case 2: t ^= data[1] << 8;
+        /* FALLTHROUGH */
     case 1: t ^= data[0];
     };
 
@@ -28,16 +28,38 @@
 #include "csect.h"
 #include "apiexp.h"
 
-struct hash_element_t {
-    char* key;
+struct arena_t;
+
+/* ハッシュ表のスロット */
+struct hash_slot_t {
+    unsigned int hash;      /* キーのハッシュ値 */
+    int entry;              /* 要素の位置(-1は空き) */
+};
+
+/* 要素(追加順に格納します) */
+struct hash_entry_t {
+    unsigned int hash;      /* キーのハッシュ値 */
+    int key_len;            /* キーのバイト数 */
+    char* key;              /* キー(NULLは削除済み) */
     void* value;
-    struct hash_element_t* next;
 };
 
 struct hash_t {
     CS_DEF(critical_section);
-    int capacity;
-    struct hash_element_t** table;
+    int capacity;                   /* slots の要素数(2のべき乗) */
+    int count;                      /* 要素数 */
+    int entry_count;                /* entries の使用数(削除済みを含む) */
+    int entry_capacity;             /* entries の確保数 */
+    struct hash_slot_t* slots;      /* ハッシュ表 */
+    struct hash_entry_t* entries;   /* 要素の配列 */
+    struct arena_t* key_arena;      /* キーの格納領域 */
+    int frozen;                     /* 凍結(読み込み専用)の場合は 1 */
+};
+
+/* 要素の列挙(hash_iter_begin/hash_iter_next) */
+struct hash_iter_t {
+    struct hash_t* ht;
+    int index;              /* 次に参照する要素の位置 */
 };
 
 /* prototypes */
@@ -47,13 +69,20 @@ extern "C" {
 
 APIEXPORT struct hash_t* hash_initialize(int capacity);
 APIEXPORT void hash_finalize(struct hash_t* ht);
+APIEXPORT int hash_reserve(struct hash_t* ht, int count);
 APIEXPORT int hash_put(struct hash_t* ht, const char* key, const void* value);
+APIEXPORT int hash_put_unlocked(struct hash_t* ht, const char* key, const void* value);
 APIEXPORT void* hash_get(struct hash_t* ht, const char* key);
+APIEXPORT void* hash_get_unlocked(struct hash_t* ht, const char* key);
+APIEXPORT void hash_freeze(struct hash_t* ht);
 APIEXPORT int hash_delete(struct hash_t* ht, const char* key);
+APIEXPORT void hash_clear(struct hash_t* ht);
 APIEXPORT int hash_count(struct hash_t* ht);
 APIEXPORT char** hash_keylist(struct hash_t* ht);
 APIEXPORT void** hash_list(struct hash_t* ht);
 APIEXPORT void hash_list_free(void** list);
+APIEXPORT void hash_iter_begin(struct hash_t* ht, struct hash_iter_t* it);
+APIEXPORT int hash_iter_next(struct hash_iter_t* it, const char** key, void** value);
 APIEXPORT unsigned int MurmurHash2A(const void * key, int len, unsigned int seed);
 
 #ifdef __cplusplus
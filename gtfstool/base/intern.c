@@ -0,0 +1,547 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2008-2020 YAMAMOTO Naoki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#define API_INTERNAL
+#include "common.h"
+#include "intern.h"
+
+/*
+ * 文字列を32ビットの連番(シンボル)に変換する文字列プールの関数群です。
+ * スレッドセーフで動作します。
+ *
+ * 同じ文字列には同じシンボルが割り当てられるため、シンボルを比較することで
+ * 文字列の比較を整数の比較に置き換えることができます。
+ * 空文字列のシンボルは常にゼロです。
+ *
+ * 文字列はブロック単位に確保した領域に長さと一緒にコピーされ、プールを終了するまで
+ * 移動しません。長さで比較するため '\0' を含むバイト列も登録できます。
+ * シンボルから文字列への変換はページ単位の配列を参照するため、
+ * intern_str() はロックせずに呼び出すことができます。
+ */
+
+#define INTERN_SEED         1487
+#define INTERN_INIT_SLOTS   1024
+#define INTERN_BLOCK_SIZE   (64*1024)
+
+struct intern_block_t {
+    struct intern_block_t* next;
+};
+
+/* 文字列の直前に格納する長さ */
+#define LEN_SIZE    (int)sizeof(int)
+
+/* シンボル0の空文字列(長さゼロ) */
+static const char _empty[LEN_SIZE + 1];
+
+static int string_len(const char* s)
+{
+    int len;
+
+    memcpy(&len, s - LEN_SIZE, LEN_SIZE);
+    return len;
+}
+
+static unsigned int hash_value(const char* str, int len)
+{
+    return MurmurHash2A(str, len, INTERN_SEED);
+}
+
+/*
+ * 文字列を格納領域にコピーします。
+ *
+ * in: 文字列プール構造体のポインタ
+ * str: 文字列
+ * len: 文字列のバイト数
+ *
+ * 戻り値
+ *  コピーした文字列のポインタを返します。
+ *  メモリが確保できない場合は NULL を返します。
+ */
+static const char* copy_string(struct intern_t* in, const char* str, int len)
+{
+    char* p;
+    int n = LEN_SIZE + len + 1;
+
+    if (n > in->block_remain) {
+        struct intern_block_t* b;
+        int size;
+
+        size = (n > INTERN_BLOCK_SIZE)? n : INTERN_BLOCK_SIZE;
+        b = (struct intern_block_t*)malloc(sizeof(struct intern_block_t) + size);
+        if (b == NULL)
+            return NULL;
+        b->next = in->block;
+        in->block = b;
+        in->block_ptr = (char*)(b + 1);
+        in->block_remain = size;
+    }
+    p = in->block_ptr;
+    memcpy(p, &len, LEN_SIZE);
+    p += LEN_SIZE;
+    memcpy(p, str, len);
+    p[len] = '\0';
+    in->block_ptr += n;
+    in->block_remain -= n;
+    return p;
+}
+
+static const char* symbol_string(struct intern_t* in, unsigned int sym)
+{
+    return in->pages[sym >> INTERN_PAGE_BITS][sym & (INTERN_PAGE_SIZE - 1)];
+}
+
+/*
+ * ハッシュ表から文字列のスロットを検索します。
+ *
+ * 戻り値
+ *  文字列のシンボルまたは空きのスロット位置を返します。
+ */
+static unsigned int find_slot(struct intern_t* in, const char* str, int len, unsigned int hval)
+{
+    unsigned int mask = in->capacity - 1;
+    unsigned int i;
+
+    for (i = hval & mask; ; i = (i + 1) & mask) {
+        unsigned int sym = in->slots[i];
+        const char* s;
+
+        if (sym == 0)
+            return i;
+        s = symbol_string(in, sym);
+        if (string_len(s) == len && memcmp(s, str, len) == 0)
+            return i;
+    }
+}
+
+/*
+ * ハッシュ表の要素数を2倍にします。
+ *
+ * 戻り値
+ *  正常に拡張された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+static int expand_slots(struct intern_t* in)
+{
+    unsigned int* old_slots = in->slots;
+    unsigned int old_capacity = in->capacity;
+    unsigned int* slots;
+    unsigned int i;
+
+    slots = (unsigned int*)calloc(old_capacity * 2, sizeof(unsigned int));
+    if (slots == NULL)
+        return -1;
+    in->slots = slots;
+    in->capacity = old_capacity * 2;
+
+    for (i = 0; i < old_capacity; i++) {
+        unsigned int sym = old_slots[i];
+
+        if (sym) {
+            const char* s = symbol_string(in, sym);
+            int len = string_len(s);
+
+            in->slots[find_slot(in, s, len, hash_value(s, len))] = sym;
+        }
+    }
+    free(old_slots);
+    return 0;
+}
+
+/*
+ * 文字列プールの初期処理を行ないます。
+ *
+ * 戻り値
+ *  文字列プール構造体のポインタ
+ */
+APIEXPORT struct intern_t* intern_initialize()
+{
+    struct intern_t* in;
+
+    in = (struct intern_t*)calloc(1, sizeof(struct intern_t));
+    if (in == NULL) {
+        err_write("intern: No memory.");
+        return NULL;
+    }
+    in->slots = (unsigned int*)calloc(INTERN_INIT_SLOTS, sizeof(unsigned int));
+    in->pages[0] = (const char**)calloc(INTERN_PAGE_SIZE, sizeof(const char*));
+    if (in->slots == NULL || in->pages[0] == NULL) {
+        if (in->slots)
+            free(in->slots);
+        if (in->pages[0])
+            free((void*)in->pages[0]);
+        free(in);
+        err_write("intern: No memory.");
+        return NULL;
+    }
+    in->capacity = INTERN_INIT_SLOTS;
+
+    /* シンボル0は空文字列 */
+    in->pages[0][0] = _empty + LEN_SIZE;
+    in->count = 1;
+
+    /* クリティカルセクションの初期化 */
+    CS_INIT(&in->critical_section);
+
+    return in;
+}
+
+/*
+ * 文字列プールの使用を終了します。
+ * 確保された領域は解放されます。
+ * intern_str() で取得した文字列のポインタも無効になります。
+ *
+ * in: 文字列プール構造体のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void intern_finalize(struct intern_t* in)
+{
+    struct intern_block_t* b;
+    int i;
+
+    if (in == NULL)
+        return;
+
+    /* クリティカルセクションの削除 */
+    CS_DELETE(&in->critical_section);
+
+    for (i = 0; i < INTERN_MAX_PAGES && in->pages[i]; i++)
+        free((void*)in->pages[i]);
+    b = in->block;
+    while (b) {
+        struct intern_block_t* next = b->next;
+        free(b);
+        b = next;
+    }
+    free(in->slots);
+    free(in);
+}
+
+/*
+ * 文字列を登録してシンボルを取得します。
+ * すでに登録されている場合は同じシンボルを返します。
+ * 文字列は '\0' で終端されている必要はなく、'\0' を含むこともできます。
+ *
+ * in: 文字列プール構造体のポインタ
+ * str: 文字列
+ * len: 文字列のバイト数
+ *
+ * 戻り値
+ *  シンボルを返します。空文字列の場合はゼロを返します。
+ *  エラーの場合は INTERN_NONE を返します。
+ */
+APIEXPORT unsigned int intern_put_len(struct intern_t* in, const char* str, int len)
+{
+    unsigned int hval;
+    unsigned int slot;
+    unsigned int sym;
+
+    if (len < 1)
+        return 0;
+
+    hval = hash_value(str, len);
+
+    CS_START(&in->critical_section);
+
+    slot = find_slot(in, str, len, hval);
+    sym = in->slots[slot];
+    if (sym == 0) {
+        unsigned int page;
+        const char* s;
+
+        sym = in->count;
+        page = sym >> INTERN_PAGE_BITS;
+        if (page >= INTERN_MAX_PAGES) {
+            err_write("intern: symbol overflow.");
+            sym = INTERN_NONE;
+            goto final;
+        }
+        if (in->pages[page] == NULL) {
+            in->pages[page] = (const char**)calloc(INTERN_PAGE_SIZE, sizeof(const char*));
+            if (in->pages[page] == NULL) {
+                err_write("intern: No memory.");
+                sym = INTERN_NONE;
+                goto final;
+            }
+        }
+        s = copy_string(in, str, len);
+        if (s == NULL) {
+            err_write("intern: No memory.");
+            sym = INTERN_NONE;
+            goto final;
+        }
+        in->pages[page][sym & (INTERN_PAGE_SIZE - 1)] = s;
+        in->slots[slot] = sym;
+        /* ロックせずに参照する intern_str() に文字列とページを公開します。*/
+        ATOMIC_STORE_RELEASE(&in->count, sym + 1);
+
+        /* 使用率が50%を超えたらハッシュ表を拡張します。*/
+        if (in->count * 2 > in->capacity) {
+            if (expand_slots(in) < 0)
+                err_write("intern: No memory.");
+        }
+    }
+
+final:
+    CS_END(&in->critical_section);
+    return sym;
+}
+
+/*
+ * '\0' で終端された文字列を登録してシンボルを取得します。
+ *
+ * in: 文字列プール構造体のポインタ
+ * str: 文字列
+ *
+ * 戻り値
+ *  シンボルを返します。空文字列の場合はゼロを返します。
+ *  エラーの場合は INTERN_NONE を返します。
+ */
+APIEXPORT unsigned int intern_put(struct intern_t* in, const char* str)
+{
+    return intern_put_len(in, str, (int)strlen(str));
+}
+
+/*
+ * 登録されている文字列のシンボルを取得します。
+ * 文字列は登録されません。
+ *
+ * in: 文字列プール構造体のポインタ
+ * str: 文字列
+ *
+ * 戻り値
+ *  シンボルを返します。空文字列の場合はゼロを返します。
+ *  登録されていない場合は INTERN_NONE を返します。
+ */
+APIEXPORT unsigned int intern_get(struct intern_t* in, const char* str)
+{
+    unsigned int hval;
+    unsigned int sym;
+    int len;
+
+    len = (int)strlen(str);
+    if (len < 1)
+        return 0;
+
+    hval = hash_value(str, len);
+
+    CS_START(&in->critical_section);
+    sym = in->slots[find_slot(in, str, len, hval)];
+    CS_END(&in->critical_section);
+    return (sym)? sym : INTERN_NONE;
+}
+
+/*
+ * シンボルの文字列を取得します。
+ * 登録時はシンボル数を文字列の格納後に公開するため、登録中のスレッドが
+ * あってもロックせずに呼び出せます。
+ *
+ * in: 文字列プール構造体のポインタ
+ * sym: シンボル
+ *
+ * 戻り値
+ *  文字列のポインタを返します。
+ *  シンボルが登録されていない場合は空文字列を返します。
+ */
+APIEXPORT const char* intern_str(struct intern_t* in, unsigned int sym)
+{
+    if (sym >= ATOMIC_LOAD_ACQUIRE(&in->count))
+        return "";
+    return symbol_string(in, sym);
+}
+
+/*
+ * シンボルの文字列のバイト数を取得します。
+ * '\0' を含む文字列を登録した場合に使用します。
+ *
+ * in: 文字列プール構造体のポインタ
+ * sym: シンボル
+ *
+ * 戻り値
+ *  バイト数を返します。
+ *  シンボルが登録されていない場合はゼロを返します。
+ */
+APIEXPORT int intern_len(struct intern_t* in, unsigned int sym)
+{
+    if (sym >= ATOMIC_LOAD_ACQUIRE(&in->count))
+        return 0;
+    return string_len(symbol_string(in, sym));
+}
+
+/*
+ * 登録されているシンボルの数を取得します。
+ * 空文字列のシンボルは含みません。
+ *
+ * in: 文字列プール構造体のポインタ
+ *
+ * 戻り値
+ *  シンボル数を返します。
+ */
+APIEXPORT int intern_count(struct intern_t* in)
+{
+    return (int)ATOMIC_LOAD_ACQUIRE(&in->count) - 1;
+}
+
+/*
+ * 文字列プールをファイルに出力します。
+ * ハッシュ表とシンボル順の文字列(長さ、文字列、'\0')を出力するため、
+ * intern_read() で同じシンボルのプールを復元できます。
+ *
+ * in: 文字列プール構造体のポインタ
+ * fp: 出力先のファイルポインタ
+ *
+ * 戻り値
+ *  出力したバイト数を返します。
+ *  エラーの場合は -1 を返します。
+ */
+APIEXPORT int64 intern_write(struct intern_t* in, FILE* fp)
+{
+    int64 size = 0;
+    unsigned int sym;
+
+    CS_START(&in->critical_section);
+    if (fwrite(&in->count, sizeof(unsigned int), 1, fp) != 1 ||
+        fwrite(&in->capacity, sizeof(unsigned int), 1, fp) != 1 ||
+        fwrite(in->slots, sizeof(unsigned int), in->capacity, fp) != in->capacity) {
+        size = -1;
+        goto final;
+    }
+    size = (int64)sizeof(unsigned int) * (2 + in->capacity);
+    for (sym = 1; sym < in->count; sym++) {
+        const char* s = symbol_string(in, sym);
+        int n = LEN_SIZE + string_len(s) + 1;
+
+        if (fwrite(s - LEN_SIZE, n, 1, fp) != 1) {
+            size = -1;
+            goto final;
+        }
+        size += n;
+    }
+
+final:
+    CS_END(&in->critical_section);
+    return size;
+}
+
+/*
+ * intern_write() で出力したデータから文字列プールを復元します。
+ * プールは空(初期化直後)である必要があります。
+ * 文字列は一つのブロックにまとめてコピーするため、data は呼び出し後に解放できます。
+ *
+ * in: 文字列プール構造体のポインタ
+ * data: intern_write() で出力したデータ
+ * size: データのバイト数
+ *
+ * 戻り値
+ *  復元できた場合はゼロを返します。
+ *  データが壊れている場合やエラーの場合は -1 を返します。
+ */
+APIEXPORT int intern_read(struct intern_t* in, const char* data, int64 size)
+{
+    unsigned int count, capacity;
+    unsigned int* slots;
+    struct intern_block_t* b;
+    int64 strsize;
+    char* p;
+    char* endp;
+    unsigned int sym;
+
+    if (in->count != 1 || size < (int64)sizeof(unsigned int) * 2)
+        return -1;
+    memcpy(&count, data, sizeof(unsigned int));
+    memcpy(&capacity, data + sizeof(unsigned int), sizeof(unsigned int));
+    if (count < 1 || (count >> INTERN_PAGE_BITS) >= INTERN_MAX_PAGES ||
+        capacity < count || (capacity & (capacity - 1)) != 0)
+        return -1;
+    strsize = size - (int64)sizeof(unsigned int) * (2 + capacity);
+    if (strsize < 0)
+        return -1;
+
+    slots = (unsigned int*)malloc(sizeof(unsigned int) * capacity);
+    b = (struct intern_block_t*)malloc(sizeof(struct intern_block_t) + (size_t)strsize);
+    if (slots == NULL || b == NULL) {
+        if (slots)
+            free(slots);
+        if (b)
+            free(b);
+        err_write("intern: No memory.");
+        return -1;
+    }
+    memcpy(slots, data + sizeof(unsigned int) * 2, sizeof(unsigned int) * capacity);
+    /* ハッシュ表のシンボルが範囲外の場合は壊れたデータとして扱います。*/
+    for (sym = 0; sym < capacity; sym++) {
+        if (slots[sym] >= count) {
+            free(slots);
+            free(b);
+            return -1;
+        }
+    }
+    p = (char*)(b + 1);
+    memcpy(p, data + sizeof(unsigned int) * (2 + capacity), (size_t)strsize);
+    endp = p + strsize;
+
+    CS_START(&in->critical_section);
+    for (sym = 1; sym < count; sym++) {
+        unsigned int page = sym >> INTERN_PAGE_BITS;
+        int len;
+
+        if (in->pages[page] == NULL) {
+            in->pages[page] = (const char**)calloc(INTERN_PAGE_SIZE, sizeof(const char*));
+            if (in->pages[page] == NULL)
+                break;
+        }
+        if (endp - p < LEN_SIZE + 1)
+            break;
+        memcpy(&len, p, LEN_SIZE);
+        if (len < 1 || endp - p < LEN_SIZE + len + 1)
+            break;
+        in->pages[page][sym & (INTERN_PAGE_SIZE - 1)] = p + LEN_SIZE;
+        p += LEN_SIZE + len + 1;
+    }
+    if (sym < count || p != endp) {
+        /* 壊れたデータの場合は空のプールに戻します。*/
+        for (sym = 1; sym < count && (sym >> INTERN_PAGE_BITS) < INTERN_MAX_PAGES; sym++) {
+            if (in->pages[sym >> INTERN_PAGE_BITS])
+                in->pages[sym >> INTERN_PAGE_BITS][sym & (INTERN_PAGE_SIZE - 1)] = NULL;
+        }
+        CS_END(&in->critical_section);
+        free(slots);
+        free(b);
+        return -1;
+    }
+    free(in->slots);
+    in->slots = slots;
+    in->capacity = capacity;
+    ATOMIC_STORE_RELEASE(&in->count, count);
+    b->next = in->block;
+    in->block = b;
+    CS_END(&in->critical_section);
+    return 0;
+}
@@ -0,0 +1,70 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2008-2020 YAMAMOTO Naoki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+#include "csect.h"
+#include "apiexp.h"
+
+#define INTERN_PAGE_BITS    12
+#define INTERN_PAGE_SIZE    (1 << INTERN_PAGE_BITS)
+#define INTERN_MAX_PAGES    (1 << 16)
+
+#define INTERN_NONE         0xFFFFFFFFU     /* 登録されていない文字列 */
+
+struct intern_block_t;
+
+struct intern_t {
+    CS_DEF(critical_section);
+    unsigned int count;                 /* シンボル数(空文字列のシンボル0を含む) */
+    unsigned int capacity;              /* slots の要素数(2のべき乗) */
+    unsigned int* slots;                /* シンボルのハッシュ表(0は空き) */
+    const char** pages[INTERN_MAX_PAGES];   /* シンボル→文字列 */
+    struct intern_block_t* block;       /* 文字列の格納領域 */
+    char* block_ptr;                    /* 格納領域の空き位置 */
+    int block_remain;                   /* 格納領域の残りバイト数 */
+};
+
+/* prototypes */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+APIEXPORT struct intern_t* intern_initialize(void);
+APIEXPORT void intern_finalize(struct intern_t* in);
+APIEXPORT unsigned int intern_put(struct intern_t* in, const char* str);
+APIEXPORT unsigned int intern_put_len(struct intern_t* in, const char* str, int len);
+APIEXPORT unsigned int intern_get(struct intern_t* in, const char* str);
+APIEXPORT const char* intern_str(struct intern_t* in, unsigned int sym);
+APIEXPORT int intern_len(struct intern_t* in, unsigned int sym);
+APIEXPORT int intern_count(struct intern_t* in);
+APIEXPORT int64 intern_write(struct intern_t* in, FILE* fp);
+APIEXPORT int intern_read(struct intern_t* in, const char* data, int64 size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INTERN_H_ */
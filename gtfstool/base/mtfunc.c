@@ -31,6 +31,7 @@
 
 #ifdef _WIN32
 #include <WinSock2.h>
+#include <process.h>
 #else
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -136,3 +137,152 @@ APIEXPORT void mt_decrement64(int64* counter)
     (*counter)--;
     CS_END(&counter_critical_section);
 }
+
+/*
+ * 使用可能なCPU(コア)数を返します。
+ *
+ * 戻り値
+ *  CPU数を返します。取得できない場合は 1 を返します。
+ */
+APIEXPORT int mt_cpu_count()
+{
+    int n;
+
+#ifdef _WIN32
+    SYSTEM_INFO si;
+
+    GetSystemInfo(&si);
+    n = (int)si.dwNumberOfProcessors;
+#else
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (n > 0)? n : 1;
+}
+
+struct mt_parallel_t {
+    CS_DEF(critical_section);
+    int next_job;
+    int njobs;
+    MT_JOB_FUNC func;
+    void* arg;
+};
+
+struct mt_worker_t {
+    struct mt_parallel_t* par;
+    int worker_no;
+};
+
+static void parallel_worker(struct mt_worker_t* w)
+{
+    struct mt_parallel_t* par = w->par;
+
+    while (1) {
+        int job_no;
+
+        CS_START(&par->critical_section);
+        job_no = par->next_job++;
+        CS_END(&par->critical_section);
+
+        if (job_no >= par->njobs)
+            break;
+        (*par->func)(job_no, w->worker_no, par->arg);
+    }
+}
+
+#ifdef _WIN32
+static unsigned __stdcall parallel_thread(void* argv)
+{
+    parallel_worker((struct mt_worker_t*)argv);
+    _endthreadex(0);
+    return 0;
+}
+#else
+static void* parallel_thread(void* argv)
+{
+    parallel_worker((struct mt_worker_t*)argv);
+    return NULL;
+}
+#endif
+
+/*
+ * ジョブを複数のスレッドで並列に実行します。
+ *
+ * ジョブ番号(0〜njobs-1)は番号の小さい順に空いているスレッドに割り当てられます。
+ * 呼び出したスレッドもワーカー(worker_no=0)として処理を行います。
+ * すべてのジョブが終了するまで戻りません。
+ * nthreads が 1 以下の場合は呼び出したスレッドで順番に実行します。
+ *
+ * nthreads: スレッド数
+ * njobs: ジョブ数
+ * func: ジョブを実行する関数(job_no, worker_no, arg)
+ * arg: 関数に渡される引数
+ *
+ * 戻り値
+ *  実際に使用したスレッド数を返します。
+ */
+APIEXPORT int mt_parallel(int nthreads, int njobs, MT_JOB_FUNC func, void* arg)
+{
+    struct mt_parallel_t par;
+    struct mt_worker_t* workers;
+#ifdef _WIN32
+    HANDLE* threads;
+#else
+    pthread_t* threads;
+#endif
+    int i, n;
+
+    if (nthreads > njobs)
+        nthreads = njobs;
+    if (nthreads <= 1) {
+        for (i = 0; i < njobs; i++)
+            (*func)(i, 0, arg);
+        return 1;
+    }
+
+    CS_INIT(&par.critical_section);
+    par.next_job = 0;
+    par.njobs = njobs;
+    par.func = func;
+    par.arg = arg;
+
+    workers = (struct mt_worker_t*)calloc(nthreads, sizeof(struct mt_worker_t));
+#ifdef _WIN32
+    threads = (HANDLE*)calloc(nthreads, sizeof(HANDLE));
+#else
+    threads = (pthread_t*)calloc(nthreads, sizeof(pthread_t));
+#endif
+
+    n = 1;
+    for (i = 1; i < nthreads; i++) {
+        workers[i].par = &par;
+        workers[i].worker_no = i;
+#ifdef _WIN32
+        threads[i] = (HANDLE)_beginthreadex(NULL, 0, parallel_thread, &workers[i], 0, NULL);
+        if (threads[i] == 0) {
+#else
+        if (pthread_create(&threads[i], NULL, parallel_thread, &workers[i]) != 0) {
+#endif
+            err_write("mt_parallel: can't create thread.");
+            break;
+        }
+        n++;
+    }
+
+    workers[0].par = &par;
+    workers[0].worker_no = 0;
+    parallel_worker(&workers[0]);
+
+    for (i = 1; i < n; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+
+    free(threads);
+    free(workers);
+    CS_DELETE(&par.critical_section);
+    return n;
+}
@@ -35,6 +35,9 @@
 
 #include "common.h"
 
+/* 並列実行されるジョブの関数 */
+typedef void (*MT_JOB_FUNC)(int job_no, int worker_no, void* arg);
+
 /* prototypes */
 #ifdef __cplusplus
 extern "C" {
@@ -50,6 +53,8 @@ APIEXPORT void mt_increment(long* counter);
 APIEXPORT void mt_decrement(long* counter);
 APIEXPORT void mt_increment64(int64* counter);
 APIEXPORT void mt_decrement64(int64* counter);
+APIEXPORT int mt_cpu_count(void);
+APIEXPORT int mt_parallel(int nthreads, int njobs, MT_JOB_FUNC func, void* arg);
 
 #ifdef __cplusplus
 }
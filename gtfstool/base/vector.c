@@ -36,25 +36,39 @@
  *
  * 管理できるポインタ数に制限はありません。
  * init_capacity(要素数)が足りなくなった場合は自動的に増加します。
+ *
+ * 一つのスレッドだけが使用するベクタはロックしない vect_append_unlocked()、
+ * vect_get_unlocked()関数を使用できます。作成後に参照だけを行うベクタは
+ * vect_freeze()関数で凍結すると、vect_get()関数がロックせずに参照します。
  */
 
 #define INC_SIZE 100
 
-static int increase_vector(struct vector_t* vt)
+static int resize_vector(struct vector_t* vt, int capacity)
 {
     void** tp;
-    
-    /* 管理領域の増分 */
-    tp = (void**)realloc(vt->ptr, (vt->capacity+INC_SIZE) * sizeof(void*));
+
+    tp = (void**)realloc(vt->ptr, capacity * sizeof(void*));
     if (tp == NULL) {
         err_write("vector: no memory.");
         return -1;
     }
     vt->ptr = tp;
-    vt->capacity += INC_SIZE;
+    vt->capacity = capacity;
     return 0;
 }
 
+static int increase_vector(struct vector_t* vt)
+{
+    int inc;
+
+    /* 管理領域の増分（大きなテーブルで再確保が繰り返されないように現在の半分ずつ増やします）*/
+    inc = vt->capacity / 2;
+    if (inc < INC_SIZE)
+        inc = INC_SIZE;
+    return resize_vector(vt, vt->capacity + inc);
+}
+
 /*
  * ベクタテーブルの初期処理を行ないます。
  * データを管理するためのメモリを確保します。
@@ -82,6 +96,7 @@ APIEXPORT struct vector_t* vect_initialize(int init_capacity)
     }
     vt->capacity = init_capacity;
     vt->count = 0;
+    vt->frozen = 0;
 
     /* クリティカルセクションの初期化 */
     CS_INIT(&vt->critical_section);
@@ -90,31 +105,89 @@ APIEXPORT struct vector_t* vect_initialize(int init_capacity)
 }
 
 /*
- * ベクタテーブルにポインタを追加します。
+ * ベクタテーブルの管理領域を指定された数まで確保します。
+ * 追加する件数が事前にわかる場合に呼び出すことで再確保を抑えます。
+ * 現在の管理領域が十分な場合は何もしません。
  *
  * vt: ベクタテーブル構造体のポインタ
- * ptr: 追加するポインタ値
+ * capacity: 確保するポインタの数
  *
  * 戻り値
- *  正常に追加された場合はゼロを返します。
+ *  正常に確保された場合はゼロを返します。
  *  エラーの場合は -1 を返します。
  */
-APIEXPORT int vect_append(struct vector_t* vt, const void* ptr)
+APIEXPORT int vect_reserve(struct vector_t* vt, int capacity)
 {
     int result = 0;
 
     CS_START(&vt->critical_section);
-    if (vt->count >= vt->capacity)
+    if (capacity > vt->capacity && ! vt->frozen)
+        result = resize_vector(vt, capacity);
+    CS_END(&vt->critical_section);
+    return result;
+}
+
+static int frozen_error(struct vector_t* vt)
+{
+    if (vt->frozen) {
+        err_write("vector: update to frozen vector.");
+        return -1;
+    }
+    return 0;
+}
+
+static int append_ptr(struct vector_t* vt, const void* ptr)
+{
+    int result;
+
+    result = frozen_error(vt);
+    if (result == 0 && vt->count >= vt->capacity)
         result = increase_vector(vt);
 
     if (result == 0) {
         vt->ptr[vt->count] = (void*)ptr;
         vt->count++;
     }
+    return result;
+}
+
+/*
+ * ベクタテーブルにポインタを追加します。
+ * 凍結されたベクタテーブルには追加できません。
+ *
+ * vt: ベクタテーブル構造体のポインタ
+ * ptr: 追加するポインタ値
+ *
+ * 戻り値
+ *  正常に追加された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+APIEXPORT int vect_append(struct vector_t* vt, const void* ptr)
+{
+    int result;
+
+    CS_START(&vt->critical_section);
+    result = append_ptr(vt, ptr);
     CS_END(&vt->critical_section);
     return result;
 }
 
+/*
+ * ベクタテーブルにポインタを追加します(ロックしません)。
+ * 一つのスレッドだけが使用するベクタテーブルに使用します。
+ *
+ * vt: ベクタテーブル構造体のポインタ
+ * ptr: 追加するポインタ値
+ *
+ * 戻り値
+ *  正常に追加された場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+APIEXPORT int vect_append_unlocked(struct vector_t* vt, const void* ptr)
+{
+    return append_ptr(vt, ptr);
+}
+
 /*
  * ベクタテーブルからポインタを削除します。
  *
@@ -129,7 +202,7 @@ APIEXPORT int vect_delete(struct vector_t* vt, const void* ptr)
     int i;
 
     CS_START(&vt->critical_section);
-    for (i = 0; i < vt->count; i++) {
+    for (i = 0; i < vt->count && frozen_error(vt) == 0; i++) {
         if (vt->ptr[i] == ptr) {
             /* 数をマイナスします。*/
             vt->count--;
@@ -163,7 +236,9 @@ APIEXPORT int vect_insert(struct vector_t* vt, int index, const void* ptr)
     int result = 0;
 
     CS_START(&vt->critical_section);
-    if (index < 0 || index >= vt->count) {
+    if (frozen_error(vt) < 0) {
+        result = -1;
+    } else if (index < 0 || index >= vt->count) {
         err_write("vector: index is out of bounds[%d], count=%d.", index, vt->count);
         result = -1;
     } else {
@@ -203,7 +278,7 @@ APIEXPORT int vect_update(struct vector_t* vt, const void* ptr, const void* new_
     int result = -1;
 
     CS_START(&vt->critical_section);
-    for (i = 0; i < vt->count; i++) {
+    for (i = 0; i < vt->count && frozen_error(vt) == 0; i++) {
         if (vt->ptr[i] == ptr) {
             vt->ptr[i] = (void*)new_ptr;
             result = 0;
@@ -214,8 +289,18 @@ APIEXPORT int vect_update(struct vector_t* vt, const void* ptr, const void* new_
     return result;
 }
 
+static void* get_ptr(struct vector_t* vt, int index)
+{
+    if (index < 0 || index >= vt->count) {
+        err_write("vector: index is out of bounds[%d], count=%d.", index, vt->count);
+        return NULL;
+    }
+    return vt->ptr[index];
+}
+
 /*
  * ベクタテーブルからポインタ値を取得します。
+ * 凍結されたベクタテーブルはロックせずに参照します。
  *
  * vt: ベクタテーブル構造体のポインタ
  * index: ゼロからのインデックス
@@ -226,17 +311,52 @@ APIEXPORT int vect_update(struct vector_t* vt, const void* ptr, const void* new_
  */
 APIEXPORT void* vect_get(struct vector_t* vt, int index)
 {
-    void* p = NULL;
+    void* p;
+
+    if (vt->frozen)
+        return get_ptr(vt, index);
 
     CS_START(&vt->critical_section);
-    if (index < 0 || index >= vt->count)
-        err_write("vector: index is out of bounds[%d], count=%d.", index, vt->count);
-    else
-        p = vt->ptr[index];
+    p = get_ptr(vt, index);
     CS_END(&vt->critical_section);
     return p;
 }
 
+/*
+ * ベクタテーブルからポインタ値を取得します(ロックしません)。
+ * 一つのスレッドだけが使用するベクタテーブルに使用します。
+ *
+ * vt: ベクタテーブル構造体のポインタ
+ * index: ゼロからのインデックス
+ *
+ * 戻り値
+ *  ベクタテーブルのポインタを返します。
+ *  エラーの場合は NULL を返します。
+ */
+APIEXPORT void* vect_get_unlocked(struct vector_t* vt, int index)
+{
+    return get_ptr(vt, index);
+}
+
+/*
+ * ベクタテーブルを凍結して読み込み専用にします。
+ *
+ * 凍結後は追加、挿入、削除、更新がエラーになり、vect_get() はロックせずに参照します。
+ * 作成が終わったベクタテーブルを凍結してから複数のスレッドで参照すると
+ * ロックの競合なしに参照できます。凍結はスレッドを開始する前に行います。
+ *
+ * vt: ベクタテーブル構造体のポインタ
+ *
+ * 戻り値
+ *  なし
+ */
+APIEXPORT void vect_freeze(struct vector_t* vt)
+{
+    CS_START(&vt->critical_section);
+    vt->frozen = 1;
+    CS_END(&vt->critical_section);
+}
+
 /*
  * ベクタテーブルの個数を返します。
  *
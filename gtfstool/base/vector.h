@@ -33,6 +33,7 @@ struct vector_t {
     int capacity;   /* number of allocate */
     int count;      /* count */
     void** ptr;     /* pointer array */
+    int frozen;     /* read only */
 };
 
 /* prototypes */
@@ -41,12 +42,16 @@ extern "C" {
 #endif
 
 APIEXPORT struct vector_t* vect_initialize(int init_capacity);
+APIEXPORT int vect_reserve(struct vector_t* vt, int capacity);
 APIEXPORT int vect_append(struct vector_t* vt, const void* ptr);
+APIEXPORT int vect_append_unlocked(struct vector_t* vt, const void* ptr);
 APIEXPORT int vect_delete(struct vector_t* vt, const void* ptr);
 APIEXPORT int vect_insert(struct vector_t* vt, int index, const void* ptr);
 APIEXPORT int vect_update(struct vector_t* vt, const void* ptr, const void* new_ptr);
 APIEXPORT int vect_count(struct vector_t* vt);
 APIEXPORT void* vect_get(struct vector_t* vt, int index);
+APIEXPORT void* vect_get_unlocked(struct vector_t* vt, int index);
+APIEXPORT void vect_freeze(struct vector_t* vt);
 APIEXPORT int vect_list(struct vector_t* vt, void** list, int count);
 APIEXPORT void vect_finalize(struct vector_t* vt);
 
@@ -46,7 +46,7 @@ static int gtfs_is_free_bus()
         struct stop_t* stop;
 
         stop = (struct stop_t*)vect_get(g_gtfs->stops_tbl, i);
-        if (atoi(stop->location_type) == 0) {
+        if (stop->location_type_value == 0) {
             if (strlen(stop->zone_id) != 0) {
                 is_free = 0;
                 break;
@@ -562,11 +562,28 @@ static int gtfs_hash_routes_jp_table()
     return result;
 }
 
+// 読み込んだ件数からハッシュテーブルの大きさを決めます。
+static void gtfs_hash_reserve()
+{
+    hash_reserve(g_gtfs_hash->agency_htbl, vect_count(g_gtfs->agency_tbl));
+    hash_reserve(g_gtfs_hash->routes_htbl, vect_count(g_gtfs->routes_tbl));
+    hash_reserve(g_gtfs_hash->stops_htbl, vect_count(g_gtfs->stops_tbl));
+    hash_reserve(g_gtfs_hash->trips_htbl, vect_count(g_gtfs->trips_tbl));
+    hash_reserve(g_gtfs_hash->calendar_htbl, vect_count(g_gtfs->calendar_tbl));
+    hash_reserve(g_gtfs_hash->calendar_dates_htbl, vect_count(g_gtfs->calendar_dates_tbl));
+    hash_reserve(g_gtfs_hash->fare_attrs_htbl, vect_count(g_gtfs->fare_attrs_tbl));
+    hash_reserve(g_gtfs_hash->fare_rules_htbl, vect_count(g_gtfs->fare_rules_tbl));
+    hash_reserve(g_gtfs_hash->translations_htbl, vect_count(g_gtfs->translations_tbl));
+    hash_reserve(g_gtfs_hash->routes_jp_htbl, vect_count(g_gtfs->routes_jp_tbl));
+}
+
 int gtfs_hash_table_key_check()
 {
     int result = 0;
     int ret;
 
+    gtfs_hash_reserve();
+
     ret = gtfs_hash_agency_table();
     if (ret < result)
         result = ret;
@@ -819,44 +836,44 @@ static int stop_times_column_check()
         struct stop_time_t* st;
         
         st = (struct stop_time_t*)vect_get(g_gtfs->stop_times_tbl, i);
-        if (strlen(st->trip_id) < 1) {
+        if (st->trip_id == 0) {
             int ret = gtfs_error("stop_times.txtの%d行目のtrip_idは必須項目です。", st->lineno);
             if (ret < result)
                 result = ret;
         }
-        if (strlen(st->arrival_time) < 1) {
+        if (! (st->flags & ST_HAS(ST_ARRIVAL_TIME))) {
             int ret = gtfs_error("stop_times.txtの%d行目のarrival_timeは必須項目です。", st->lineno);
             if (ret < result)
                 result = ret;
         }
-        if (strlen(st->departure_time) < 1) {
+        if (! (st->flags & ST_HAS(ST_DEPARTURE_TIME))) {
             int ret = gtfs_error("stop_times.txtの%d行目のdeparture_timeは必須項目です。", st->lineno);
             if (ret < result)
                 result = ret;
         }
-        if (strlen(st->stop_id) < 1) {
+        if (st->stop_id == 0) {
             int ret = gtfs_error("stop_times.txtの%d行目のstop_idは必須項目です。", st->lineno);
             if (ret < result)
                 result = ret;
         }
-        if (strlen(st->stop_sequence) < 1) {
+        if (! (st->flags & ST_HAS(ST_STOP_SEQUENCE))) {
             int ret = gtfs_error("stop_times.txtの%d行目のstop_sequenceは必須項目です。", st->lineno);
             if (ret < result)
                 result = ret;
         }
         // trip_idがtrips.txtに登録されているかチェック
-        if (! trip_id_check(st->trip_id)) {
+        if (! trip_id_check(gtfs_id(st->trip_id))) {
             int ret = gtfs_error("stop_times.txtの%d行目のtrip_id[%s]がtrips.txtに存在していません。",
                                  st->lineno,
-                                 utf8_conv(st->trip_id, (char*)alloca(256), 256));
+                                 utf8_conv(gtfs_id(st->trip_id), (char*)alloca(256), 256));
             if (ret < result)
                 result = ret;
         }
         // stop_idがstops.txtに登録されているかチェック
-        if (! stop_id_check(st->stop_id)) {
+        if (! stop_id_check(gtfs_id(st->stop_id))) {
             int ret = gtfs_error("stop_times.txtの%d行目のstop_id[%s]がstops.txtに存在していません。",
                                  st->lineno,
-                                 utf8_conv(st->stop_id, (char*)alloca(256), 256));
+                                 utf8_conv(gtfs_id(st->stop_id), (char*)alloca(256), 256));
             if (ret < result)
                 result = ret;
         }
@@ -1155,6 +1172,26 @@ static int translations_column_check()
     return result;
 }
 
+/*
+ * 読み込み時に検出した値の書式エラーを出力します。
+ * 数値項目は読み込み時に変換しているため、変換できなかった値をここで報告します。
+ */
+static int gtfs_value_format_check()
+{
+    int result = 0;
+    int i, n;
+
+    n = vect_count(g_gtfs->value_errors);
+    for (i = 0; i < n; i++) {
+        struct gtfs_value_error_t* ve = (struct gtfs_value_error_t*)vect_get(g_gtfs->value_errors, i);
+        int ret = gtfs_error("%sの%d行目の%s[%s]の値が正しくありません。",
+                             g_gtfs_filename[ve->kind], ve->lineno, ve->column, ve->value);
+        if (ret < result)
+            result = ret;
+    }
+    return result;
+}
+
 static int gtfs_column_exist_check()
 {
     int result = 0;
@@ -1217,151 +1254,759 @@ static int gtfs_column_exist_check()
     return result;
 }
 
-static int trip_timetable_put_index(struct vector_t* times, struct stop_time_t* stoptime)
+#define TIMETABLE_PARALLEL_MIN  100000  // 並列に並べ替える通過時刻の最小件数
+#define TIMETABLE_RADIX_BITS    8
+#define TIMETABLE_RADIX_SIZE    (1 << TIMETABLE_RADIX_BITS)
+
+// 並べ替えのキー
+struct timetable_key_t {
+    uint64 key;         // 上位32ビット:便番号 下位32ビット:stop_sequence(符号反転)
+    int row;            // stop_times_tbl のインデックス
+};
+
+// 通過時刻の並べ替え（チャンクに分割して並列に処理します）
+struct timetable_sorter_t {
+    int count;                          // 通過時刻の件数
+    int nchunks;                        // チャンク数
+    int chunk_size;                     // チャンクごとの件数
+    struct timetable_key_t* src;
+    struct timetable_key_t* dst;
+    int shift;                          // 処理中の桁のビット位置
+    int* hist;                          // チャンクごとの桁の値の件数（→格納位置）
+    int* missing;                       // チャンクごとの便が見つからない件数
+    uint64* key_or;                     // チャンクごとのキーの論理和
+    uint64* key_and;                    // チャンクごとのキーの論理積
+};
+
+// stop_time の trip_id のシンボルから便番号を求めます。
+static int stop_time_trip_no(const struct stop_time_t* st)
+{
+    if (st->trip_id >= (uint32)g_vehicle_timetable.sym_count)
+        return -1;
+    return g_vehicle_timetable.sym_trip_no[st->trip_id];
+}
+
+static void timetable_key_job(int job_no, int worker_no, void* arg)
+{
+    struct timetable_sorter_t* ts = (struct timetable_sorter_t*)arg;
+    int start, end, i;
+    uint64 key_or = 0;
+    uint64 key_and = ~(uint64)0;
+
+    (void)worker_no;    // 未使用
+    start = job_no * ts->chunk_size;
+    end = (start + ts->chunk_size < ts->count)? start + ts->chunk_size : ts->count;
+    for (i = start; i < end; i++) {
+        struct stop_time_t* st;
+        int trip_no;
+        uint64 key;
+
+        st = (struct stop_time_t*)vect_get_unlocked(g_gtfs->stop_times_tbl, i);
+        trip_no = stop_time_trip_no(st);
+        if (trip_no < 0) {
+            // 便が見つからない通過時刻は最後に並べて取り除く
+            trip_no = g_vehicle_timetable.count;
+            ts->missing[job_no]++;
+        }
+        key = ((uint64)trip_no << 32) | ((uint32)st->stop_sequence ^ 0x80000000U);
+        ts->src[i].key = key;
+        ts->src[i].row = i;
+        key_or |= key;
+        key_and &= key;
+    }
+    ts->key_or[job_no] = key_or;
+    ts->key_and[job_no] = key_and;
+}
+
+static void timetable_hist_job(int job_no, int worker_no, void* arg)
 {
+    struct timetable_sorter_t* ts = (struct timetable_sorter_t*)arg;
+    int* hist = ts->hist + job_no * TIMETABLE_RADIX_SIZE;
+    int start, end, i;
+
+    (void)worker_no;    // 未使用
+    start = job_no * ts->chunk_size;
+    end = (start + ts->chunk_size < ts->count)? start + ts->chunk_size : ts->count;
+    memset(hist, '\0', sizeof(int) * TIMETABLE_RADIX_SIZE);
+    for (i = start; i < end; i++)
+        hist[(ts->src[i].key >> ts->shift) & (TIMETABLE_RADIX_SIZE-1)]++;
+}
+
+static void timetable_scatter_job(int job_no, int worker_no, void* arg)
+{
+    struct timetable_sorter_t* ts = (struct timetable_sorter_t*)arg;
+    int* pos = ts->hist + job_no * TIMETABLE_RADIX_SIZE;
+    int start, end, i;
+
+    (void)worker_no;    // 未使用
+    start = job_no * ts->chunk_size;
+    end = (start + ts->chunk_size < ts->count)? start + ts->chunk_size : ts->count;
+    for (i = start; i < end; i++)
+        ts->dst[pos[(ts->src[i].key >> ts->shift) & (TIMETABLE_RADIX_SIZE-1)]++] = ts->src[i];
+}
+
+/*
+ * 通過時刻を(便番号, stop_sequence)の順に安定に並べ替えます。
+ * 下位の桁から基数ソートを行い、すべてのキーで値が同じ桁は省略します。
+ * 並べ替えた結果は ts->src に格納されます。
+ */
+static void timetable_radix_sort(struct timetable_sorter_t* ts, int nthreads)
+{
+    uint64 key_or = 0;
+    uint64 key_and = ~(uint64)0;
+    int i;
+
+    mt_parallel(nthreads, ts->nchunks, timetable_key_job, ts);
+    for (i = 0; i < ts->nchunks; i++) {
+        key_or |= ts->key_or[i];
+        key_and &= ts->key_and[i];
+    }
+
+    for (ts->shift = 0; ts->shift < 64; ts->shift += TIMETABLE_RADIX_BITS) {
+        struct timetable_key_t* tmp;
+        int digit, pos;
+
+        if ((((key_or ^ key_and) >> ts->shift) & (TIMETABLE_RADIX_SIZE-1)) == 0)
+            continue;   // すべて同じ値の桁
+
+        mt_parallel(nthreads, ts->nchunks, timetable_hist_job, ts);
+
+        // 桁の値ごとにチャンクの順で格納位置を割り当てる（安定）
+        pos = 0;
+        for (digit = 0; digit < TIMETABLE_RADIX_SIZE; digit++) {
+            for (i = 0; i < ts->nchunks; i++) {
+                int n = ts->hist[i * TIMETABLE_RADIX_SIZE + digit];
+
+                ts->hist[i * TIMETABLE_RADIX_SIZE + digit] = pos;
+                pos += n;
+            }
+        }
+        mt_parallel(nthreads, ts->nchunks, timetable_scatter_job, ts);
+
+        tmp = ts->src;
+        ts->src = ts->dst;
+        ts->dst = tmp;
+    }
+}
+
+// 通過時刻表を作成
+/*
+ * 停留所番号を割り当てて parent_station の参照件数を求めます。
+ * stop_times.txtの参照件数は gtfs_vehicle_timetable() で数えます。
+ *
+ * sym_count: stop_idのシンボルの数
+ *
+ * 戻り値
+ *  stop_idのシンボル → 停留所番号（-1:停留所なし）の配列を返します。
+ */
+static int* stop_usage_build(int sym_count)
+{
+    struct stop_usage_t* su = &g_stop_usage;
+    int* sym_stop_no;
     int count, i;
-    struct stop_time_t* st;
 
-    count = vect_count(times);
-    if (count == 0)
-        return -1;
+    count = vect_count(g_gtfs->stops_tbl);
+    su->count = 0;
+    su->stops = (struct stop_t**)malloc(sizeof(struct stop_t*) * (count+1));
+    su->stop_no_htbl = hash_initialize(1009);
+    hash_reserve(su->stop_no_htbl, count);
+    for (i = 0; i < count; i++) {
+        struct stop_t* stop;
+
+        stop = (struct stop_t*)vect_get(g_gtfs->stops_tbl, i);
+        if (hash_get_unlocked(su->stop_no_htbl, stop->stop_id))
+            continue;
+        su->stops[su->count++] = stop;
+        hash_put_unlocked(su->stop_no_htbl, stop->stop_id, (void*)(int64)su->count);
+    }
+    su->stop_times_count = (int*)calloc(su->count+1, sizeof(int));
+    su->child_count = (int*)calloc(su->count+1, sizeof(int));
+
+    // 親停留所として参照されている件数
+    for (i = 0; i < count; i++) {
+        struct stop_t* stop;
+        int stop_no;
+
+        stop = (struct stop_t*)vect_get(g_gtfs->stops_tbl, i);
+        if (strlen(stop->parent_station) == 0)
+            continue;
+        stop_no = gtfs_stop_no(stop->parent_station);
+        if (stop_no >= 0)
+            su->child_count[stop_no]++;
+    }
+
+    // stop_idのシンボル → 停留所番号（stop_times.txtに現れないIDはシンボルがない）
+    sym_stop_no = (int*)malloc(sizeof(int) * (sym_count+1));
+    for (i = 0; i < sym_count; i++)
+        sym_stop_no[i] = -1;
+    for (i = 0; i < su->count; i++) {
+        uint32 sym;
 
-    // 最後のエントリよりも大きければ追加
-    st = vect_get(times, count-1);
-    if (st) {
-        if (atoi(stoptime->stop_sequence) > atoi(st->stop_sequence))
-            return -1;
+        sym = gtfs_id_find(su->stops[i]->stop_id);
+        if (sym != INTERN_NONE && sym < (uint32)sym_count)
+            sym_stop_no[sym] = i;
     }
+    return sym_stop_no;
+}
+
+// 通過時刻の停留所の参照件数を加算する
+static void stop_usage_count(const int* sym_stop_no, int sym_count, const struct stop_time_t* st)
+{
+    if (st->stop_id < (uint32)sym_count && sym_stop_no[st->stop_id] >= 0)
+        g_stop_usage.stop_times_count[sym_stop_no[st->stop_id]]++;
+}
+
+// 停留所の並びのハッシュ値（停車数も含めます）
+static uint64 stop_pattern_fingerprint(struct stop_time_t** stop_times, int count)
+{
+    uint64 h = 0xcbf29ce484222325ULL ^ (uint64)count;
+    int i;
 
-    // 挿入位置を検索
     for (i = 0; i < count; i++) {
-        st = vect_get(times, i);
-        if (st) {
-            if (atoi(stoptime->stop_sequence) < atoi(st->stop_sequence))
-                return i;
+        h = (h ^ stop_times[i]->stop_id) * 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+/*
+ * 便ごとの停留所の並びから停車パターン表を作成します。
+ * ハッシュ値が同じ場合は停留所の並びを比較するので、同じパターンの便は停留所の並びも同じです。
+ */
+static void stop_patterns_build()
+{
+    struct trip_timetable_t* tt = &g_vehicle_timetable;
+    struct stop_pattern_table_t* sp = &g_stop_patterns;
+    int* slots;
+    int capacity;
+    int trip_no;
+
+    sp->count = 0;
+    sp->patterns = (struct stop_pattern_t*)malloc(sizeof(struct stop_pattern_t) * (tt->count+1));
+    sp->trip_pattern = (int*)malloc(sizeof(int) * (tt->count+1));
+
+    // ハッシュ値 → パターン番号（オープンアドレス法）
+    capacity = 16;
+    while (capacity < tt->count * 2)
+        capacity <<= 1;
+    slots = (int*)malloc(sizeof(int) * capacity);
+    memset(slots, 0xff, sizeof(int) * capacity);
+
+    for (trip_no = 0; trip_no < tt->count; trip_no++) {
+        struct stop_time_t** stop_times;
+        struct stop_pattern_t* pat;
+        uint64 fp;
+        int count, k;
+
+        stop_times = gtfs_trip_timetable(trip_no, &count);
+        fp = stop_pattern_fingerprint(stop_times, count);
+        k = (int)(fp & (capacity-1));
+        while (slots[k] >= 0) {
+            pat = &sp->patterns[slots[k]];
+            if (pat->fingerprint == fp && pat->stop_count == count) {
+                struct stop_time_t** pat_stop_times;
+                int pat_count, i;
+
+                pat_stop_times = gtfs_trip_timetable(pat->trip_no, &pat_count);
+                for (i = 0; i < count; i++) {
+                    if (pat_stop_times[i]->stop_id != stop_times[i]->stop_id)
+                        break;
+                }
+                if (i == count)
+                    break;  // 同じ停留所の並び
+            }
+            k = (k + 1) & (capacity-1);
+        }
+        if (slots[k] < 0) {
+            pat = &sp->patterns[sp->count];
+            pat->fingerprint = fp;
+            pat->trip_no = trip_no;
+            pat->stop_count = count;
+            pat->trip_count = 0;
+            slots[k] = sp->count++;
         }
+        sp->trip_pattern[trip_no] = slots[k];
+        sp->patterns[slots[k]].trip_count++;
     }
-    return -1;
+    free(slots);
 }
 
-// 通過時刻表を作成
 int gtfs_vehicle_timetable()
 {
     int result = 0;
+    struct trip_timetable_t* tt = &g_vehicle_timetable;
+    struct timetable_sorter_t ts;
+    int* sym_stop_no;
+    int nthreads;
+    int missing;
     int count, i;
-    
-    // tripごとに時刻表を作成
+
+    // 便番号を割り当てる（trips.txtで最初に現れた順）
     count = vect_count(g_gtfs->trips_tbl);
+    tt->count = 0;
+    tt->trips = (struct trip_t**)malloc(sizeof(struct trip_t*) * (count+1));
+    tt->trip_no_htbl = hash_initialize(1009);
+    hash_reserve(tt->trip_no_htbl, count);
     for (i = 0; i < count; i++) {
         struct trip_t* trip;
-        struct vector_t* trip_timetable;
 
         trip = (struct trip_t*)vect_get(g_gtfs->trips_tbl, i);
-        trip_timetable = vect_initialize(100);
-        hash_put(g_vehicle_timetable, trip->trip_id, trip_timetable);
+        if (hash_get_unlocked(tt->trip_no_htbl, trip->trip_id))
+            continue;
+        tt->trips[tt->count++] = trip;
+        hash_put_unlocked(tt->trip_no_htbl, trip->trip_id, (void*)(int64)tt->count);
     }
 
-    // stop_times
+    // trip_idのシンボル → 便番号（シンボル0は空文字列）
+    tt->sym_count = intern_count(g_gtfs_ids) + 1;
+    tt->sym_trip_no = (int*)malloc(sizeof(int) * (tt->sym_count+1));
+    for (i = 0; i < tt->sym_count; i++)
+        tt->sym_trip_no[i] = -1;
+    for (i = 0; i < tt->count; i++) {
+        uint32 sym;
+
+        sym = gtfs_id_find(tt->trips[i]->trip_id);
+        if (sym != INTERN_NONE && sym < (uint32)tt->sym_count)
+            tt->sym_trip_no[sym] = i;
+    }
+
+    // 停留所番号（stop_times.txtの参照件数は並べ替えた後に数える）
+    sym_stop_no = stop_usage_build(tt->sym_count);
+
+    // stop_times を(便番号, stop_sequence)で並べ替える
     count = vect_count(g_gtfs->stop_times_tbl);
-    for (i = 0; i < count; i++) {
-        struct stop_time_t* st;
-        struct vector_t* trip_timetable;
-        int index;
+    nthreads = (g_load_threads > 0)? g_load_threads : mt_cpu_count();
+    if (count < TIMETABLE_PARALLEL_MIN)
+        nthreads = 1;
+    memset(&ts, '\0', sizeof(ts));
+    ts.count = count;
+    ts.nchunks = (nthreads > 1)? nthreads * 2 : 1;
+    ts.chunk_size = count / ts.nchunks + 1;
+    ts.src = (struct timetable_key_t*)malloc(sizeof(struct timetable_key_t) * (count+1));
+    ts.dst = (struct timetable_key_t*)malloc(sizeof(struct timetable_key_t) * (count+1));
+    ts.hist = (int*)malloc(sizeof(int) * TIMETABLE_RADIX_SIZE * ts.nchunks);
+    ts.missing = (int*)calloc(ts.nchunks, sizeof(int));
+    ts.key_or = (uint64*)malloc(sizeof(uint64) * ts.nchunks);
+    ts.key_and = (uint64*)malloc(sizeof(uint64) * ts.nchunks);
+    timetable_radix_sort(&ts, nthreads);
+
+    missing = 0;
+    for (i = 0; i < ts.nchunks; i++)
+        missing += ts.missing[i];
+    if (missing > 0) {
+        for (i = 0; i < count; i++) {
+            struct stop_time_t* st;
 
-        st = (struct stop_time_t*)vect_get(g_gtfs->stop_times_tbl, i);
-        trip_timetable = (struct vector_t*)hash_get(g_vehicle_timetable, st->trip_id);
-        if (! trip_timetable) {
+            st = (struct stop_time_t*)vect_get_unlocked(g_gtfs->stop_times_tbl, i);
+            if (stop_time_trip_no(st) >= 0)
+                continue;
+            // 便が存在しない通過時刻も停留所を参照している
+            stop_usage_count(sym_stop_no, tt->sym_count, st);
             err_write("gtfs_vehicle_timetable(): trip_id not found[%s]\n",
-                      utf8_conv(st->trip_id, (char*)alloca(256), 256));
-            continue;
+                      utf8_conv(gtfs_id(st->trip_id), (char*)alloca(256), 256));
         }
-        index = trip_timetable_put_index(trip_timetable, st);
-        if (index < 0)
-            vect_append(trip_timetable, st);
-        else
-            vect_insert(trip_timetable, index, st);
+        count -= missing;
     }
+
+    // 便ごとの通過時刻の開始位置
+    tt->offsets = (int*)calloc(tt->count+1, sizeof(int));
+    tt->stop_times = (struct stop_time_t**)malloc(sizeof(struct stop_time_t*) * (count+1));
+    for (i = 0; i < count; i++) {
+        tt->offsets[(int)(ts.src[i].key >> 32) + 1]++;
+        tt->stop_times[i] = (struct stop_time_t*)vect_get_unlocked(g_gtfs->stop_times_tbl, ts.src[i].row);
+        stop_usage_count(sym_stop_no, tt->sym_count, tt->stop_times[i]);
+    }
+    for (i = 0; i < tt->count; i++)
+        tt->offsets[i+1] += tt->offsets[i];
+
+    // 便ごとの停車パターン
+    stop_patterns_build();
+
+    free(ts.src);
+    free(ts.dst);
+    free(ts.hist);
+    free(ts.missing);
+    free(ts.key_or);
+    free(ts.key_and);
+    free(sym_stop_no);
     return result;
 }
 
+// 経路の停車パターン（基準となる便を求めるときに使用します）
+struct route_pattern_t {
+    int stop_count;                     // 停車数
+    int trip_count;                     // 経路の中でのパターンの便の数
+    int same_count;                     // 経路の中で停車数が同じ便の数
+};
+
+static int route_pattern_cmp(const void* a, const void* b)
+{
+    const struct route_pattern_t* p1 = *(const struct route_pattern_t**)a;
+    const struct route_pattern_t* p2 = *(const struct route_pattern_t**)b;
+
+    return (p1->stop_count > p2->stop_count) - (p1->stop_count < p2->stop_count);
+}
+
+/*
+ * 経路ごとに停車数が同じ便が最も多い停車数の最初の便を基準とします。
+ * 便ごとではなく経路の中の停車パターンごとに数えます。
+ */
+static void route_base_index_build()
+{
+    struct route_trips_t* rt = &g_route_trips;
+    struct stop_pattern_table_t* sp = &g_stop_patterns;
+    int* pattern_slot;
+    int* trip_slot;
+    struct route_pattern_t* rps;
+    struct route_pattern_t** sorted;
+    int route_no, i;
+
+    rt->base_index = (int*)malloc(sizeof(int) * (rt->count+1));
+    pattern_slot = (int*)malloc(sizeof(int) * (sp->count+1));
+    memset(pattern_slot, 0xff, sizeof(int) * (sp->count+1));
+    trip_slot = (int*)malloc(sizeof(int) * (rt->offsets[rt->count]+1));
+    rps = (struct route_pattern_t*)malloc(sizeof(struct route_pattern_t) * (rt->offsets[rt->count]+1));
+    sorted = (struct route_pattern_t**)malloc(sizeof(struct route_pattern_t*) * (rt->offsets[rt->count]+1));
+
+    for (route_no = 0; route_no < rt->count; route_no++) {
+        int* trip_nos;
+        int count, npatterns;
+        int base_same_count;
+
+        gtfs_route_trip_list(route_no, &trip_nos, &count);
+        rt->base_index[route_no] = -1;
+        if (count == 0)
+            continue;
+
+        // 経路の中の停車パターン
+        npatterns = 0;
+        for (i = 0; i < count; i++) {
+            int pattern_no = gtfs_trip_pattern(trip_nos[i]);
+
+            if (pattern_no < 0) {
+                // 便番号がない場合は停車数0として数える
+                trip_slot[i] = npatterns;
+                rps[npatterns].stop_count = 0;
+                rps[npatterns].trip_count = 1;
+                npatterns++;
+                continue;
+            }
+            if (pattern_slot[pattern_no] < 0) {
+                pattern_slot[pattern_no] = npatterns;
+                rps[npatterns].stop_count = sp->patterns[pattern_no].stop_count;
+                rps[npatterns].trip_count = 0;
+                npatterns++;
+            }
+            trip_slot[i] = pattern_slot[pattern_no];
+            rps[trip_slot[i]].trip_count++;
+        }
+
+        // 停車数ごとの便の数
+        for (i = 0; i < npatterns; i++)
+            sorted[i] = &rps[i];
+        qsort(sorted, npatterns, sizeof(struct route_pattern_t*), route_pattern_cmp);
+        for (i = 0; i < npatterns; ) {
+            int same_count = 0;
+            int j;
+
+            for (j = i; j < npatterns && sorted[j]->stop_count == sorted[i]->stop_count; j++)
+                same_count += sorted[j]->trip_count;
+            for (; i < j; i++)
+                sorted[i]->same_count = same_count;
+        }
+
+        base_same_count = 0;
+        for (i = 0; i < count; i++) {
+            if (rps[trip_slot[i]].same_count > base_same_count) {
+                base_same_count = rps[trip_slot[i]].same_count;
+                rt->base_index[route_no] = i;
+            }
+        }
+
+        for (i = 0; i < count; i++) {
+            int pattern_no = gtfs_trip_pattern(trip_nos[i]);
+
+            if (pattern_no >= 0)
+                pattern_slot[pattern_no] = -1;
+        }
+    }
+    free(sorted);
+    free(rps);
+    free(trip_slot);
+    free(pattern_slot);
+}
+
 // 経路ごとの停車パターン(trip)を作成
 int gtfs_route_trips()
 {
     int result = 0;
+    struct route_trips_t* rt = &g_route_trips;
     int count, i;
+    int* route_nos;
+    int* cursor;
 
+    // 経路番号を割り当てる（routes.txtで最初に現れた順）
     count = vect_count(g_gtfs->routes_tbl);
+    rt->count = 0;
+    rt->routes = (struct route_t**)malloc(sizeof(struct route_t*) * (count+1));
+    rt->route_no_htbl = hash_initialize(1009);
+    hash_reserve(rt->route_no_htbl, count);
     for (i = 0; i < count; i++) {
         struct route_t* route;
-        struct vector_t* trips_tbl;
-        
+
         route = (struct route_t*)vect_get(g_gtfs->routes_tbl, i);
-        trips_tbl = vect_initialize(100);
-        hash_put(g_route_trips_htbl, route->route_id, trips_tbl);
+        if (hash_get_unlocked(rt->route_no_htbl, route->route_id))
+            continue;
+        rt->routes[rt->count++] = route;
+        hash_put_unlocked(rt->route_no_htbl, route->route_id, (void*)(int64)rt->count);
     }
 
-    // trips
+    // 経路ごとの便の件数
     count = vect_count(g_gtfs->trips_tbl);
+    route_nos = (int*)malloc(sizeof(int) * (count+1));
+    rt->offsets = (int*)calloc(rt->count+1, sizeof(int));
     for (i = 0; i < count; i++) {
         struct trip_t* trip;
-        struct vector_t* trips_tbl;
-        
+
         trip = (struct trip_t*)vect_get(g_gtfs->trips_tbl, i);
-        trips_tbl = (struct vector_t*)hash_get(g_route_trips_htbl, trip->route_id);
-        if (! trips_tbl) {
+        route_nos[i] = gtfs_route_no(trip->route_id);
+        if (route_nos[i] < 0) {
             err_write("gtfs_route_trips(): route_id not found[%s]\n",
                       utf8_conv(trip->route_id, (char*)alloca(256), 256));
             continue;
         }
-        vect_append(trips_tbl, trip);
+        rt->offsets[route_nos[i]+1]++;
     }
+    for (i = 0; i < rt->count; i++)
+        rt->offsets[i+1] += rt->offsets[i];
+
+    // trips.txtの順に経路ごとの位置へ格納
+    rt->trips = (struct trip_t**)malloc(sizeof(struct trip_t*) * (rt->offsets[rt->count]+1));
+    rt->trip_nos = (int*)malloc(sizeof(int) * (rt->offsets[rt->count]+1));
+    cursor = (int*)malloc(sizeof(int) * (rt->count+1));
+    memcpy(cursor, rt->offsets, sizeof(int) * (rt->count+1));
+    for (i = 0; i < count; i++) {
+        struct trip_t* trip;
+        int n;
+
+        if (route_nos[i] < 0)
+            continue;
+        trip = (struct trip_t*)vect_get(g_gtfs->trips_tbl, i);
+        n = cursor[route_nos[i]]++;
+        rt->trips[n] = trip;
+        rt->trip_nos[n] = gtfs_trip_no(trip->trip_id);
+    }
+    free(cursor);
+    free(route_nos);
+
+    // 経路ごとの基準となる便
+    route_base_index_build();
     return result;
 }
 
-static int gtfs_time_to_seconds(const char* time)
+/*
+ * 通過時刻表、停車パターン、経路ごとの便と停留所ごとの参照件数の領域を解放します。
+ */
+void gtfs_timetable_free()
 {
-    int seconds = 0;
-    char strbuf[64];
-    const char* p;
+    struct trip_timetable_t* tt = &g_vehicle_timetable;
+    struct route_trips_t* rt = &g_route_trips;
+    struct stop_usage_t* su = &g_stop_usage;
+    struct stop_pattern_table_t* sp = &g_stop_patterns;
+
+    if (tt->trip_no_htbl)
+        hash_finalize(tt->trip_no_htbl);
+    free(tt->trips);
+    free(tt->offsets);
+    free(tt->stop_times);
+    free(tt->sym_trip_no);
+    memset(tt, '\0', sizeof(struct trip_timetable_t));
+
+    if (rt->route_no_htbl)
+        hash_finalize(rt->route_no_htbl);
+    free(rt->routes);
+    free(rt->offsets);
+    free(rt->trips);
+    free(rt->trip_nos);
+    free(rt->base_index);
+    memset(rt, '\0', sizeof(struct route_trips_t));
+
+    free(sp->patterns);
+    free(sp->trip_pattern);
+    memset(sp, '\0', sizeof(struct stop_pattern_table_t));
+
+    if (su->stop_no_htbl)
+        hash_finalize(su->stop_no_htbl);
+    free(su->stops);
+    free(su->stop_times_count);
+    free(su->child_count);
+    memset(su, '\0', sizeof(struct stop_usage_t));
+}
 
-    strncpy(strbuf, time, sizeof(strbuf));
-    p = strtok(strbuf, ":");
-    if (p)
-        seconds += atoi(p) * 3600;
-    p = strtok(NULL, ":");
-    if (p)
-        seconds += atoi(p) * 60;
-    p = strtok(NULL, ":");
-    if (p)
-        seconds += atoi(p);
-    return seconds;
+/*
+ * trip_idの便番号を返します。
+ *
+ * trip_id: 便ID
+ *
+ * 戻り値
+ *  便番号を返します。便が存在しない場合は -1 を返します。
+ */
+int gtfs_trip_no(const char* trip_id)
+{
+    void* p;
+
+    if (! g_vehicle_timetable.trip_no_htbl)
+        return -1;
+    p = hash_get(g_vehicle_timetable.trip_no_htbl, trip_id);
+    if (! p)
+        return -1;
+    return (int)(int64)p - 1;
+}
+
+/*
+ * 便の通過時刻を stop_sequence の順に返します。
+ *
+ * trip_no: 便番号
+ * count: 通過時刻の件数が設定されます。
+ *
+ * 戻り値
+ *  通過時刻の配列の先頭を返します。
+ *  便番号が範囲外の場合は NULL を返して count に 0 が設定されます。
+ */
+struct stop_time_t** gtfs_trip_timetable(int trip_no, int* count)
+{
+    struct trip_timetable_t* tt = &g_vehicle_timetable;
+
+    if (trip_no < 0 || trip_no >= tt->count) {
+        *count = 0;
+        return NULL;
+    }
+    *count = tt->offsets[trip_no+1] - tt->offsets[trip_no];
+    return tt->stop_times + tt->offsets[trip_no];
+}
+
+/*
+ * route_idの経路番号を返します。
+ *
+ * route_id: 経路ID
+ *
+ * 戻り値
+ *  経路番号を返します。経路が存在しない場合は -1 を返します。
+ */
+int gtfs_route_no(const char* route_id)
+{
+    void* p;
+
+    if (! g_route_trips.route_no_htbl)
+        return -1;
+    p = hash_get(g_route_trips.route_no_htbl, route_id);
+    if (! p)
+        return -1;
+    return (int)(int64)p - 1;
+}
+
+/*
+ * 経路の便を trips.txt の順に返します。
+ *
+ * route_no: 経路番号
+ * trip_nos: 便番号の配列が設定されます。（NULLの場合は設定しません）
+ * count: 便の件数が設定されます。
+ *
+ * 戻り値
+ *  便の配列の先頭を返します。
+ *  経路番号が範囲外の場合は NULL を返して count に 0 が設定されます。
+ */
+struct trip_t** gtfs_route_trip_list(int route_no, int** trip_nos, int* count)
+{
+    struct route_trips_t* rt = &g_route_trips;
+
+    if (route_no < 0 || route_no >= rt->count) {
+        *count = 0;
+        if (trip_nos)
+            *trip_nos = NULL;
+        return NULL;
+    }
+    *count = rt->offsets[route_no+1] - rt->offsets[route_no];
+    if (trip_nos)
+        *trip_nos = rt->trip_nos + rt->offsets[route_no];
+    return rt->trips + rt->offsets[route_no];
+}
+
+/*
+ * stop_idの停留所番号を返します。
+ *
+ * stop_id: 停留所ID
+ *
+ * 戻り値
+ *  停留所番号を返します。停留所が存在しない場合は -1 を返します。
+ */
+int gtfs_stop_no(const char* stop_id)
+{
+    void* p;
+
+    if (! g_stop_usage.stop_no_htbl)
+        return -1;
+    p = hash_get(g_stop_usage.stop_no_htbl, stop_id);
+    if (! p)
+        return -1;
+    return (int)(int64)p - 1;
+}
+
+/*
+ * 停留所が stop_times.txt で参照されている件数を返します。
+ *
+ * stop_id: 停留所ID
+ *
+ * 戻り値
+ *  参照されている件数を返します。停留所が存在しない場合は 0 を返します。
+ */
+int gtfs_stop_times_use_count(const char* stop_id)
+{
+    int stop_no;
+
+    stop_no = gtfs_stop_no(stop_id);
+    if (stop_no < 0)
+        return 0;
+    return g_stop_usage.stop_times_count[stop_no];
+}
+
+/*
+ * 停留所が parent_station として参照されている件数を返します。
+ *
+ * stop_id: 停留所ID
+ *
+ * 戻り値
+ *  参照されている件数を返します。停留所が存在しない場合は 0 を返します。
+ */
+int gtfs_stop_child_count(const char* stop_id)
+{
+    int stop_no;
+
+    stop_no = gtfs_stop_no(stop_id);
+    if (stop_no < 0)
+        return 0;
+    return g_stop_usage.child_count[stop_no];
 }
 
 static int gtfs_trips_time_check()
 {
     int result = 0;
-    char** keylist;
-    char** keys;        // trip_id
+    int trip_no;
     
-    keylist = keys = hash_keylist(g_vehicle_timetable);
-    while (*keys) {
-        char* trip_id;
-        struct vector_t* trip_timetable;
+    for (trip_no = 0; trip_no < g_vehicle_timetable.count; trip_no++) {
+        struct stop_time_t** trip_timetable;
         int count, i;
         struct stop_time_t* last_st = NULL;
         int last_dept_seconds = 0;
         
-        trip_id = *keys;
-        trip_timetable = (struct vector_t*)hash_get(g_vehicle_timetable, trip_id);
-        
-        count = vect_count(trip_timetable);
+        trip_timetable = gtfs_trip_timetable(trip_no, &count);
         for (i = 0; i < count-1; i++) {
             struct stop_time_t* st;
             int asec, dsec;
             
-            st = vect_get(trip_timetable, i);
-            asec = gtfs_time_to_seconds(st->arrival_time);
-            dsec = gtfs_time_to_seconds(st->departure_time);
+            st = trip_timetable[i];
+            asec = st->arrival_time;
+            dsec = st->departure_time;
             if (asec > dsec) {
                 int ret = gtfs_error("stop_times.txtの%d行目の出発時刻が到着時刻よりも前になっています。",
                                      st->lineno);
@@ -1377,63 +2022,53 @@ static int gtfs_trips_time_check()
             last_st = st;
             last_dept_seconds = dsec;
         }
-        keys++;
     }
-    hash_list_free((void**)keylist);
     return result;
 }
 
-// tripsの中で停車数が同じである基準となるtripのインデックスを求めます。
-int gtfs_trips_base_index(struct vector_t* trips_tbl)
+/*
+ * 便番号の停車パターンのパターン番号を返します。
+ *
+ * trip_no: 便番号
+ *
+ * 戻り値
+ *  パターン番号を返します。便番号が範囲外の場合は -1 を返します。
+ */
+int gtfs_trip_pattern(int trip_no)
 {
-    int count, i;
-    int* stops_count_array = NULL;
-    int* same_stops_array = NULL;
-    int base_stops_count = 0;
-    int base_index = -1;
-
-    count = vect_count(trips_tbl);
-    if (count == 0)
+    if (trip_no < 0 || trip_no >= g_vehicle_timetable.count || ! g_stop_patterns.trip_pattern)
         return -1;
+    return g_stop_patterns.trip_pattern[trip_no];
+}
 
-    // 停車数の配列
-    stops_count_array = calloc(count, sizeof(int));
-    same_stops_array = calloc(count, sizeof(int));
-
-    // 停車数のチェック
-    for (i = 0; i < count; i++) {
-        struct trip_t* trip;
-        struct vector_t* stop_time_tbl;
-        int stop_count;
-
-        trip = (struct trip_t*)vect_get(trips_tbl, i);
-        stop_time_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-        stop_count = vect_count(stop_time_tbl);
-        stops_count_array[i] = stop_count;
-    }
-    for (i = 0; i < count; i++) {
-        int j;
+/*
+ * 停車パターンを返します。
+ * 停留所の並びは gtfs_trip_timetable(pattern->trip_no, &count) で参照します。
+ *
+ * pattern_no: パターン番号
+ *
+ * 戻り値
+ *  停車パターンを返します。パターン番号が範囲外の場合は NULL を返します。
+ */
+struct stop_pattern_t* gtfs_stop_pattern(int pattern_no)
+{
+    if (pattern_no < 0 || pattern_no >= g_stop_patterns.count)
+        return NULL;
+    return &g_stop_patterns.patterns[pattern_no];
+}
 
-        for (j = 0; j < count; j++) {
-            if (stops_count_array[i] == stops_count_array[j])
-                same_stops_array[i] = same_stops_array[i] + 1;
-        }
-    }
-    for (i = 0; i < count; i++) {
-        if (same_stops_array[i] > base_stops_count) {
-            base_stops_count = same_stops_array[i];
-            base_index = i;
-        }
-    }
-    free(stops_count_array);
-    free(same_stops_array);
-    return base_index;
+// tripsの中で停車数が同じである基準となるtripのインデックスを求めます。
+int gtfs_trips_base_index(int route_no)
+{
+    if (route_no < 0 || route_no >= g_route_trips.count)
+        return -1;
+    return g_route_trips.base_index[route_no];
 }
 
 int equals_stop_times_stop_id(struct stop_time_t* bst, struct stop_time_t* st)
 {
     if (bst && st) {
-        return (strcmp(bst->stop_id, st->stop_id) == 0);
+        return (bst->stop_id == st->stop_id);
     }
     return 0;
 }
@@ -1441,26 +2076,25 @@ int equals_stop_times_stop_id(struct stop_time_t* bst, struct stop_time_t* st)
 static int gtfs_route_stop_pattern_check()
 {
     int result = 0;
-    char** keylist;
-    char** keys;        // route_id
+    int route_no;
     
-    keylist = keys = hash_keylist(g_route_trips_htbl);
-    while (*keys) {
-        char* route_id;
-        struct vector_t* trips_tbl;
+    for (route_no = 0; route_no < g_route_trips.count; route_no++) {
+        const char* route_id;
+        struct trip_t** trips;
+        int* trip_nos;
         int count, i, j;
-        struct vector_t* base_stop_time_tbl = NULL;
+        struct stop_time_t** base_stop_times = NULL;
         int base_stops_count = 0;
         int base_index = -1;
+        int base_pattern = -1;
+        const char* base_trip_id = "";
 
-        route_id = *keys;
-        trips_tbl = (struct vector_t*)hash_get(g_route_trips_htbl, route_id);
-
-        base_index = gtfs_trips_base_index(trips_tbl);
+        route_id = g_route_trips.routes[route_no]->route_id;
+        trips = gtfs_route_trip_list(route_no, &trip_nos, &count);
+        base_index = gtfs_trips_base_index(route_no);
 
-        count = vect_count(trips_tbl);
         if (count == 0) {
-            struct route_t* route = (struct route_t*)hash_get(g_gtfs_hash->routes_htbl, route_id);
+            struct route_t* route = g_route_trips.routes[route_no];
             int ret = gtfs_warning("routes.txtの%d行目のroute_id(%s)は使用されていません。",
                                    route->lineno,
                                    utf8_conv(route_id, (char*)alloca(256), 256));
@@ -1468,25 +2102,23 @@ static int gtfs_route_stop_pattern_check()
                 result = ret;
         }
         if (base_index >= 0) {
-            struct trip_t* trip;
-
-            trip = (struct trip_t*)vect_get(trips_tbl, base_index);
-            base_stop_time_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-            base_stops_count = vect_count(base_stop_time_tbl);
+            base_stop_times = gtfs_trip_timetable(trip_nos[base_index], &base_stops_count);
+            base_pattern = gtfs_trip_pattern(trip_nos[base_index]);
+            base_trip_id = trips[base_index]->trip_id;
         }
+
         for (i = 0; i < count; i++) {
-            struct trip_t* trip;
-            struct vector_t* stop_time_tbl = NULL;
             int stops_count = 0;
 
-            trip = (struct trip_t*)vect_get(trips_tbl, i);
-            stop_time_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-            stops_count = vect_count(stop_time_tbl);
+            // 基準の便と同じ停車パターンの便は停車数も同じ
+            if (base_pattern >= 0 && gtfs_trip_pattern(trip_nos[i]) == base_pattern)
+                continue;
+            gtfs_trip_timetable(trip_nos[i], &stops_count);
             if (base_stops_count != stops_count) {
                 if (! g_route_stop_pattern_valid) {
                     int ret = gtfs_error("route_id(%s):trip(%s)の停車数が違います。GTFS-JPの場合はroute_idを分けて経路情報を作成してください。",
                                          utf8_conv(route_id, (char*)alloca(256), 256),
-                                         utf8_conv(trip->trip_id, (char*)alloca(256), 256));
+                                         utf8_conv(trips[i]->trip_id, (char*)alloca(256), 256));
                     if (ret < result)
                         result = ret;
                 }
@@ -1496,27 +2128,27 @@ static int gtfs_route_stop_pattern_check()
             break;
 
         for (i = 0; i < count; i++) {
-            struct trip_t* trip;
-            struct vector_t* stop_time_tbl;
+            struct stop_time_t** stop_times;
             int stop_count;
 
-            trip = (struct trip_t*)vect_get(trips_tbl, i);
-            stop_time_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-            stop_count = vect_count(stop_time_tbl);
+            // 基準の便と同じ停車パターンの便は比較しない
+            if (base_pattern >= 0 && gtfs_trip_pattern(trip_nos[i]) == base_pattern)
+                continue;
+            stop_times = gtfs_trip_timetable(trip_nos[i], &stop_count);
             for (j = 0; j < stop_count; j++) {
                 struct stop_time_t* bst = NULL;
                 struct stop_time_t* st = NULL;
 
                 if (j < base_stops_count)
-                    bst = (struct stop_time_t*)vect_get(base_stop_time_tbl, j);
-                st = (struct stop_time_t*)vect_get(stop_time_tbl, j);
+                    bst = base_stop_times[j];
+                st = stop_times[j];
                 if (equals_stop_times_stop_id(bst, st) == 0) {
                     if (! g_route_stop_pattern_valid) {
                         char r_id[256], trip1_id[256], trip2_id[256];
                         int ret = gtfs_error("route_id(%s):(trip(%s)とtrip(%s))の停車パターンが違います。GTFS-JPの場合はroute_idを分けて経路情報を作成してください。",
                                              utf8_conv(route_id, r_id, sizeof(r_id)),
-                                             utf8_conv(bst->trip_id, trip1_id, sizeof(trip1_id)),
-                                             utf8_conv(st->trip_id, trip2_id, sizeof(trip2_id)));
+                                             utf8_conv(base_trip_id, trip1_id, sizeof(trip1_id)),
+                                             utf8_conv(gtfs_id(st->trip_id), trip2_id, sizeof(trip2_id)));
                         if (ret < result)
                             result = ret;
                         break;
@@ -1526,9 +2158,7 @@ static int gtfs_route_stop_pattern_check()
         }
         if (result == GTFS_FATAL_ERROR)
             break;
-        keys++;
     }
-    hash_list_free((void**)keylist);
     return result;
 }
 
@@ -1562,8 +2192,8 @@ static int is_same_stop(const char* origin_stop_id, const char* dest_stop_id)
 
 int is_pickup_stop(struct stop_time_t* st)
 {
-    if (strlen(st->pickup_type) > 0) {
-        if (atoi(st->pickup_type) != 0)
+    if (st->flags & ST_HAS(ST_PICKUP_TYPE)) {
+        if (gtfs_stop_time_pickup_type(st) != 0)
             return 0;
     }
     return 1;   // 乗車可能
@@ -1571,22 +2201,142 @@ int is_pickup_stop(struct stop_time_t* st)
 
 int is_dropoff_stop(struct stop_time_t* st)
 {
-    if (strlen(st->drop_off_type) > 0) {
-        if (atoi(st->drop_off_type) != 0)
+    if (st->flags & ST_HAS(ST_DROP_OFF_TYPE)) {
+        if (gtfs_stop_time_drop_off_type(st) != 0)
             return 0;
     }
     return 1;   // 降車可能
 }
 
+// 停留所名ごとのzone_id（停留所名番号 0..count-1 で参照します）
+// 停留所名番号 n のzone_idは zone_ids[offsets[n]] から zone_ids[offsets[n+1]-1] までです。
+struct stop_name_zones_t {
+    int count;                          // 停留所名の数
+    int* offsets;                       // 停留所名ごとのzone_idの開始位置（count+1個）
+    const char** zone_ids;              // stops_htbl の順で重複を除いたzone_id
+    struct hash_t* name_no_htbl;        // key:stop_name value:停留所名番号+1
+};
+
+static struct stop_name_zones_t _name_zones;
+
+// get_another_fare_rule() で運賃が見つからなかった区間
+static char _no_fare_rule;
+
+/*
+ * 停留所名ごとのzone_idの索引を作成します。
+ * zone_idは stops_htbl の順に並べるので get_another_fare_rule() の検索順は変わりません。
+ */
+static void stop_name_zones_build()
+{
+    struct stop_name_zones_t* nz = &_name_zones;
+    struct hash_iter_t it;
+    struct stop_t* stop;
+    struct hash_t* zone_htbl;
+    int* name_nos;
+    int* cursor;
+    int count, n, i;
+
+    count = hash_count(g_gtfs_hash->stops_htbl);
+    nz->count = 0;
+    nz->name_no_htbl = hash_initialize(1009);
+    hash_reserve(nz->name_no_htbl, count);
+    name_nos = (int*)malloc(sizeof(int) * (count+1));
+
+    // 停留所名番号を割り当ててzone_idの件数を数える（同じ停留所名とzone_idは一度だけ）
+    zone_htbl = hash_initialize(1009);
+    hash_reserve(zone_htbl, count);
+    nz->offsets = (int*)calloc(count+2, sizeof(int));
+    n = 0;
+    hash_iter_begin(g_gtfs_hash->stops_htbl, &it);
+    while (hash_iter_next(&it, NULL, (void**)&stop)) {
+        char hkey[GTFS_ID_SIZE+32];
+        void* p;
+        int name_no;
+
+        p = hash_get_unlocked(nz->name_no_htbl, stop->stop_name);
+        if (p) {
+            name_no = (int)(int64)p - 1;
+        } else {
+            name_no = nz->count++;
+            hash_put_unlocked(nz->name_no_htbl, stop->stop_name, (void*)(int64)nz->count);
+        }
+        snprintf(hkey, sizeof(hkey), "%d/%s", name_no, stop->zone_id);
+        if (hash_get_unlocked(zone_htbl, hkey)) {
+            name_nos[n++] = -1;
+            continue;
+        }
+        hash_put_unlocked(zone_htbl, hkey, stop);
+        name_nos[n++] = name_no;
+        nz->offsets[name_no+1]++;
+    }
+    hash_finalize(zone_htbl);
+    for (i = 0; i < nz->count; i++)
+        nz->offsets[i+1] += nz->offsets[i];
+
+    // stops_htbl の順に停留所名ごとの位置へ格納
+    nz->zone_ids = (const char**)malloc(sizeof(char*) * (nz->offsets[nz->count]+1));
+    cursor = (int*)malloc(sizeof(int) * (nz->count+1));
+    memcpy(cursor, nz->offsets, sizeof(int) * (nz->count+1));
+    n = 0;
+    hash_iter_begin(g_gtfs_hash->stops_htbl, &it);
+    while (hash_iter_next(&it, NULL, (void**)&stop)) {
+        int name_no = name_nos[n++];
+
+        if (name_no >= 0)
+            nz->zone_ids[cursor[name_no]++] = stop->zone_id;
+    }
+    free(cursor);
+    free(name_nos);
+    hash_freeze(nz->name_no_htbl);
+}
+
+static void stop_name_zones_free()
+{
+    struct stop_name_zones_t* nz = &_name_zones;
+
+    if (nz->name_no_htbl)
+        hash_finalize(nz->name_no_htbl);
+    free(nz->offsets);
+    free(nz->zone_ids);
+    memset(nz, '\0', sizeof(struct stop_name_zones_t));
+}
+
+// 停留所名の停留所名番号を返します。（存在しない場合は -1）
+static int stop_name_no(const char* stop_name)
+{
+    void* p;
+
+    p = hash_get(_name_zones.name_no_htbl, stop_name);
+    if (! p)
+        return -1;
+    return (int)(int64)p - 1;
+}
+
+/*
+ * 発着の停留所名が同じで別のzone_idの運賃を検索します。
+ * 検索結果は経路ごとに fare_another_htbl に (発停留所名, 着停留所名) で記憶します。
+ *
+ * trip: 便
+ * origin_stop_id: 発停留所ID
+ * dest_stop_id: 着停留所ID
+ * fare_another_htbl: 検索結果を記憶するテーブル（経路ごとにクリアします）
+ *
+ * 戻り値
+ *  運賃が見つかった場合は fare_rule を返します。見つからない場合は NULL を返します。
+ */
 static struct fare_rule_t* get_another_fare_rule(struct trip_t* trip,
                                                  const char* origin_stop_id,
-                                                 const char* dest_stop_id)
+                                                 const char* dest_stop_id,
+                                                 struct hash_t* fare_another_htbl)
 {
+    struct stop_name_zones_t* nz = &_name_zones;
     struct stop_t* origin_stop;
     struct stop_t* dest_stop;
-    struct stop_t** stop_list;
-    struct fare_rule_t* fare_rule = NULL;
+    int origin_no, dest_no;
+    char memo_key[32];
     int i, j;
+    void* p;
+    struct fare_rule_t* fare_rule = NULL;
 
 #if 0
     if (strcmp(origin_stop_id, "1001_01") == 0 && strcmp(dest_stop_id, "1006_02") == 0)
@@ -1597,209 +2347,296 @@ static struct fare_rule_t* get_another_fare_rule(struct trip_t* trip,
     dest_stop = hash_get(g_gtfs_hash->stops_htbl, dest_stop_id);
     if (origin_stop == NULL || dest_stop == NULL)
         return NULL;
-    
-    stop_list = (struct stop_t**)hash_list(g_gtfs_hash->stops_htbl);
-
-    for (i = 0; stop_list[i]; i++) {
-        if (strcmp(origin_stop->stop_name, stop_list[i]->stop_name) == 0) {
-            for (j = 0; stop_list[j]; j++) {
-                if (strcmp(dest_stop->stop_name, stop_list[j]->stop_name) == 0) {
-                    char hkey[128];
-                
-                    fare_rule_key(trip->route_id, stop_list[i]->zone_id, stop_list[j]->zone_id, hkey);
-                    fare_rule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
-                    if (fare_rule)
-                        goto final;
-                    // 発着の逆も探す
-                    fare_rule_key(trip->route_id, stop_list[j]->zone_id, stop_list[i]->zone_id, hkey);
-                    fare_rule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
-                    if (fare_rule)
-                        goto final;
-                }
-            }
+
+    origin_no = stop_name_no(origin_stop->stop_name);
+    dest_no = stop_name_no(dest_stop->stop_name);
+    if (origin_no < 0 || dest_no < 0)
+        return NULL;
+
+    sprintf(memo_key, "%d/%d", origin_no, dest_no);
+    p = hash_get_unlocked(fare_another_htbl, memo_key);
+    if (p)
+        return (p == &_no_fare_rule)? NULL : (struct fare_rule_t*)p;
+
+    for (i = nz->offsets[origin_no]; i < nz->offsets[origin_no+1] && ! fare_rule; i++) {
+        for (j = nz->offsets[dest_no]; j < nz->offsets[dest_no+1]; j++) {
+            char hkey[128];
+
+            fare_rule_key(trip->route_id, nz->zone_ids[i], nz->zone_ids[j], hkey);
+            fare_rule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
+            if (fare_rule)
+                break;
+            // 発着の逆も探す
+            fare_rule_key(trip->route_id, nz->zone_ids[j], nz->zone_ids[i], hkey);
+            fare_rule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
+            if (fare_rule)
+                break;
         }
     }
-
-final:
-    hash_list_free((void**)stop_list);
+    hash_put_unlocked(fare_another_htbl, memo_key, fare_rule? (void*)fare_rule : (void*)&_no_fare_rule);
     return fare_rule;
 }
 
-static char* get_dist_traveled(struct stop_time_t* st)
+static const char* get_dist_traveled(struct stop_time_t* st)
 {
-    if (strlen(st->shape_dist_traveled) == 0)
+    const char* dist = gtfs_stop_time_text(st, ST_SHAPE_DIST_TRAVELED, NULL);
+
+    if (strlen(dist) == 0)
         return "--";
-    return st->shape_dist_traveled;
+    return dist;
 }
 
-// 区間運賃が登録されているかチェック
-static int gtfs_od_fare_check()
+// 区間運賃チェックの作業用テーブル（ワーカーごとに再利用します）
+struct od_fare_worker_t {
+    struct hash_t* fare_error_htbl;     // 未登録エラーを出力した区間
+    struct hash_t* fare_checked_htbl;   // 発地ごとにチェックした区間
+    struct hash_t* fare_another_htbl;   // 停留所名が同じ別のzone_idで検索した区間
+};
+
+// 区間運賃チェックのジョブ（経路ごと）
+struct od_fare_job_t {
+    int trip_no;                        // 経路の最初の便
+    int cost;                           // 区間の数（処理量の目安）
+    int result;                         // チェックの結果
+    struct gtfs_report_t report;        // 診断メッセージ
+};
+
+struct od_fare_check_t {
+    int count;                          // 経路の数
+    struct od_fare_job_t* jobs;         // 経路の順のジョブ
+    struct od_fare_job_t** order;       // 実行する順のジョブ（区間の多い順）
+    struct od_fare_worker_t* workers;
+};
+
+// 便の区間運賃をチェックします。
+static int od_fare_trip_check(int trip_no, struct od_fare_worker_t* w)
 {
     int result = 0;
-    struct hash_t* checked_route_htbl;
-    char** keylist;
-    char** keys;        // trip_id
-
-    checked_route_htbl = hash_initialize(1009);
-
-    keylist = keys = hash_keylist(g_vehicle_timetable);
-    while (*keys) {
-        char* trip_id;
-        struct trip_t* trip;
-        struct vector_t* trip_timetable;
-        int count, i;
-        struct hash_t* fare_error_htbl;
-
-        trip_id = *keys;
-        trip = (struct trip_t*)hash_get(g_gtfs_hash->trips_htbl, trip_id);
-
-        // 便の経路がチェック済みか調べる
-        if (hash_get(checked_route_htbl, trip->route_id) != NULL) {
-            keys++;
-            continue;
-        }
-        hash_put(checked_route_htbl, trip->route_id, trip);
-
-        fare_error_htbl = hash_initialize(1009);
-        trip_timetable = (struct vector_t*)hash_get(g_vehicle_timetable, trip_id);
-
-        count = vect_count(trip_timetable);
-        for (i = 0; i < count-1; i++) {
-            struct stop_time_t* origin_st;
-            char* origin_zone;
-            int j;
-            int prev_price = 0;
-            struct stop_time_t* prev_dest_st = NULL;
-            struct hash_t* fare_checked_htbl;
+    struct stop_time_t** trip_timetable;
+    struct trip_t* trip;
+    struct hash_t* fare_error_htbl = w->fare_error_htbl;
+    struct hash_t* fare_checked_htbl = w->fare_checked_htbl;
+    int count, i;
 
-            origin_st = vect_get(trip_timetable, i);
-            origin_zone = get_zone_id(origin_st->stop_id);
-            fare_checked_htbl = hash_initialize(101);
+    trip = g_vehicle_timetable.trips[trip_no];
+    hash_clear(fare_error_htbl);
+    hash_clear(w->fare_another_htbl);
 
-            for (j = i+1; j < count; j++) {
-                struct stop_time_t* dest_st;
-                char* dest_zone;
-                char hkey[128];
-                struct fare_rule_t* fare_rule;
-                struct fare_attribute_t* fare_attr;
+    trip_timetable = gtfs_trip_timetable(trip_no, &count);
+    for (i = 0; i < count-1; i++) {
+        struct stop_time_t* origin_st;
+        char* origin_zone;
+        int j;
+        int prev_price = 0;
+        struct stop_time_t* prev_dest_st = NULL;
 
-                dest_st = vect_get(trip_timetable, j);
-                dest_zone = get_zone_id(dest_st->stop_id);
+        origin_st = trip_timetable[i];
+        origin_zone = get_zone_id(gtfs_id(origin_st->stop_id));
+        hash_clear(fare_checked_htbl);
 
-                // 乗車/降車が可能か調べる
-                if (is_pickup_stop(origin_st) == 0 || is_dropoff_stop(dest_st) == 0)
+        for (j = i+1; j < count; j++) {
+            struct stop_time_t* dest_st;
+            char* dest_zone;
+            char hkey[128];
+            struct fare_rule_t* fare_rule;
+            struct fare_attribute_t* fare_attr;
+
+            dest_st = trip_timetable[j];
+            dest_zone = get_zone_id(gtfs_id(dest_st->stop_id));
+
+            // 乗車/降車が可能か調べる
+            if (is_pickup_stop(origin_st) == 0 || is_dropoff_stop(dest_st) == 0)
+                continue;
+            if (! g_same_stops_fare_rule_check) {
+                // 発着が同じ駅は運賃が登録されていないので無視する（「の」の字路線）
+                if (is_same_stop(gtfs_id(origin_st->stop_id), gtfs_id(dest_st->stop_id)))
                     continue;
-                if (! g_same_stops_fare_rule_check) {
-                    // 発着が同じ駅は運賃が登録されていないので無視する（「の」の字路線）
-                    if (is_same_stop(origin_st->stop_id, dest_st->stop_id))
-                        continue;
-                }
-                // 路線+区間で運賃を検索
-                fare_rule_key(trip->route_id, origin_zone, dest_zone, hkey);
+            }
+            // 路線+区間で運賃を検索
+            fare_rule_key(trip->route_id, origin_zone, dest_zone, hkey);
+            fare_rule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
+            if (! fare_rule) {
+                // 路線を省略して区間のみで検索
+                fare_rule_key("", origin_zone, dest_zone, hkey);
                 fare_rule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
                 if (! fare_rule) {
-                    // 路線を省略して区間のみで検索
-                    fare_rule_key("", origin_zone, dest_zone, hkey);
+                    // 均一料金の可能性があるので路線のみで検索
+                    fare_rule_key(trip->route_id, "", "", hkey);
                     fare_rule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
-                    if (! fare_rule) {
-                        // 均一料金の可能性があるので路線のみで検索
-                        fare_rule_key(trip->route_id, "", "", hkey);
-                        fare_rule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
-                    }
-                    if (! fare_rule) {
-                        // 往路と復路の標柱で別のzone_idが採番されている可能性があるためstop_nameが同じ別のzone_idで検索してみる
-                        // また往路と復路のどちらかしか登録されていない場合もあるので発着を入れ替えて検索する
-                        fare_rule = get_another_fare_rule(trip, origin_st->stop_id, dest_st->stop_id);
-                    }
                 }
                 if (! fare_rule) {
-                    int ret;
-                    char rid[256], sname[256], sid[256], oz[256], dsname[256], dsid[256], dz[256];
-
-                    // 未登録エラーが検出済みか調べる（巡回経路の場合に複数回検索されるため）
-                    fare_rule_key(trip->route_id, origin_zone, dest_zone, hkey);
-                    if (hash_get(fare_error_htbl, hkey))
-                        continue;
-                    ret = gtfs_error("route_id[%s]の[%s(%s(%s))]-[%s(%s(%s))]区間の運賃がfare_rules.txtに登録されていません。",
-                                     utf8_conv(trip->route_id, rid, sizeof(rid)),
-                                     utf8_conv(get_stop_name(origin_st->stop_id), sname, sizeof(sname)),
-                                     utf8_conv(origin_st->stop_id, sid, sizeof(sid)),
-                                     utf8_conv(origin_zone, oz, sizeof(oz)),
-                                     utf8_conv(get_stop_name(dest_st->stop_id), dsname, sizeof(dsname)),
-                                     utf8_conv(dest_st->stop_id, dsid, sizeof(dsid)),
-                                     utf8_conv(dest_zone, dz, sizeof(dz)));
-                    if (ret < result)
-                        result = ret;
-                    hash_put(fare_error_htbl, hkey, "");
-                    continue;
+                    // 往路と復路の標柱で別のzone_idが採番されている可能性があるためstop_nameが同じ別のzone_idで検索してみる
+                    // また往路と復路のどちらかしか登録されていない場合もあるので発着を入れ替えて検索する
+                    fare_rule = get_another_fare_rule(trip, gtfs_id(origin_st->stop_id), gtfs_id(dest_st->stop_id),
+                                                      w->fare_another_htbl);
                 }
+            }
+            if (! fare_rule) {
+                int ret;
+                char rid[256], sname[256], sid[256], oz[256], dsname[256], dsid[256], dz[256];
 
-                // 一度チェックした区間は無視する（巡回路線のように途中から出発地へ戻ってくる場合の回避）
-                if (hash_get(fare_checked_htbl, hkey)) {
-                    prev_price = 0;
-                    prev_dest_st = NULL;
+                // 未登録エラーが検出済みか調べる（巡回経路の場合に複数回検索されるため）
+                fare_rule_key(trip->route_id, origin_zone, dest_zone, hkey);
+                if (hash_get_unlocked(fare_error_htbl, hkey))
                     continue;
-                }
+                ret = gtfs_error("route_id[%s]の[%s(%s(%s))]-[%s(%s(%s))]区間の運賃がfare_rules.txtに登録されていません。",
+                                 utf8_conv(trip->route_id, rid, sizeof(rid)),
+                                 utf8_conv(get_stop_name(gtfs_id(origin_st->stop_id)), sname, sizeof(sname)),
+                                 utf8_conv(gtfs_id(origin_st->stop_id), sid, sizeof(sid)),
+                                 utf8_conv(origin_zone, oz, sizeof(oz)),
+                                 utf8_conv(get_stop_name(gtfs_id(dest_st->stop_id)), dsname, sizeof(dsname)),
+                                 utf8_conv(gtfs_id(dest_st->stop_id), dsid, sizeof(dsid)),
+                                 utf8_conv(dest_zone, dz, sizeof(dz)));
+                if (ret < result)
+                    result = ret;
+                hash_put_unlocked(fare_error_htbl, hkey, "");
+                continue;
+            }
 
-                fare_attr = hash_get(g_gtfs_hash->fare_attrs_htbl, fare_rule->fare_id);
-                if (fare_attr) {
-                    int price = atoi(fare_attr->price);
-                    if (price < prev_price) {
-                        // 運賃が下がっている
-                        int ret;
-                        char cb1[256], cb2[256], cb3[256], cb4[256], cb5[256], cb6[256];
-                        char cb7[256], cb8[256], cb9[256], cb10[256], cb11[256], cb12[256], cb13[256];
-
-                        ret = gtfs_warning("route_id[%s]の[%s(%s(%s))]-[%s(%s(%s))]の運賃(%d)距離(%s)が前区間[%s(%s(%s))]-[%s(%s(%s))]の運賃(%d)距離(%s)より安く設定されています。",
-                                           utf8_conv(trip->route_id, cb1, sizeof(cb1)),
-                                           utf8_conv(get_stop_name(origin_st->stop_id), cb2, sizeof(cb2)),
-                                           utf8_conv(origin_st->stop_id, cb3, sizeof(cb3)),
-                                           utf8_conv(get_zone_id(origin_st->stop_id), cb4, sizeof(cb4)),
-                                           utf8_conv(get_stop_name(dest_st->stop_id), cb5, sizeof(cb5)),
-                                           utf8_conv(dest_st->stop_id, cb6, sizeof(cb6)),
-                                           utf8_conv(get_zone_id(dest_st->stop_id), cb7, sizeof(cb7)),
-                                           price,
-                                           get_dist_traveled(dest_st),
-                                           utf8_conv(get_stop_name(origin_st->stop_id), cb8, sizeof(cb8)),
-                                           utf8_conv(origin_st->stop_id, cb9, sizeof(cb9)),
-                                           utf8_conv(get_zone_id(origin_st->stop_id), cb10, sizeof(cb10)),
-                                           utf8_conv(get_stop_name(prev_dest_st->stop_id), cb11, sizeof(cb11)),
-                                           utf8_conv(prev_dest_st->stop_id, cb12, sizeof(cb12)),
-                                           utf8_conv(get_zone_id(prev_dest_st->stop_id), cb13, sizeof(cb13)),
-                                           prev_price,
-                                           get_dist_traveled(prev_dest_st));
-                        if (ret < result)
-                            result = ret;
-                    }
-                    prev_price = price;
-                    prev_dest_st = dest_st;
+            // 一度チェックした区間は無視する（巡回路線のように途中から出発地へ戻ってくる場合の回避）
+            if (hash_get_unlocked(fare_checked_htbl, hkey)) {
+                prev_price = 0;
+                prev_dest_st = NULL;
+                continue;
+            }
+
+            fare_attr = hash_get(g_gtfs_hash->fare_attrs_htbl, fare_rule->fare_id);
+            if (fare_attr) {
+                int price = fare_attr->price_value;
+                if (price < prev_price) {
+                    // 運賃が下がっている
+                    int ret;
+                    char cb1[256], cb2[256], cb3[256], cb4[256], cb5[256], cb6[256];
+                    char cb7[256], cb8[256], cb9[256], cb10[256], cb11[256], cb12[256], cb13[256];
+
+                    ret = gtfs_warning("route_id[%s]の[%s(%s(%s))]-[%s(%s(%s))]の運賃(%d)距離(%s)が前区間[%s(%s(%s))]-[%s(%s(%s))]の運賃(%d)距離(%s)より安く設定されています。",
+                                       utf8_conv(trip->route_id, cb1, sizeof(cb1)),
+                                       utf8_conv(get_stop_name(gtfs_id(origin_st->stop_id)), cb2, sizeof(cb2)),
+                                       utf8_conv(gtfs_id(origin_st->stop_id), cb3, sizeof(cb3)),
+                                       utf8_conv(get_zone_id(gtfs_id(origin_st->stop_id)), cb4, sizeof(cb4)),
+                                       utf8_conv(get_stop_name(gtfs_id(dest_st->stop_id)), cb5, sizeof(cb5)),
+                                       utf8_conv(gtfs_id(dest_st->stop_id), cb6, sizeof(cb6)),
+                                       utf8_conv(get_zone_id(gtfs_id(dest_st->stop_id)), cb7, sizeof(cb7)),
+                                       price,
+                                       get_dist_traveled(dest_st),
+                                       utf8_conv(get_stop_name(gtfs_id(origin_st->stop_id)), cb8, sizeof(cb8)),
+                                       utf8_conv(gtfs_id(origin_st->stop_id), cb9, sizeof(cb9)),
+                                       utf8_conv(get_zone_id(gtfs_id(origin_st->stop_id)), cb10, sizeof(cb10)),
+                                       utf8_conv(get_stop_name(gtfs_id(prev_dest_st->stop_id)), cb11, sizeof(cb11)),
+                                       utf8_conv(gtfs_id(prev_dest_st->stop_id), cb12, sizeof(cb12)),
+                                       utf8_conv(get_zone_id(gtfs_id(prev_dest_st->stop_id)), cb13, sizeof(cb13)),
+                                       prev_price,
+                                       get_dist_traveled(prev_dest_st));
+                    if (ret < result)
+                        result = ret;
                 }
-                hash_put(fare_checked_htbl, hkey, "");
+                prev_price = price;
+                prev_dest_st = dest_st;
             }
-            hash_finalize(fare_checked_htbl);
+            hash_put_unlocked(fare_checked_htbl, hkey, "");
         }
-        hash_finalize(fare_error_htbl);
-        keys++;
     }
-    hash_list_free((void**)keylist);
+    return result;
+}
+
+static void od_fare_route_job(int job_no, int worker_no, void* arg)
+{
+    struct od_fare_check_t* oc = (struct od_fare_check_t*)arg;
+    struct od_fare_job_t* job = oc->order[job_no];
+
+    gtfs_report_begin(&job->report);
+    job->result = od_fare_trip_check(job->trip_no, &oc->workers[worker_no]);
+    gtfs_report_end();
+}
+
+static int od_fare_job_cmp(const void* a, const void* b)
+{
+    const struct od_fare_job_t* j1 = *(const struct od_fare_job_t**)a;
+    const struct od_fare_job_t* j2 = *(const struct od_fare_job_t**)b;
+
+    if (j1->cost != j2->cost)
+        return (j1->cost > j2->cost)? -1 : 1;
+    return (j1 < j2)? -1 : (j1 > j2);
+}
+
+/*
+ * 区間運賃が登録されているかチェック
+ *
+ * 経路ごとに最初の便の区間をチェックします。
+ * 経路ごとのジョブを区間の多い順に空いているスレッドへ割り当てて並列に実行し、
+ * 診断メッセージは経路の順に出力します。
+ */
+static int gtfs_od_fare_check()
+{
+    int result = 0;
+    struct hash_t* checked_route_htbl;
+    struct od_fare_check_t oc;
+    int nthreads;
+    int trip_no, i;
+
+    memset(&oc, '\0', sizeof(oc));
+    oc.jobs = (struct od_fare_job_t*)calloc(g_vehicle_timetable.count+1, sizeof(struct od_fare_job_t));
+
+    // 経路ごとに最初の便を求める
+    checked_route_htbl = hash_initialize(1009);
+    hash_reserve(checked_route_htbl, vect_count(g_gtfs->routes_tbl));
+    for (trip_no = 0; trip_no < g_vehicle_timetable.count; trip_no++) {
+        struct trip_t* trip;
+        struct od_fare_job_t* job;
+        int n;
+
+        trip = g_vehicle_timetable.trips[trip_no];
+        if (hash_get_unlocked(checked_route_htbl, trip->route_id) != NULL)
+            continue;
+        hash_put_unlocked(checked_route_htbl, trip->route_id, trip);
+
+        job = &oc.jobs[oc.count++];
+        job->trip_no = trip_no;
+        gtfs_trip_timetable(trip_no, &n);
+        job->cost = n * (n-1) / 2;
+    }
     hash_finalize(checked_route_htbl);
+
+    // 停車数の差が大きいので区間の多い経路から割り当てる
+    oc.order = (struct od_fare_job_t**)malloc(sizeof(struct od_fare_job_t*) * (oc.count+1));
+    for (i = 0; i < oc.count; i++)
+        oc.order[i] = &oc.jobs[i];
+    qsort(oc.order, oc.count, sizeof(struct od_fare_job_t*), od_fare_job_cmp);
+
+    nthreads = (g_load_threads > 0)? g_load_threads : mt_cpu_count();
+    oc.workers = (struct od_fare_worker_t*)calloc(nthreads, sizeof(struct od_fare_worker_t));
+    for (i = 0; i < nthreads; i++) {
+        oc.workers[i].fare_error_htbl = hash_initialize(1009);
+        oc.workers[i].fare_checked_htbl = hash_initialize(101);
+        oc.workers[i].fare_another_htbl = hash_initialize(101);
+    }
+    stop_name_zones_build();
+
+    mt_parallel(nthreads, oc.count, od_fare_route_job, &oc);
+
+    // 経路の順に診断メッセージを出力
+    for (i = 0; i < oc.count; i++) {
+        gtfs_report_flush(&oc.jobs[i].report);
+        if (oc.jobs[i].result < result)
+            result = oc.jobs[i].result;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        hash_finalize(oc.workers[i].fare_error_htbl);
+        hash_finalize(oc.workers[i].fare_checked_htbl);
+        hash_finalize(oc.workers[i].fare_another_htbl);
+    }
+    stop_name_zones_free();
+    free(oc.workers);
+    free(oc.order);
+    free(oc.jobs);
     return result;
 }
 
 // stop_id が未使用かチェックする
 static int is_stopid_unused(const char* stop_id)
 {
-    int count, i;
-    
-    count = vect_count(g_gtfs->stop_times_tbl);
-    for (i = 0; i < count; i++) {
-        struct stop_time_t* st;
-        
-        st = (struct stop_time_t*)vect_get(g_gtfs->stop_times_tbl, i);
-        if (strcmp(stop_id, st->stop_id) == 0)
-            return 0;   // used
-    }
-    return 1;   // unuse
+    return (gtfs_stop_times_use_count(stop_id) == 0);
 }
 
 static int gtfs_stop_name_yomi_check()
@@ -2005,86 +2842,213 @@ static int gtfs_trips_stop_id_duplicate_check()
 {
     int result = 0;
     struct hash_t* checked_route_htbl;
-    char** keylist;
-    char** keys;        // trip_id
+    int trip_no;
 
     checked_route_htbl = hash_initialize(1009);
-    keylist = keys = hash_keylist(g_vehicle_timetable);
-    while (*keys) {
-        char* trip_id;
+    hash_reserve(checked_route_htbl, vect_count(g_gtfs->routes_tbl));
+    for (trip_no = 0; trip_no < g_vehicle_timetable.count; trip_no++) {
+        struct stop_time_t** trip_timetable;
         struct trip_t* trip;
-        struct vector_t* trip_timetable;
         int count, i;
         
-        trip_id = *keys;
-        trip = (struct trip_t*)hash_get(g_gtfs_hash->trips_htbl, trip_id);
-        if (trip == NULL) {
-            keys++;
+        trip = (struct trip_t*)hash_get(g_gtfs_hash->trips_htbl, g_vehicle_timetable.trips[trip_no]->trip_id);
+        if (trip == NULL)
             continue;
-        }
 
         // 便の経路がチェック済みか調べる
-        if (hash_get(checked_route_htbl, trip->route_id) != NULL) {
-            keys++;
+        if (hash_get_unlocked(checked_route_htbl, trip->route_id) != NULL)
             continue;
-        }
-        hash_put(checked_route_htbl, trip->route_id, trip);
+        hash_put_unlocked(checked_route_htbl, trip->route_id, trip);
 
-        trip_timetable = (struct vector_t*)hash_get(g_vehicle_timetable, trip_id);
-        
-        count = vect_count(trip_timetable);
+        trip_timetable = gtfs_trip_timetable(trip_no, &count);
         for (i = 0; i < count-1; i++) {
             struct stop_time_t* dst;
             const char* origin_zone;
             int ret = 0;
             int j;
 
-            dst = vect_get(trip_timetable, i);
-            origin_zone = get_zone_id(dst->stop_id);
+            dst = trip_timetable[i];
+            origin_zone = get_zone_id(gtfs_id(dst->stop_id));
 
             for (j = i+1; j < count; j++) {
                 struct stop_time_t* ast;
                 const char* dest_zone;
 
-                ast = vect_get(trip_timetable, j);
-                if (strcmp(dst->stop_id, ast->stop_id) != 0)
+                ast = trip_timetable[j];
+                if (dst->stop_id != ast->stop_id)
                     continue;
                 if (! is_dropoff_stop(ast))
                     continue;   // 降車不可なので無視
                 if (i == 0 && j == count-1)
                     continue;   // 始点と終点が同じ場合は巡回経路とみなすので無視
 
-                dest_zone = get_zone_id(ast->stop_id);
+                dest_zone = get_zone_id(gtfs_id(ast->stop_id));
                 // 無料バスか均一運賃の場合は無視
                 if (g_is_free_bus != 1 && is_flat_rate(trip->route_id, origin_zone, dest_zone) != 1) {
                     const char* stop_name;
 
-                    stop_name = get_stop_name(ast->stop_id);
+                    stop_name = get_stop_name(gtfs_id(ast->stop_id));
                     ret = gtfs_warning("route_id[%s]の経路で[%s(%s)]に複数回停車します。距離別運賃の場合は最初の[%s]までの運賃が適用されます。",
                                        utf8_conv(trip->route_id, (char*)alloca(256), 256),
                                        utf8_conv(stop_name, (char*)alloca(256), 256),
-                                       utf8_conv(ast->stop_id, (char*)alloca(256), 256),
+                                       utf8_conv(gtfs_id(ast->stop_id), (char*)alloca(256), 256),
                                        utf8_conv(stop_name, (char*)alloca(256), 256));
                     if (ret < result)
                         result = ret;
                 }
             }
         }
-        keys++;
     }
-    hash_list_free((void**)keylist);
     hash_finalize(checked_route_htbl);
     return result;
 }
 
-int gtfs_check()
+/*
+ * 作成が終わったテーブルとハッシュテーブルを凍結します。
+ * 以降のチェックは参照だけを行うため、検索はロックせずに行われます。
+ */
+static void gtfs_freeze_tables()
 {
-    TRACE("%s\n", "*GTFS(zip)の読み込み*");
-    if (gtfs_zip_archive_reader(g_gtfs_zip, g_gtfs) < 0) {
-        err_write("gtfs_check: zip_archive_reader error (%s).\n",
-                  utf8_conv(g_gtfs_zip, (char*)alloca(256), 256));
-        return -1;
+    struct hash_t* htbls[] = {
+        g_gtfs_hash->agency_htbl, g_gtfs_hash->routes_htbl, g_gtfs_hash->stops_htbl,
+        g_gtfs_hash->trips_htbl, g_gtfs_hash->calendar_htbl, g_gtfs_hash->calendar_dates_htbl,
+        g_gtfs_hash->fare_attrs_htbl, g_gtfs_hash->fare_rules_htbl,
+        g_gtfs_hash->translations_htbl, g_gtfs_hash->routes_jp_htbl,
+        g_vehicle_timetable.trip_no_htbl, g_route_trips.route_no_htbl,
+        g_stop_usage.stop_no_htbl
+    };
+    int count, i;
+
+    for (i = 0; i < GTFS_KIND_COUNT; i++) {
+        if (i != FEED_INFO)
+            vect_freeze(*gtfs_table(g_gtfs, i));
+    }
+    vect_freeze(g_gtfs->value_errors);
+
+    count = sizeof(htbls) / sizeof(struct hash_t*);
+    for (i = 0; i < count; i++)
+        hash_freeze(htbls[i]);
+}
+
+// 並列に実行するチェック
+struct check_job_t {
+    const char* title;                  // チェック名（TRACE、キャッシュのキー）
+    unsigned int file_bits;             // 存在する場合にチェックするファイル（0:常にチェック）
+    int (*func)(void);                  // チェック関数
+    unsigned int deps;                  // チェックの結果が依存するファイル
+    int skip;                           // チェックしない場合は1
+    int cached;                         // 前回の結果を出力する場合は1
+    uint32 deps_key;                    // 依存するファイルの内容から求めたキー
+    int result;                         // チェック関数の戻り値
+    struct gtfs_report_t report;        // 診断メッセージ
+};
+
+static void check_job(int job_no, int worker_no, void* arg)
+{
+    struct check_job_t* job = &((struct check_job_t*)arg)[job_no];
+
+    (void)worker_no;    // 未使用
+    if (job->skip || job->cached)
+        return;
+    gtfs_report_begin(&job->report);
+    job->result = (*job->func)();
+    gtfs_report_end();
+}
+
+/*
+ * 互いに依存しないチェックを並列に実行します。
+ * 診断メッセージはチェックごとにバッファに出力して、配列の順に標準出力へ出力します。
+ * 出力は配列の順に実行した場合と同じになります。
+ * 致命的エラーになったチェックより後のチェックの診断メッセージは出力しません。
+ * 依存するファイルが変更されていないチェックは実行せずにキャッシュの結果を出力します。
+ *
+ * jobs: チェックの配列
+ * count: チェックの件数
+ *
+ * 戻り値
+ *  致命的エラーの場合は GTFS_FATAL_ERROR を返します。
+ *  それ以外は GTFS_SUCCESS を返します。
+ */
+static int gtfs_parallel_check(struct check_job_t* jobs, int count)
+{
+    int result = GTFS_SUCCESS;
+    int nthreads;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        jobs[i].skip = (jobs[i].file_bits && ! is_gtfs_file_exist(g_gtfs, jobs[i].file_bits));
+        jobs[i].result = GTFS_SUCCESS;
+        memset(&jobs[i].report, '\0', sizeof(struct gtfs_report_t));
+        jobs[i].cached = 0;
+        if (! jobs[i].skip) {
+            jobs[i].deps_key = gtfs_check_cache_key(jobs[i].deps);
+            jobs[i].cached = gtfs_check_cache_replay(jobs[i].title, jobs[i].deps_key,
+                                                     &jobs[i].report, &jobs[i].result);
+        }
+    }
+
+    nthreads = (g_load_threads > 0)? g_load_threads : mt_cpu_count();
+    mt_parallel(nthreads, count, check_job, jobs);
+
+    for (i = 0; i < count; i++) {
+        if (jobs[i].skip)
+            continue;
+        if (! jobs[i].cached)
+            gtfs_check_cache_put(jobs[i].title, jobs[i].deps_key, &jobs[i].report, jobs[i].result);
+        if (result == GTFS_FATAL_ERROR) {
+            gtfs_report_discard(&jobs[i].report);
+            continue;
+        }
+        TRACE("%s\n", jobs[i].title);
+        gtfs_report_flush(&jobs[i].report);
+        if (jobs[i].result == GTFS_FATAL_ERROR)
+            result = GTFS_FATAL_ERROR;
     }
+    return result;
+}
+
+// 便と通過時刻表を使用するチェックが依存するファイル
+#define CHECK_DEPS_TIMETABLE    (GTFS_FILE_TRIPS | GTFS_FILE_STOP_TIMES)
+
+static int gtfs_check_feed()
+{
+    // 項目のチェックはファイル間の参照もチェックするため、すべてのファイルに依存します。
+    struct check_job_t column_jobs[] = {
+        { .title = "*必須項目のチェック*",
+          .file_bits = 0, .func = gtfs_column_exist_check,
+          .deps = GTFS_FILE_ALL },
+        { .title = "*値の書式チェック*",
+          .file_bits = 0, .func = gtfs_value_format_check,
+          .deps = GTFS_FILE_ALL }
+    };
+    struct check_job_t timetable_jobs[] = {
+        { .title = "*trips.txtの発着時刻が昇順に並んでいるかチェック*",
+          .file_bits = 0, .func = gtfs_trips_time_check,
+          .deps = CHECK_DEPS_TIMETABLE },
+        { .title = "*経路(route_id)の停車パターンが同じかチェック*",
+          .file_bits = 0, .func = gtfs_route_stop_pattern_check,
+          .deps = CHECK_DEPS_TIMETABLE | GTFS_FILE_ROUTES }
+    };
+    // 区間運賃のチェックは経路ごとに並列に実行するため、他のチェックと同時には実行しません。
+    struct check_job_t od_fare_jobs[] = {
+        { .title = "*通過時刻表の区間運賃がfare_rules.txtに登録されているかチェック*",
+          .file_bits = GTFS_FILE_FARE_RULES, .func = gtfs_od_fare_check,
+          .deps = CHECK_DEPS_TIMETABLE | GTFS_FILE_STOPS | GTFS_FILE_FARE_RULES | GTFS_FILE_FARE_ATTRIBUTES }
+    };
+    struct check_job_t name_jobs[] = {
+        { .title = "*stops.txtの読みがtranslations.txtに存在するかチェック*",
+          .file_bits = GTFS_FILE_TRANSLATIONS, .func = gtfs_stop_name_yomi_check,
+          .deps = GTFS_FILE_STOPS | GTFS_FILE_STOP_TIMES | GTFS_FILE_TRANSLATIONS },
+        { .title = "*stops.txtのstop_nameに重複がないかチェック*",
+          .file_bits = 0, .func = gtfs_stop_name_duplicate_check,
+          .deps = GTFS_FILE_STOPS },
+        { .title = "*routes.txtの経路名に重複がないかチェック*",
+          .file_bits = 0, .func = gtfs_route_name_duplicate_check,
+          .deps = GTFS_FILE_ROUTES | GTFS_FILE_ROUTES_JP },
+        { .title = "*stop_times.txtのtrip経路にstop_idの重複がないかチェック*",
+          .file_bits = 0, .func = gtfs_trips_stop_id_duplicate_check,
+          .deps = CHECK_DEPS_TIMETABLE | GTFS_FILE_STOPS | GTFS_FILE_FARE_RULES | GTFS_FILE_FARE_ATTRIBUTES }
+    };
 
     // 無料バスか判定します。
     g_is_free_bus = gtfs_is_free_bus();
@@ -2101,8 +3065,7 @@ int gtfs_check()
     if (gtfs_hash_table_key_check() == GTFS_FATAL_ERROR)
         return -1;
 
-    TRACE("%s\n", "*必須項目のチェック*");
-    if (gtfs_column_exist_check() == GTFS_FATAL_ERROR)
+    if (gtfs_parallel_check(column_jobs, sizeof(column_jobs) / sizeof(struct check_job_t)) == GTFS_FATAL_ERROR)
         return -1;
 
     TRACE("%s\n", "*通過時刻表の作成*");
@@ -2111,38 +3074,31 @@ int gtfs_check()
     TRACE("%s\n", "*経路の停車パターンを作成*");
     gtfs_route_trips();
 
-    TRACE("%s\n", "*trips.txtの発着時刻が昇順に並んでいるかチェック*");
-    if (gtfs_trips_time_check() == GTFS_FATAL_ERROR)
-        return -1;
+    gtfs_freeze_tables();
 
-    TRACE("%s\n", "*経路(route_id)の停車パターンが同じかチェック*");
-    if (gtfs_route_stop_pattern_check() == GTFS_FATAL_ERROR)
+    if (gtfs_parallel_check(timetable_jobs, sizeof(timetable_jobs) / sizeof(struct check_job_t)) == GTFS_FATAL_ERROR)
         return -1;
-
-    if (is_gtfs_file_exist(g_gtfs, GTFS_FILE_FARE_RULES)) {
-        // 運賃関係のチェック
-        TRACE("%s\n", "*通過時刻表の区間運賃がfare_rules.txtに登録されているかチェック*");
-        if (gtfs_od_fare_check() == GTFS_FATAL_ERROR)
-            return -1;
-    }
-
-    if (is_gtfs_file_exist(g_gtfs, GTFS_FILE_TRANSLATIONS)) {
-        TRACE("%s\n", "*stops.txtの読みがtranslations.txtに存在するかチェック*");
-        if (gtfs_stop_name_yomi_check() == GTFS_FATAL_ERROR)
-            return -1;
-    }
-
-    TRACE("%s\n", "*stops.txtのstop_nameに重複がないかチェック*");
-    if (gtfs_stop_name_duplicate_check() == GTFS_FATAL_ERROR)
+    if (gtfs_parallel_check(od_fare_jobs, sizeof(od_fare_jobs) / sizeof(struct check_job_t)) == GTFS_FATAL_ERROR)
         return -1;
-
-    TRACE("%s\n", "*routes.txtの経路名に重複がないかチェック*");
-    if (gtfs_route_name_duplicate_check() == GTFS_FATAL_ERROR)
+    if (gtfs_parallel_check(name_jobs, sizeof(name_jobs) / sizeof(struct check_job_t)) == GTFS_FATAL_ERROR)
         return -1;
 
-    TRACE("%s\n", "*stop_times.txtのtrip経路にstop_idの重複がないかチェック*");
-    if (gtfs_trips_stop_id_duplicate_check() == GTFS_FATAL_ERROR)
+    return 0;
+}
+
+int gtfs_check()
+{
+    int result;
+
+    TRACE("%s\n", "*GTFS(zip)の読み込み*");
+    if (gtfs_zip_archive_reader(g_gtfs_zip, g_gtfs) < 0) {
+        err_write("gtfs_check: zip_archive_reader error (%s).\n",
+                  utf8_conv(g_gtfs_zip, (char*)alloca(256), 256));
         return -1;
+    }
 
-    return 0;
+    gtfs_check_cache_open(g_gtfs_zip, g_gtfs);
+    result = gtfs_check_feed();
+    gtfs_check_cache_close(g_gtfs_zip);
+    return result;
 }
@@ -0,0 +1,351 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2018-2021 Val Laboratory Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "gtfstool.h"
+
+/*
+ * 整合性チェックの結果のキャッシュ(.gtfschk)
+ *
+ * チェックごとに、依存するGTFSファイルのキー(zipの中央ディレクトリのCRCとサイズ)から
+ * 求めた依存キーと、チェックの戻り値、エラーと警告の件数、診断メッセージを保存します。
+ * 次回は依存キーが同じチェックを実行せずに保存した診断メッセージを出力するため、
+ * 変更されたファイルに依存するチェックだけが実行されます。
+ *
+ * チェックの結果はオプション(-w -i -r -a)とプログラムのバージョンでも変わるため、
+ * それらが違う場合はキャッシュ全体を使用しません。
+ */
+
+#define CHECK_CACHE_MAGIC       "GTFSCHK"
+#define CHECK_CACHE_VERSION     1
+#define CHECK_CACHE_EXT         ".gtfschk"
+
+struct check_cache_header_t {
+    char magic[8];
+    int version;
+    char program_version[16];
+    uint32 options;             // 結果が変わるオプションのビット
+    int count;                  // チェックの件数
+};
+
+struct check_cache_record_t {
+    uint32 deps_key;            // 依存するファイルのキーから求めたキー
+    int result;                 // チェックの戻り値
+    int64 error_count;          // エラー件数
+    int64 warning_count;        // 警告件数
+    int title_size;             // チェック名のバイト数
+    int text_size;              // 診断メッセージのバイト数
+};
+
+struct check_cache_entry_t {
+    struct check_cache_record_t rec;
+    char* title;
+    char* text;
+};
+
+static struct hash_t* _cache_htbl = NULL;  // key:チェック名 value:struct check_cache_entry_t*
+static struct vector_t* _cache_entries = NULL;
+static int _cache_modified = 0;
+
+static uint32 check_cache_options()
+{
+    uint32 options = 0;
+
+    if (g_ignore_warning)
+        options |= 0x01;
+    if (g_calendar_dates_service_id_check)
+        options |= 0x02;
+    if (g_route_stop_pattern_valid)
+        options |= 0x04;
+    if (g_same_stops_fare_rule_check)
+        options |= 0x08;
+    return options;
+}
+
+static void entry_free(struct check_cache_entry_t* ent)
+{
+    free(ent->title);
+    free(ent->text);
+    free(ent);
+}
+
+static int read_entries(FILE* fp, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        struct check_cache_entry_t* ent;
+
+        ent = (struct check_cache_entry_t*)calloc(1, sizeof(struct check_cache_entry_t));
+        if (fread(&ent->rec, sizeof(ent->rec), 1, fp) != 1 ||
+            ent->rec.title_size <= 0 || ent->rec.text_size < 0) {
+            entry_free(ent);
+            return -1;
+        }
+        ent->title = (char*)malloc(ent->rec.title_size + 1);
+        ent->text = (char*)malloc(ent->rec.text_size + 1);
+        if (fread(ent->title, ent->rec.title_size, 1, fp) != 1 ||
+            (ent->rec.text_size > 0 && fread(ent->text, ent->rec.text_size, 1, fp) != 1)) {
+            entry_free(ent);
+            return -1;
+        }
+        ent->title[ent->rec.title_size] = '\0';
+        ent->text[ent->rec.text_size] = '\0';
+        hash_put(_cache_htbl, ent->title, ent);
+        vect_append(_cache_entries, ent);
+    }
+    return 0;
+}
+
+static void entries_alloc()
+{
+    _cache_htbl = hash_initialize(101);
+    _cache_entries = vect_initialize(16);
+}
+
+static void entries_free()
+{
+    int count, i;
+
+    count = vect_count(_cache_entries);
+    for (i = 0; i < count; i++)
+        entry_free((struct check_cache_entry_t*)vect_get(_cache_entries, i));
+    vect_finalize(_cache_entries);
+    hash_finalize(_cache_htbl);
+    _cache_entries = NULL;
+    _cache_htbl = NULL;
+}
+
+/*
+ * 整合性チェックのキャッシュを読み込みます。
+ * キャッシュがない場合やオプションが違う場合は空のキャッシュで開始します。
+ * 読み込んだGTFSがzipでない場合（ファイルごとのキーがない場合）は使用しません。
+ *
+ * zippath: 入力のzipファイル名
+ * gtfs: 読み込んだGTFS
+ *
+ * 戻り値
+ *  キャッシュを使用する場合はゼロを返します。
+ *  使用しない場合は -1 を返します。
+ */
+int gtfs_check_cache_open(const char* zippath, struct gtfs_t* gtfs)
+{
+    char path[MAX_PATH];
+    struct check_cache_header_t hdr;
+    FILE* fp;
+
+    if (! g_check_cache || ! gtfs->has_file_keys)
+        return -1;
+    if (gtfs_cache_path(zippath, CHECK_CACHE_EXT, path) == NULL)
+        return -1;
+
+    entries_alloc();
+    _cache_modified = 0;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+        return 0;
+    if (fread(&hdr, sizeof(hdr), 1, fp) == 1 &&
+        memcmp(hdr.magic, CHECK_CACHE_MAGIC, sizeof(CHECK_CACHE_MAGIC)) == 0 &&
+        hdr.version == CHECK_CACHE_VERSION &&
+        strncmp(hdr.program_version, PROGRAM_VERSION, sizeof(hdr.program_version)) == 0 &&
+        hdr.options == check_cache_options()) {
+        if (read_entries(fp, hdr.count) < 0) {
+            // 壊れている場合は使用しない
+            entries_free();
+            entries_alloc();
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+/*
+ * チェックが依存するファイルのキーから依存キーを求めます。
+ *
+ * file_bits: 依存するファイル(GTFS_FILE_*のビット)
+ *
+ * 戻り値
+ *  依存キーを返します。
+ */
+uint32 gtfs_check_cache_key(unsigned int file_bits)
+{
+    uint32 keys[GTFS_KIND_COUNT * 2];
+    int kind, n = 0;
+
+    for (kind = 0; kind < GTFS_KIND_COUNT; kind++) {
+        if (file_bits & (1 << kind)) {
+            keys[n++] = (uint32)kind;
+            keys[n++] = g_gtfs->file_keys[kind];
+        }
+    }
+    return MurmurHash2A(keys, (int)(sizeof(uint32) * n), file_bits);
+}
+
+/*
+ * 依存キーが同じ結果がキャッシュにある場合は、診断メッセージを rp に復元します。
+ * 復元した rp は実行した場合と同じように gtfs_report_flush() で出力します。
+ *
+ * title: チェック名
+ * deps_key: 依存キー
+ * rp: 診断メッセージのバッファ
+ * result: チェックの戻り値が設定されます。
+ *
+ * 戻り値
+ *  復元した場合は 1 を返します。それ以外は 0 を返します。
+ */
+int gtfs_check_cache_replay(const char* title, uint32 deps_key, struct gtfs_report_t* rp, int* result)
+{
+    struct check_cache_entry_t* ent;
+
+    if (! _cache_htbl)
+        return 0;
+    ent = (struct check_cache_entry_t*)hash_get(_cache_htbl, title);
+    if (! ent || ent->rec.deps_key != deps_key)
+        return 0;
+
+    rp->mb = mb_alloc(ent->rec.text_size + 1);
+    mb_append(rp->mb, ent->text, ent->rec.text_size);
+    rp->error_count = (long)ent->rec.error_count;
+    rp->warning_count = (long)ent->rec.warning_count;
+    *result = ent->rec.result;
+    return 1;
+}
+
+/*
+ * 実行したチェックの結果をキャッシュに登録します。
+ * gtfs_report_flush() で出力する前に呼び出します。
+ *
+ * title: チェック名
+ * deps_key: 依存キー
+ * rp: 診断メッセージのバッファ
+ * result: チェックの戻り値
+ */
+void gtfs_check_cache_put(const char* title, uint32 deps_key, struct gtfs_report_t* rp, int result)
+{
+    struct check_cache_entry_t* ent;
+    int text_size;
+
+    if (! _cache_htbl)
+        return;
+    ent = (struct check_cache_entry_t*)hash_get(_cache_htbl, title);
+    if (! ent) {
+        ent = (struct check_cache_entry_t*)calloc(1, sizeof(struct check_cache_entry_t));
+        ent->title = strdup(title);
+        ent->rec.title_size = (int)strlen(title);
+        hash_put(_cache_htbl, ent->title, ent);
+        vect_append(_cache_entries, ent);
+    }
+    text_size = (rp->mb)? rp->mb->size : 0;
+    free(ent->text);
+    ent->text = (char*)malloc(text_size + 1);
+    if (text_size > 0)
+        memcpy(ent->text, rp->mb->buf, text_size);
+    ent->text[text_size] = '\0';
+    ent->rec.text_size = text_size;
+    ent->rec.deps_key = deps_key;
+    ent->rec.result = result;
+    ent->rec.error_count = rp->error_count;
+    ent->rec.warning_count = rp->warning_count;
+    _cache_modified = 1;
+}
+
+static int write_entries(FILE* fp)
+{
+    struct check_cache_header_t hdr;
+    int count, i;
+
+    count = vect_count(_cache_entries);
+    memset(&hdr, '\0', sizeof(hdr));
+    memcpy(hdr.magic, CHECK_CACHE_MAGIC, sizeof(CHECK_CACHE_MAGIC));
+    hdr.version = CHECK_CACHE_VERSION;
+    strncpy(hdr.program_version, PROGRAM_VERSION, sizeof(hdr.program_version)-1);
+    hdr.options = check_cache_options();
+    hdr.count = count;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+        return -1;
+
+    for (i = 0; i < count; i++) {
+        struct check_cache_entry_t* ent;
+
+        ent = (struct check_cache_entry_t*)vect_get(_cache_entries, i);
+        if (fwrite(&ent->rec, sizeof(ent->rec), 1, fp) != 1 ||
+            fwrite(ent->title, ent->rec.title_size, 1, fp) != 1)
+            return -1;
+        if (ent->rec.text_size > 0 && fwrite(ent->text, ent->rec.text_size, 1, fp) != 1)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * 整合性チェックのキャッシュを保存して解放します。
+ * 一時ファイルに出力してから名前を変更するため、出力中のキャッシュを
+ * 他のプロセスが読み込むことはありません。
+ * 前回の結果を再利用しなかったチェックがない場合は保存しません。
+ *
+ * zippath: 入力のzipファイル名
+ *
+ * 戻り値
+ *  保存した場合、または保存する必要がない場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+int gtfs_check_cache_close(const char* zippath)
+{
+    char path[MAX_PATH];
+    char tmppath[MAX_PATH+8];
+    FILE* fp;
+    int result = 0;
+
+    if (! _cache_htbl)
+        return 0;
+
+    if (_cache_modified && gtfs_cache_path(zippath, CHECK_CACHE_EXT, path)) {
+        if (g_snapshot_dir && *g_snapshot_dir)
+            makedir(g_snapshot_dir);
+        snprintf(tmppath, sizeof(tmppath), "%s.%d", path, (int)getpid());
+        fp = fopen(tmppath, "wb");
+        if (fp == NULL) {
+            err_write("%s: check cache create error.\n", tmppath);
+            result = -1;
+        } else {
+            result = write_entries(fp);
+            if (fclose(fp) != 0)
+                result = -1;
+            if (result == 0) {
+#ifdef _WIN32
+                remove(path);
+#endif
+                if (rename(tmppath, path) != 0)
+                    result = -1;
+            }
+            if (result < 0) {
+                err_write("%s: check cache write error.\n", path);
+                remove(tmppath);
+            }
+        }
+    }
+
+    entries_free();
+    return result;
+}
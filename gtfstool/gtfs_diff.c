@@ -29,7 +29,7 @@ static void gtfs_diff_agency(const char* dir, struct vector_t* tbl, struct vecto
     char csvpath[MAX_PATH];
     int count, i, diff_count;
 
-    char agency_name[256];
+    char agency_name[QUOTED_SIZE(256)];
 
     strcpy(csvpath, dir);
     catpath(csvpath, g_gtfs_filename[AGENCY]);
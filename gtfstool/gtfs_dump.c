@@ -24,6 +24,24 @@
  */
 #include "gtfstool.h"
 
+// 時刻表の出力で使用する項目
+static const struct gtfs_columns_t _dump_columns[] = {
+    { STOPS, "stop_id,stop_name,zone_id,parent_station" },
+    { ROUTES, "route_id,route_short_name,route_long_name" },
+    { TRIPS, "route_id,trip_id" },
+    { STOP_TIMES, "trip_id,arrival_time,departure_time,stop_id,stop_sequence,pickup_type,drop_off_type" },
+    { FARE_ATTRIBUTES, "fare_id,price" },
+    { FARE_RULES, "fare_id,route_id,origin_id,destination_id" },
+    { -1, NULL }
+};
+
+// 読み込むファイル(キーの重複チェックで参照するファイルを含む)
+// shapes.txt などの使用しないファイルは展開しません。
+static const unsigned int _dump_files = GTFS_FILE_AGENCY | GTFS_FILE_STOPS | GTFS_FILE_ROUTES |
+                                        GTFS_FILE_TRIPS | GTFS_FILE_STOP_TIMES | GTFS_FILE_CALENDAR |
+                                        GTFS_FILE_CALENDAR_DATES | GTFS_FILE_FARE_ATTRIBUTES |
+                                        GTFS_FILE_FARE_RULES | GTFS_FILE_TRANSLATIONS | GTFS_FILE_ROUTES_JP;
+
 static void dump_stop_times(int cols, int rows, struct vector_t** v_tbl)
 {
     int x, y;
@@ -56,14 +74,22 @@ static void dump_stop_times(int cols, int rows, struct vector_t** v_tbl)
                 } else {
                     if (vect_count(vt) > y) {
                         struct stop_time_t* st;
+                        char dept[ST_TEXT_SIZE], arrv[ST_TEXT_SIZE];
+                        const char* departure_time;
+                        const char* arrival_time;
+                        int pickup_type, drop_off_type;
 
                         st = (struct stop_time_t*)vect_get(vt, y);
-                        printf("%s", st->departure_time);
-                        if (strcmp(st->departure_time, st->arrival_time) != 0)
-                            printf("(%s)", st->arrival_time);
-                        if (atoi(st->pickup_type) > 0 || atoi(st->drop_off_type) > 0) {
-                            printf("(%s|%s)", (atoi(st->pickup_type) > 0)? "x" : "o",
-                                              (atoi(st->drop_off_type) > 0)? "x" : "o");
+                        departure_time = gtfs_stop_time_text(st, ST_DEPARTURE_TIME, dept);
+                        arrival_time = gtfs_stop_time_text(st, ST_ARRIVAL_TIME, arrv);
+                        pickup_type = gtfs_stop_time_pickup_type(st);
+                        drop_off_type = gtfs_stop_time_drop_off_type(st);
+                        printf("%s", departure_time);
+                        if (strcmp(departure_time, arrival_time) != 0)
+                            printf("(%s)", arrival_time);
+                        if (pickup_type > 0 || drop_off_type > 0) {
+                            printf("(%s|%s)", (pickup_type > 0)? "x" : "o",
+                                              (drop_off_type > 0)? "x" : "o");
                         }
                     }
                 }
@@ -76,25 +102,24 @@ static void dump_stop_times(int cols, int rows, struct vector_t** v_tbl)
     }
 }
 
-static void dump_route_trips(struct route_t* route, struct vector_t* trips_tbl)
+static void dump_route_trips(struct route_t* route, int route_no)
 {
     int count, i;
+    struct trip_t** trips;
+    int* trip_nos;
     struct vector_t** v_tbl;
     int rows = 0;
-    struct trip_t* trip;
-    struct vector_t* stop_times_tbl;
+    struct stop_time_t** stop_times;
     int stop_times_count, j;
 
-    count = vect_count(trips_tbl);
+    trips = gtfs_route_trip_list(route_no, &trip_nos, &count);
     if (count == 0)
         return;
 
     v_tbl = (struct vector_t**)calloc(count+1, sizeof(struct vector_t*));
 
     // stopnames
-    trip = (struct trip_t*)vect_get(trips_tbl, 0);
-    stop_times_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-    stop_times_count = vect_count(stop_times_tbl);
+    stop_times = gtfs_trip_timetable(trip_nos[0], &stop_times_count);
     v_tbl[0] = vect_initialize(stop_times_count);
     rows = stop_times_count + 1;
     vect_append(v_tbl[0], "");
@@ -102,29 +127,22 @@ static void dump_route_trips(struct route_t* route, struct vector_t* trips_tbl)
         struct stop_time_t* st;
         struct stop_t* stop;
             
-        st = (struct stop_time_t*)vect_get(stop_times_tbl, j);
-        stop = (struct stop_t*)hash_get(g_gtfs_hash->stops_htbl, st->stop_id);
+        st = stop_times[j];
+        stop = (struct stop_t*)hash_get(g_gtfs_hash->stops_htbl, gtfs_id(st->stop_id));
         vect_append(v_tbl[0], stop);
     }
 
     // times
     for (i = 0; i < count; i++) {
-        struct trip_t* trip;
-        struct vector_t* stop_times_tbl;
+        struct stop_time_t** stop_times;
         int stop_times_count, j;
 
-        trip = (struct trip_t*)vect_get(trips_tbl, i);
-        stop_times_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-        stop_times_count = vect_count(stop_times_tbl);
+        stop_times = gtfs_trip_timetable(trip_nos[i], &stop_times_count);
         v_tbl[i+1] = vect_initialize(stop_times_count);
 
-        vect_append(v_tbl[i+1], trip);
-        for (j = 0; j < stop_times_count; j++) {
-            struct stop_time_t* st;
-
-            st = (struct stop_time_t*)vect_get(stop_times_tbl, j);
-            vect_append(v_tbl[i+1], st);
-        }
+        vect_append(v_tbl[i+1], trips[i]);
+        for (j = 0; j < stop_times_count; j++)
+            vect_append(v_tbl[i+1], stop_times[j]);
     }
 
     dump_stop_times(count+1, rows, v_tbl);
@@ -140,6 +158,8 @@ int gtfs_dump()
     int count, i;
     
     TRACE("%s\n", "*GTFS(zip)の読み込み*");
+    g_gtfs_columns = _dump_columns;
+    g_gtfs_files = _dump_files;
     if (gtfs_zip_archive_reader(g_gtfs_zip, g_gtfs) < 0) {
         err_write("gtfs_check: zip_archive_reader error (%s).\n",
                   utf8_conv(g_gtfs_zip, (char*)alloca(256), 256));
@@ -159,7 +179,6 @@ int gtfs_dump()
     count = vect_count(g_gtfs->routes_tbl);
     for (i = 0; i < count; i++) {
         struct route_t* route;
-        struct vector_t* trips_tbl;
         
         route = (struct route_t*)vect_get(g_gtfs->routes_tbl, i);
         if (i > 0)
@@ -168,8 +187,7 @@ int gtfs_dump()
                utf8_conv(route->route_id, (char*)alloca(256), 256),
                utf8_conv(route->route_short_name, (char*)alloca(256), 256),
                utf8_conv(route->route_long_name, (char*)alloca(256), 256));
-        trips_tbl = (struct vector_t*)hash_get(g_route_trips_htbl, route->route_id);
-        dump_route_trips(route, trips_tbl);
+        dump_route_trips(route, gtfs_route_no(route->route_id));
     }
     return 0;
 }
@@ -24,14 +24,30 @@
  */
 #include "gtfstool.h"
 
-static void fare_list_line(struct route_t* route, struct vector_t* stop_times_tbl, int index)
+// 運賃表の出力で使用する項目
+static const struct gtfs_columns_t _fare_columns[] = {
+    { STOPS, "stop_id,stop_name,zone_id,parent_station" },
+    { ROUTES, "route_id,route_short_name,route_long_name" },
+    { TRIPS, "route_id,trip_id" },
+    { STOP_TIMES, "trip_id,stop_id,stop_sequence" },
+    { FARE_ATTRIBUTES, "fare_id,price" },
+    { FARE_RULES, "fare_id,route_id,origin_id,destination_id" },
+    { -1, NULL }
+};
+
+// 読み込むファイル(キーの重複チェックで参照するファイルを含む)
+// shapes.txt などの使用しないファイルは展開しません。
+static const unsigned int _fare_files = GTFS_FILE_AGENCY | GTFS_FILE_STOPS | GTFS_FILE_ROUTES |
+                                        GTFS_FILE_TRIPS | GTFS_FILE_STOP_TIMES | GTFS_FILE_CALENDAR |
+                                        GTFS_FILE_CALENDAR_DATES | GTFS_FILE_FARE_ATTRIBUTES |
+                                        GTFS_FILE_FARE_RULES | GTFS_FILE_TRANSLATIONS | GTFS_FILE_ROUTES_JP;
+
+static void fare_list_line(struct route_t* route, struct stop_time_t** stop_times, int n, int index)
 {
-    int n, i;
+    int i;
     struct stop_time_t* st;
     struct stop_t* stop;
 
-    n = vect_count(stop_times_tbl);
-
     // route_id column
     printf(",");
 
@@ -39,8 +55,8 @@ static void fare_list_line(struct route_t* route, struct vector_t* stop_times_tb
         printf(",");
     }
 
-    st = (struct stop_time_t*)vect_get(stop_times_tbl, index);
-    stop = (struct stop_t*)hash_get(g_gtfs_hash->stops_htbl, st->stop_id);
+    st = stop_times[index];
+    stop = (struct stop_t*)hash_get(g_gtfs_hash->stops_htbl, gtfs_id(st->stop_id));
     printf("%s",
            utf8_conv(stop->stop_name, (char*)alloca(256), 256));
 //           utf8_conv(stop->zone_id, (char*)alloca(256), 256));
@@ -54,8 +70,8 @@ static void fare_list_line(struct route_t* route, struct vector_t* stop_times_tb
         struct fare_attribute_t* fattr;
 
         printf(",");
-        dest_st = (struct stop_time_t*)vect_get(stop_times_tbl, i);
-        dest_stop = (struct stop_t*)hash_get(g_gtfs_hash->stops_htbl, dest_st->stop_id);
+        dest_st = stop_times[i];
+        dest_stop = (struct stop_t*)hash_get(g_gtfs_hash->stops_htbl, gtfs_id(dest_st->stop_id));
         fare_rule_key(route->route_id, stop->zone_id, dest_stop->zone_id, hkey);
         frule = hash_get(g_gtfs_hash->fare_rules_htbl, hkey);
         if (! frule) {
@@ -71,21 +87,16 @@ static void fare_list_line(struct route_t* route, struct vector_t* stop_times_tb
     printf("\n");
 }
 
-static int target_trip(struct vector_t* trips_tbl)
+static int target_trip(int* trip_nos, int count)
 {
-    int count, i;
+    int i;
     int max_stops = 0;
     int target_index = 0;
 
-    count = vect_count(trips_tbl);
     for (i = 0; i < count; i++) {
-        struct trip_t* trip;
-        struct vector_t* stop_times_tbl;
         int stop_times_count;
 
-        trip = (struct trip_t*)vect_get(trips_tbl, i);
-        stop_times_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-        stop_times_count = vect_count(stop_times_tbl);
+        gtfs_trip_timetable(trip_nos[i], &stop_times_count);
         if (stop_times_count > max_stops) {
             max_stops = stop_times_count;
             target_index = i;
@@ -94,26 +105,24 @@ static int target_trip(struct vector_t* trips_tbl)
     return target_index;
 }
 
-static void fare_route_trips(struct route_t* route, struct vector_t* trips_tbl)
+static void fare_route_trips(struct route_t* route, int route_no)
 {
     int count, i;
     int index;
-    struct trip_t* trip;
-    struct vector_t* stop_times_tbl;
+    int* trip_nos;
+    struct stop_time_t** stop_times;
     int stop_times_count;
 
-    count = vect_count(trips_tbl);
+    gtfs_route_trip_list(route_no, &trip_nos, &count);
     if (count == 0)
         return;
 
     // stopnames
-    index = target_trip(trips_tbl);
-    trip = (struct trip_t*)vect_get(trips_tbl, index);
-    stop_times_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-    stop_times_count = vect_count(stop_times_tbl);
+    index = target_trip(trip_nos, count);
+    stop_times = gtfs_trip_timetable(trip_nos[index], &stop_times_count);
 
     for (i = stop_times_count-1; i >= 0; i--) {
-        fare_list_line(route, stop_times_tbl, i);
+        fare_list_line(route, stop_times, stop_times_count, i);
     }
 }
 
@@ -122,6 +131,8 @@ int gtfs_fare()
     int count, i;
     
     TRACE("%s\n", "*GTFS(zip)の読み込み*");
+    g_gtfs_columns = _fare_columns;
+    g_gtfs_files = _fare_files;
     if (gtfs_zip_archive_reader(g_gtfs_zip, g_gtfs) < 0) {
         err_write("gtfs_check: zip_archive_reader error (%s).\n",
                   utf8_conv(g_gtfs_zip, (char*)alloca(256), 256));
@@ -141,7 +152,6 @@ int gtfs_fare()
     count = vect_count(g_gtfs->routes_tbl);
     for (i = 0; i < count; i++) {
         struct route_t* route;
-        struct vector_t* trips_tbl;
         
         route = (struct route_t*)vect_get(g_gtfs->routes_tbl, i);
         if (i > 0)
@@ -150,8 +160,7 @@ int gtfs_fare()
                utf8_conv(route->route_id, (char*)alloca(256), 256),
                utf8_conv(route->route_short_name, (char*)alloca(256), 256),
                utf8_conv(route->route_long_name, (char*)alloca(256), 256));
-        trips_tbl = (struct vector_t*)hash_get(g_route_trips_htbl, route->route_id);
-        fare_route_trips(route, trips_tbl);
+        fare_route_trips(route, gtfs_route_no(route->route_id));
     }
     return 0;
 }
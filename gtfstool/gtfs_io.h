@@ -49,6 +49,8 @@
 #define ROUTES_JP           15
 #define OFFICE_JP           16
 
+#define GTFS_KIND_COUNT     17  // ファイル種別の数
+
 // GTFS files
 #define GTFS_FILE_AGENCY            0x00000001
 #define GTFS_FILE_STOPS             0x00000002
@@ -67,11 +69,16 @@
 #define GTFS_FILE_AGENCY_JP         0x00004000
 #define GTFS_FILE_ROUTES_JP         0x00008000
 #define GTFS_FILE_OFFICE_JP         0x00010000
+#define GTFS_FILE_ALL               0x0001FFFF
 
 #define MAX_CORP_NAME               256
 #define MAX_RAIL_NAME               256
 #define MAX_STATION_NAME            256
 
+// add_quote() の出力に必要なバッファサイズ（n は元の文字列のバッファサイズ）
+// 埋め込まれた '"' がすべて二重化され、前後を '"' で囲んだ場合の最大長です。
+#define QUOTED_SIZE(n)              ((n) * 2 + 1)
+
 #define CHOICE_ROUTE_NAME           1
 #define CHOICE_ROUTE_LONG_NAME      2
 #define CHOICE_TRIP_HEADSIGN        3
@@ -132,6 +139,9 @@ struct stop_t {
     char parent_station[GTFS_ID_SIZE];  // 標柱の場合の停留所ID
     char stop_timezone[64];             // タイムゾーン
     char wheelchair_boarding[8];        // 車椅子情報
+    double stop_lat_value;              // 緯度(数値)
+    double stop_lon_value;              // 経度(数値)
+    int location_type_value;            // 停留所・標柱区分(数値)
     int lineno;                         // 行番号
 };
 
@@ -154,20 +164,43 @@ struct trip_t {
 };
 
 // stop_times.txt
+// 時刻は0時からの秒数、連番と乗降区分は数値で保持します。
+// 文字列の項目と数値から元の文字列を再現できない値は、
+// 一つにまとめて文字列プール(g_gtfs_strs)に登録します(ext)。
+// 項目の文字列は gtfs_stop_time_text() で取得します。
 struct stop_time_t {
-    char trip_id[GTFS_ID_SIZE];     // 便ID
-    char arrival_time[16];          // 到着時刻（HH:MM:SS）
-    char departure_time[16];        // 出発時刻（HH:MM:SS）
-    char stop_id[GTFS_ID_SIZE];     // 駅コード
-    char stop_sequence[16];         // 連番
-    char stop_headsign[256];        // 停留所行き先
-    char pickup_type[8];            // 乗車区分（0:通常の乗車地）
-    char drop_off_type[8];          // 降車区分（0:通常の降車地）
-    char shape_dist_traveled[16];   // 通算距離（メートル）
-    char timepoint[64];             // 発着時間精度
+    uint32 trip_id;                 // 便ID(シンボル)
+    uint32 stop_id;                 // 駅コード(シンボル)
+    int arrival_time;               // 到着時刻（0時からの秒数）
+    int departure_time;             // 出発時刻（0時からの秒数）
+    int stop_sequence;              // 連番
+    uint32 ext;                     // 停留所行き先、通算距離、発着時間精度など(シンボル)
     int lineno;                     // 行番号
+    uchar pickup_type;              // 乗車区分（0:通常の乗車地）
+    uchar drop_off_type;            // 降車区分（0:通常の降車地）
+    unsigned short flags;           // 項目の状態(ST_HAS_*, ST_RAW_*, ST_SHORT_*)
 };
 
+// stop_time_t の項目(gtfs_stop_time_text)
+// ST_STOP_HEADSIGN から順に ext に格納されます。
+#define ST_STOP_HEADSIGN            0
+#define ST_SHAPE_DIST_TRAVELED      1
+#define ST_TIMEPOINT                2
+#define ST_ARRIVAL_TIME             3
+#define ST_DEPARTURE_TIME           4
+#define ST_STOP_SEQUENCE            5
+#define ST_PICKUP_TYPE              6
+#define ST_DROP_OFF_TYPE            7
+#define ST_EXT_COUNT                8
+
+// stop_time_t の flags
+#define ST_HAS(column)              (0x0001 << (column))    // 値あり(数値の項目)
+#define ST_RAW(column)              (0x0100 << (column))    // 元の文字列を ext に格納
+#define ST_SHORT_ARRIVAL            0x0001                  // 到着時刻の時が1桁(H:MM:SS)
+#define ST_SHORT_DEPARTURE          0x0002                  // 出発時刻の時が1桁(H:MM:SS)
+
+#define ST_TEXT_SIZE                16  // gtfs_stop_time_text() のバッファサイズ
+
 // calendar.txt
 struct calendar_t {
     char service_id[GTFS_ID_SIZE];  // サービスID
@@ -200,6 +233,7 @@ struct fare_attribute_t {
     char transfers[8];              // 乗換
     char agency_id[GTFS_ID_SIZE];   // 事業者ID（agency.txtで複数の事業者が定義された場合は必要）
     char transfer_duration[16];     // 乗換有効期限
+    int price_value;                // 運賃(数値)
     int lineno;                     // 行番号
 };
 
@@ -287,6 +321,13 @@ struct office_jp_t {
     int lineno;                     // 行番号
 };
 
+// メモリにマッピングしたスナップショットの領域
+struct gtfs_mapping_t {
+    struct gtfs_mapping_t* next;
+    char* ptr;
+    int64 size;
+};
+
 struct gtfs_t {
     unsigned int file_exist_bits;           // ファイル存在情報（GTFS filesのビットがON）
     struct vector_t* agency_tbl;            // 事業者情報テーブル
@@ -305,6 +346,21 @@ struct gtfs_t {
     struct vector_t* translations_tbl;      // 翻訳情報テーブル
     struct vector_t* routes_jp_tbl;         // 経路追加情報テーブル
     struct vector_t* office_jp_tbl;         // 営業所情報テーブル
+    struct vector_t* value_errors;          // 読み込み時の値の書式エラー(struct gtfs_value_error_t)
+    struct arena_t* row_arena[GTFS_KIND_COUNT]; // テーブルのレコードの領域(ファイル種別ごと)
+    struct gtfs_mapping_t* mappings;        // テーブルのレコードが参照しているスナップショットの領域
+    unsigned int deferred_bits;             // 読み込みを後回しにしたファイル(GTFS_FILE_*のビット)
+    char source_path[MAX_PATH];             // 後回しにしたファイルの読み込み元(zipまたはディレクトリ)
+    uint32 file_keys[GTFS_KIND_COUNT];      // zipの各ファイルのCRCとサイズから求めたキー(0:ファイルなし)
+    int has_file_keys;                      // file_keys を求めた場合は1(zip以外は0)
+};
+
+// 読み込み時に検出した値の書式エラー
+struct gtfs_value_error_t {
+    int kind;                               // ファイル種別
+    int lineno;                             // 行番号
+    char column[24];                        // 項目名
+    char value[64];                         // 値
 };
 
 struct gtfs_hash_t {
@@ -320,6 +376,13 @@ struct gtfs_hash_t {
     struct hash_t* routes_jp_htbl;          // 経路追加情報テーブル
 };
 
+// 読み込む項目の指定(kindが-1で終端)
+// 指定のないファイルはすべての項目を読み込みます。
+struct gtfs_columns_t {
+    int kind;                               // ファイル種別
+    const char* columns;                    // 読み込む項目名(カンマ区切り)
+};
+
 struct gtfs_label_t {
     char agency[256];
     char agency_jp[256];
@@ -348,6 +411,20 @@ extern "C" {
 // gtfs_reader.c
 int find_label_index(char** label_list, const char* target_label);
 int gtfs_zip_archive_reader(const char* zippath, struct gtfs_t* gtfs);
+uint32 gtfs_id_sym(const char* id);
+uint32 gtfs_id_find(const char* id);
+const char* gtfs_id(uint32 sym);
+void* gtfs_row_alloc(struct gtfs_t* gtfs, int kind, int size);
+struct vector_t** gtfs_table(struct gtfs_t* gtfs, int kind);
+int gtfs_table_load(struct gtfs_t* gtfs, unsigned int file_bits);
+const char* gtfs_stop_time_text(const struct stop_time_t* st, int column, char* buf);
+int gtfs_stop_time_pickup_type(const struct stop_time_t* st);
+int gtfs_stop_time_drop_off_type(const struct stop_time_t* st);
+
+// gtfs_snapshot.c
+char* gtfs_cache_path(const char* zippath, const char* ext, char* path);
+int gtfs_snapshot_load(const char* zippath, int64 source_size, uint32 source_key, struct gtfs_t* gtfs);
+int gtfs_snapshot_save(const char* zippath, int64 source_size, uint32 source_key, struct gtfs_t* gtfs);
 
 // gtfs_writer.c
 char* add_quote(char* qstr, const char* str);
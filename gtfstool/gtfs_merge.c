@@ -27,22 +27,35 @@
 static struct gtfs_t* _mrg_gtfs;                // マージされたGTFS
 static struct hash_t* _mrg_translations_htbl;   // マージされた翻訳情報のハッシュテーブル（キーは"trans_id/lang"）
 
+/*
+ * IDの先頭にプレフィックスを付加します。
+ * 格納先のサイズを超える部分は切り捨てられます。
+ */
+static void add_prefix(char* id, int size, const char* prefix)
+{
+    char buf[256];
+
+    if (strlen(id) > 0 && size <= (int)sizeof(buf)) {
+        snprintf(buf, size, "%s%s", prefix, id);
+        strcpy(id, buf);
+    }
+}
+
+/*
+ * 以下の関数は読み込んだレコードのIDを書き換えて、マージ先のテーブルに追加します。
+ * レコードの領域は gtfs_merge_one() でマージ先に移します。
+ */
 static void gtfs_merge_stops(struct vector_t* src_tbl, struct vector_t* merge_tbl, const char* prefix)
 {
     int count, i;
 
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct stop_t* s;
         struct stop_t* t;
 
-        s = (struct stop_t*)vect_get(src_tbl, i);
-        t = (struct stop_t*)malloc(sizeof(struct stop_t));
-        memcpy(t, s, sizeof(struct stop_t));
-        if (strlen(s->stop_id) > 0)
-            snprintf(t->stop_id, sizeof(t->stop_id), "%s%s", prefix, s->stop_id);
-        if (strlen(s->zone_id) > 0)
-            snprintf(t->zone_id, sizeof(t->zone_id), "%s%s", prefix, s->zone_id);
+        t = (struct stop_t*)vect_get(src_tbl, i);
+        add_prefix(t->stop_id, sizeof(t->stop_id), prefix);
+        add_prefix(t->zone_id, sizeof(t->zone_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -53,16 +66,11 @@ static void gtfs_merge_routes(struct vector_t* src_tbl, struct vector_t* merge_t
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct route_t* s;
         struct route_t* t;
         
-        s = (struct route_t*)vect_get(src_tbl, i);
-        t = (struct route_t*)malloc(sizeof(struct route_t));
-        memcpy(t, s, sizeof(struct route_t));
-        if (strlen(s->route_id) > 0)
-            snprintf(t->route_id, sizeof(t->route_id), "%s%s", prefix, s->route_id);
-        if (strlen(s->jp_parent_route_id) > 0)
-            snprintf(t->jp_parent_route_id, sizeof(t->jp_parent_route_id), "%s%s", prefix, s->jp_parent_route_id);
+        t = (struct route_t*)vect_get(src_tbl, i);
+        add_prefix(t->route_id, sizeof(t->route_id), prefix);
+        add_prefix(t->jp_parent_route_id, sizeof(t->jp_parent_route_id), prefix);
         // agency_idを更新
         strcpy(t->agency_id, g_merged_agency.agency_id);
         vect_append(merge_tbl, t);
@@ -75,14 +83,10 @@ static void gtfs_merge_routes_jp(struct vector_t* src_tbl, struct vector_t* merg
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct route_jp_t* s;
         struct route_jp_t* t;
         
-        s = (struct route_jp_t*)vect_get(src_tbl, i);
-        t = (struct route_jp_t*)malloc(sizeof(struct route_jp_t));
-        memcpy(t, s, sizeof(struct route_jp_t));
-        if (strlen(s->route_id) > 0)
-            snprintf(t->route_id, sizeof(t->route_id), "%s%s", prefix, s->route_id);
+        t = (struct route_jp_t*)vect_get(src_tbl, i);
+        add_prefix(t->route_id, sizeof(t->route_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -93,24 +97,15 @@ static void gtfs_merge_trips(struct vector_t* src_tbl, struct vector_t* merge_tb
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct trip_t* s;
         struct trip_t* t;
         
-        s = (struct trip_t*)vect_get(src_tbl, i);
-        t = (struct trip_t*)malloc(sizeof(struct trip_t));
-        memcpy(t, s, sizeof(struct trip_t));
-        if (strlen(s->trip_id) > 0)
-            snprintf(t->trip_id, sizeof(t->trip_id), "%s%s", prefix, s->trip_id);
-        if (strlen(s->service_id) > 0)
-            snprintf(t->service_id, sizeof(t->service_id), "%s%s", prefix, s->service_id);
-        if (strlen(s->route_id) > 0)
-            snprintf(t->route_id, sizeof(t->route_id), "%s%s", prefix, s->route_id);
-        if (strlen(s->block_id) > 0)
-            snprintf(t->block_id, sizeof(t->block_id), "%s%s", prefix, s->block_id);
-        if (strlen(s->shape_id) > 0)
-            snprintf(t->shape_id, sizeof(t->shape_id), "%s%s", prefix, s->shape_id);
-        if (strlen(s->jp_office_id) > 0)
-            snprintf(t->jp_office_id, sizeof(t->jp_office_id), "%s%s", prefix, s->jp_office_id);
+        t = (struct trip_t*)vect_get(src_tbl, i);
+        add_prefix(t->trip_id, sizeof(t->trip_id), prefix);
+        add_prefix(t->service_id, sizeof(t->service_id), prefix);
+        add_prefix(t->route_id, sizeof(t->route_id), prefix);
+        add_prefix(t->block_id, sizeof(t->block_id), prefix);
+        add_prefix(t->shape_id, sizeof(t->shape_id), prefix);
+        add_prefix(t->jp_office_id, sizeof(t->jp_office_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -121,14 +116,10 @@ static void gtfs_merge_office_jp(struct vector_t* src_tbl, struct vector_t* merg
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct office_jp_t* s;
         struct office_jp_t* t;
         
-        s = (struct office_jp_t*)vect_get(src_tbl, i);
-        t = (struct office_jp_t*)malloc(sizeof(struct office_jp_t));
-        memcpy(t, s, sizeof(struct office_jp_t));
-        if (strlen(s->office_id) > 0)
-            snprintf(t->office_id, sizeof(t->office_id), "%s%s", prefix, s->office_id);
+        t = (struct office_jp_t*)vect_get(src_tbl, i);
+        add_prefix(t->office_id, sizeof(t->office_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -139,16 +130,19 @@ static void gtfs_merge_stop_times(struct vector_t* src_tbl, struct vector_t* mer
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct stop_time_t* s;
         struct stop_time_t* t;
         
-        s = (struct stop_time_t*)vect_get(src_tbl, i);
-        t = (struct stop_time_t*)malloc(sizeof(struct stop_time_t));
-        memcpy(t, s, sizeof(struct stop_time_t));
-        if (strlen(s->trip_id) > 0)
-            snprintf(t->trip_id, sizeof(t->trip_id), "%s%s", prefix, s->trip_id);
-        if (strlen(s->stop_id) > 0)
-            snprintf(t->stop_id, sizeof(t->stop_id), "%s%s", prefix, s->stop_id);
+        t = (struct stop_time_t*)vect_get(src_tbl, i);
+        if (t->trip_id != 0) {
+            char trip_id[GTFS_ID_SIZE];
+            snprintf(trip_id, sizeof(trip_id), "%s%s", prefix, gtfs_id(t->trip_id));
+            t->trip_id = gtfs_id_sym(trip_id);
+        }
+        if (t->stop_id != 0) {
+            char stop_id[GTFS_ID_SIZE];
+            snprintf(stop_id, sizeof(stop_id), "%s%s", prefix, gtfs_id(t->stop_id));
+            t->stop_id = gtfs_id_sym(stop_id);
+        }
         vect_append(merge_tbl, t);
     }
 }
@@ -159,14 +153,10 @@ static void gtfs_merge_calendar(struct vector_t* src_tbl, struct vector_t* merge
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct calendar_t* s;
         struct calendar_t* t;
         
-        s = (struct calendar_t*)vect_get(src_tbl, i);
-        t = (struct calendar_t*)malloc(sizeof(struct calendar_t));
-        memcpy(t, s, sizeof(struct calendar_t));
-        if (strlen(s->service_id) > 0)
-            snprintf(t->service_id, sizeof(t->service_id), "%s%s", prefix, s->service_id);
+        t = (struct calendar_t*)vect_get(src_tbl, i);
+        add_prefix(t->service_id, sizeof(t->service_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -177,14 +167,10 @@ static void gtfs_merge_calendar_dates(struct vector_t* src_tbl, struct vector_t*
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct calendar_date_t* s;
         struct calendar_date_t* t;
         
-        s = (struct calendar_date_t*)vect_get(src_tbl, i);
-        t = (struct calendar_date_t*)malloc(sizeof(struct calendar_date_t));
-        memcpy(t, s, sizeof(struct calendar_date_t));
-        if (strlen(s->service_id) > 0)
-            snprintf(t->service_id, sizeof(t->service_id), "%s%s", prefix, s->service_id);
+        t = (struct calendar_date_t*)vect_get(src_tbl, i);
+        add_prefix(t->service_id, sizeof(t->service_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -195,14 +181,10 @@ static void gtfs_merge_fare_attributes(struct vector_t* src_tbl, struct vector_t
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct fare_attribute_t* s;
         struct fare_attribute_t* t;
         
-        s = (struct fare_attribute_t*)vect_get(src_tbl, i);
-        t = (struct fare_attribute_t*)malloc(sizeof(struct fare_attribute_t));
-        memcpy(t, s, sizeof(struct fare_attribute_t));
-        if (strlen(s->fare_id) > 0)
-            snprintf(t->fare_id, sizeof(t->fare_id), "%s%s", prefix, s->fare_id);
+        t = (struct fare_attribute_t*)vect_get(src_tbl, i);
+        add_prefix(t->fare_id, sizeof(t->fare_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -213,22 +195,14 @@ static void gtfs_merge_fare_rules(struct vector_t* src_tbl, struct vector_t* mer
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct fare_rule_t* s;
         struct fare_rule_t* t;
         
-        s = (struct fare_rule_t*)vect_get(src_tbl, i);
-        t = (struct fare_rule_t*)malloc(sizeof(struct fare_rule_t));
-        memcpy(t, s, sizeof(struct fare_rule_t));
-        if (strlen(s->fare_id) > 0)
-            snprintf(t->fare_id, sizeof(t->fare_id), "%s%s", prefix, s->fare_id);
-        if (strlen(s->route_id) > 0)
-            snprintf(t->route_id, sizeof(t->route_id), "%s%s", prefix, s->route_id);
-        if (strlen(s->origin_id) > 0)
-            snprintf(t->origin_id, sizeof(t->origin_id), "%s%s", prefix, s->origin_id);
-        if (strlen(s->destination_id) > 0)
-            snprintf(t->destination_id, sizeof(t->destination_id), "%s%s", prefix, s->destination_id);
-        if (strlen(s->contains_id) > 0)
-            snprintf(t->contains_id, sizeof(t->contains_id), "%s%s", prefix, s->contains_id);
+        t = (struct fare_rule_t*)vect_get(src_tbl, i);
+        add_prefix(t->fare_id, sizeof(t->fare_id), prefix);
+        add_prefix(t->route_id, sizeof(t->route_id), prefix);
+        add_prefix(t->origin_id, sizeof(t->origin_id), prefix);
+        add_prefix(t->destination_id, sizeof(t->destination_id), prefix);
+        add_prefix(t->contains_id, sizeof(t->contains_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -239,14 +213,10 @@ static void gtfs_merge_shapes(struct vector_t* src_tbl, struct vector_t* merge_t
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct shape_t* s;
         struct shape_t* t;
         
-        s = (struct shape_t*)vect_get(src_tbl, i);
-        t = (struct shape_t*)malloc(sizeof(struct shape_t));
-        memcpy(t, s, sizeof(struct shape_t));
-        if (strlen(s->shape_id) > 0)
-            snprintf(t->shape_id, sizeof(t->shape_id), "%s%s", prefix, s->shape_id);
+        t = (struct shape_t*)vect_get(src_tbl, i);
+        add_prefix(t->shape_id, sizeof(t->shape_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -257,14 +227,10 @@ static void gtfs_merge_frequencies(struct vector_t* src_tbl, struct vector_t* me
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct frequency_t* s;
         struct frequency_t* t;
         
-        s = (struct frequency_t*)vect_get(src_tbl, i);
-        t = (struct frequency_t*)malloc(sizeof(struct frequency_t));
-        memcpy(t, s, sizeof(struct frequency_t));
-        if (strlen(s->trip_id) > 0)
-            snprintf(t->trip_id, sizeof(t->trip_id), "%s%s", prefix, s->trip_id);
+        t = (struct frequency_t*)vect_get(src_tbl, i);
+        add_prefix(t->trip_id, sizeof(t->trip_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -275,16 +241,11 @@ static void gtfs_merge_transfers(struct vector_t* src_tbl, struct vector_t* merg
     
     count = vect_count(src_tbl);
     for (i = 0; i < count; i++) {
-        struct transfer_t* s;
         struct transfer_t* t;
         
-        s = (struct transfer_t*)vect_get(src_tbl, i);
-        t = (struct transfer_t*)malloc(sizeof(struct transfer_t));
-        memcpy(t, s, sizeof(struct transfer_t));
-        if (strlen(s->from_stop_id) > 0)
-            snprintf(t->from_stop_id, sizeof(t->from_stop_id), "%s%s", prefix, s->from_stop_id);
-        if (strlen(s->to_stop_id) > 0)
-            snprintf(t->to_stop_id, sizeof(t->to_stop_id), "%s%s", prefix, s->to_stop_id);
+        t = (struct transfer_t*)vect_get(src_tbl, i);
+        add_prefix(t->from_stop_id, sizeof(t->from_stop_id), prefix);
+        add_prefix(t->to_stop_id, sizeof(t->to_stop_id), prefix);
         vect_append(merge_tbl, t);
     }
 }
@@ -301,13 +262,8 @@ static void gtfs_merge_translations(struct vector_t* src_tbl, struct vector_t* m
         s = (struct translation_t*)vect_get(src_tbl, i);
         snprintf(hkey, sizeof(hkey), "%s/%s", s->trans_id, s->lang);
         if (! hash_get(_mrg_translations_htbl, hkey)) {
-            struct translation_t* t;
-
             hash_put(_mrg_translations_htbl, hkey, s);
-
-            t = (struct translation_t*)malloc(sizeof(struct translation_t));
-            memcpy(t, s, sizeof(struct translation_t));
-            vect_append(merge_tbl, t);
+            vect_append(merge_tbl, s);
         }
     }
 }
@@ -448,6 +404,8 @@ static int gtfs_merge_one(struct merge_gtfs_prefix_t* m, int index)
         set_default_agency_jp();
     }
 
+    // マージしたレコードの領域はマージ先で解放します。
+    gtfs_move_rows(_mrg_gtfs, g_gtfs);
     gtfs_free(g_gtfs, 1);
     return 0;
 }
@@ -503,8 +461,8 @@ int gtfs_merge()
         err_write("agency_idが設定されていません。configファイルで設定してください。\n");
         return -1;
     }
-    agency = malloc(sizeof(struct agency_t));
-    agency_jp = malloc(sizeof(struct agency_jp_t));
+    agency = gtfs_row_alloc(_mrg_gtfs, AGENCY, sizeof(struct agency_t));
+    agency_jp = gtfs_row_alloc(_mrg_gtfs, AGENCY_JP, sizeof(struct agency_jp_t));
     memcpy(agency, &g_merged_agency, sizeof(struct agency_t));
     memcpy(agency_jp, &g_merged_agency_jp, sizeof(struct agency_jp_t));
     strcpy(agency_jp->agency_id, agency->agency_id);
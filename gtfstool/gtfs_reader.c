@@ -23,19 +23,37 @@
  * THE SOFTWARE.
  */
 #include <stdio.h>
+#include <stddef.h>
+#include <ctype.h>
 #include "base/common.h"
 #include "base/file.h"
 #include "base/csvfile.h"
+#include "base/csvreader.h"
 #include "gtfs_io.h"
 #include "gtfs_var.h"
 
 #define MINIZ_HEADER_FILE_ONLY
 #include "miniz.c"
 
-static void check_id_size(int kind, const char* id)
+static int find_field_index(struct csv_reader_t* csv, const char* target_label)
 {
-    if (strlen(id) > GTFS_ID_SIZE)
-        err_write("%s: [%s] size over.\n", g_gtfs_filename[kind], id);
+    int i;
+
+    for (i = 0; i < csv->count; i++) {
+        if (csv_field_icmp(&csv->fields[i], target_label) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void get_label(struct csv_reader_t* csv, char* label, int label_size)
+{
+    int n;
+
+    n = (csv->rec_len < label_size)? csv->rec_len : label_size - 1;
+    memcpy(label, csv->rec_ptr, n);
+    label[n] = '\0';
+    trim(label);
 }
 
 int find_label_index(char** label_list, const char* target_label)
@@ -54,1320 +72,849 @@ int find_label_index(char** label_list, const char* target_label)
     return -1;
 }
 
-static void gtfs_agency_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+/*
+ * 項目定義
+ *
+ * ファイルごとに項目名と格納先(構造体のオフセットとサイズ)を定義します。
+ * ラベル行から各項目の位置を求めて、定義に従ってレコードを格納します。
+ * 読み込む項目が指定されている場合(g_gtfs_columns)は、指定されていない項目を
+ * 格納せずに読み飛ばします。
+ */
+#define COL_STR     0x00    // 文字列
+#define COL_ID      0x01    // ID(GTFS_ID_SIZEを超える場合はエラー)
+#define COL_UPPER   0x02    // 英大文字に変換する文字列
+#define COL_ALIAS   0x04    // 直前の項目の別名(直前の項目が存在しない場合に使用)
+#define COL_SYM     0x08    // IDのシンボル(uint32)として格納
+
+#define MAX_COLUMNS 32
+
+struct gtfs_column_t {
+    const char* name;       // 項目名
+    int offset;             // 格納先のオフセット
+    int size;               // 格納先のサイズ
+    int type;               // 項目の種別
+};
+
+#define COLUMN(st, member, type) \
+    { #member, (int)offsetof(struct st, member), (int)sizeof(((struct st*)0)->member), type }
+#define COLUMN_ALIAS(st, name, member) \
+    { name, (int)offsetof(struct st, member), (int)sizeof(((struct st*)0)->member), COL_ALIAS }
+#define END_COLUMN \
+    { NULL, 0, 0, 0 }
+
+static const struct gtfs_column_t _agency_columns[] = {
+    COLUMN(agency_t, agency_id, COL_ID),
+    COLUMN(agency_t, agency_name, COL_STR),
+    COLUMN(agency_t, agency_url, COL_STR),
+    COLUMN(agency_t, agency_timezone, COL_STR),
+    COLUMN(agency_t, agency_lang, COL_STR),
+    COLUMN(agency_t, agency_phone, COL_STR),
+    COLUMN(agency_t, agency_fare_url, COL_STR),
+    COLUMN(agency_t, agency_email, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _agency_jp_columns[] = {
+    COLUMN(agency_jp_t, agency_id, COL_ID),
+    COLUMN(agency_jp_t, agency_official_name, COL_STR),
+    COLUMN(agency_jp_t, agency_zip_number, COL_STR),
+    COLUMN(agency_jp_t, agency_address, COL_STR),
+    COLUMN(agency_jp_t, agency_president_pos, COL_STR),
+    COLUMN(agency_jp_t, agency_president_name, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _stops_columns[] = {
+    COLUMN(stop_t, stop_id, COL_ID),
+    COLUMN(stop_t, stop_code, COL_STR),
+    COLUMN(stop_t, stop_name, COL_STR),
+    COLUMN(stop_t, stop_desc, COL_STR),
+    COLUMN(stop_t, stop_lat, COL_STR),
+    COLUMN(stop_t, stop_lon, COL_STR),
+    COLUMN(stop_t, zone_id, COL_STR),
+    COLUMN(stop_t, stop_url, COL_STR),
+    COLUMN(stop_t, location_type, COL_STR),
+    COLUMN(stop_t, parent_station, COL_STR),
+    COLUMN(stop_t, stop_timezone, COL_STR),
+    COLUMN(stop_t, wheelchair_boarding, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _routes_columns[] = {
+    COLUMN(route_t, route_id, COL_ID),
+    COLUMN(route_t, agency_id, COL_STR),
+    COLUMN(route_t, route_short_name, COL_STR),
+    COLUMN(route_t, route_long_name, COL_STR),
+    COLUMN(route_t, route_desc, COL_STR),
+    COLUMN(route_t, route_type, COL_STR),
+    COLUMN(route_t, route_url, COL_STR),
+    COLUMN(route_t, route_color, COL_UPPER),
+    COLUMN(route_t, route_text_color, COL_UPPER),
+    COLUMN(route_t, jp_parent_route_id, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _routes_jp_columns[] = {
+    COLUMN(route_jp_t, route_id, COL_ID),
+    COLUMN(route_jp_t, route_update_date, COL_STR),
+    COLUMN(route_jp_t, origin_stop, COL_STR),
+    COLUMN(route_jp_t, via_stop, COL_STR),
+    COLUMN(route_jp_t, destination_stop, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _trips_columns[] = {
+    COLUMN(trip_t, route_id, COL_ID),
+    COLUMN(trip_t, service_id, COL_STR),
+    COLUMN(trip_t, trip_id, COL_STR),
+    COLUMN(trip_t, trip_headsign, COL_STR),
+    COLUMN(trip_t, trip_short_name, COL_STR),
+    COLUMN(trip_t, direction_id, COL_STR),
+    COLUMN(trip_t, block_id, COL_STR),
+    COLUMN(trip_t, shape_id, COL_STR),
+    COLUMN(trip_t, wheelchair_accessible, COL_STR),
+    COLUMN(trip_t, bikes_allowed, COL_STR),
+    COLUMN(trip_t, jp_trip_desc, COL_STR),
+    COLUMN(trip_t, jp_trip_desc_symbol, COL_STR),
+    COLUMN(trip_t, jp_office_id, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _office_jp_columns[] = {
+    COLUMN(office_jp_t, office_id, COL_ID),
+    COLUMN(office_jp_t, office_name, COL_STR),
+    COLUMN(office_jp_t, office_url, COL_STR),
+    COLUMN(office_jp_t, office_phone, COL_STR),
+    END_COLUMN
+};
+
+// stop_times.txt の読み込み用のレコード(stop_time_t に変換して格納します)
+struct stop_time_row_t {
+    uint32 trip_id;                 // 便ID(シンボル)
+    char arrival_time[16];          // 到着時刻（HH:MM:SS）
+    char departure_time[16];        // 出発時刻（HH:MM:SS）
+    uint32 stop_id;                 // 駅コード(シンボル)
+    char stop_sequence[16];         // 連番
+    char stop_headsign[256];        // 停留所行き先
+    char pickup_type[8];            // 乗車区分（0:通常の乗車地）
+    char drop_off_type[8];          // 降車区分（0:通常の降車地）
+    char shape_dist_traveled[16];   // 通算距離（メートル）
+    char timepoint[64];             // 発着時間精度
+    int lineno;                     // 行番号
+};
+
+static const struct gtfs_column_t _stop_times_columns[] = {
+    COLUMN(stop_time_row_t, trip_id, COL_ID|COL_SYM),
+    COLUMN(stop_time_row_t, arrival_time, COL_STR),
+    COLUMN(stop_time_row_t, departure_time, COL_STR),
+    COLUMN(stop_time_row_t, stop_id, COL_SYM),
+    COLUMN(stop_time_row_t, stop_sequence, COL_STR),
+    COLUMN(stop_time_row_t, stop_headsign, COL_STR),
+    COLUMN(stop_time_row_t, pickup_type, COL_STR),
+    COLUMN(stop_time_row_t, drop_off_type, COL_STR),
+    COLUMN(stop_time_row_t, shape_dist_traveled, COL_STR),
+    COLUMN(stop_time_row_t, timepoint, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _calendar_columns[] = {
+    COLUMN(calendar_t, service_id, COL_ID),
+    COLUMN(calendar_t, monday, COL_STR),
+    COLUMN(calendar_t, tuesday, COL_STR),
+    COLUMN(calendar_t, wednesday, COL_STR),
+    COLUMN(calendar_t, thursday, COL_STR),
+    COLUMN(calendar_t, friday, COL_STR),
+    COLUMN(calendar_t, saturday, COL_STR),
+    COLUMN(calendar_t, sunday, COL_STR),
+    COLUMN(calendar_t, start_date, COL_STR),
+    COLUMN(calendar_t, end_date, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _calendar_dates_columns[] = {
+    COLUMN(calendar_date_t, service_id, COL_ID),
+    COLUMN(calendar_date_t, date, COL_STR),
+    COLUMN(calendar_date_t, exception_type, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _fare_attributes_columns[] = {
+    COLUMN(fare_attribute_t, fare_id, COL_ID),
+    COLUMN(fare_attribute_t, price, COL_STR),
+    COLUMN(fare_attribute_t, currency_type, COL_STR),
+    COLUMN(fare_attribute_t, payment_method, COL_STR),
+    COLUMN(fare_attribute_t, transfers, COL_STR),
+    COLUMN(fare_attribute_t, agency_id, COL_STR),
+    COLUMN(fare_attribute_t, transfer_duration, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _fare_rules_columns[] = {
+    COLUMN(fare_rule_t, fare_id, COL_ID),
+    COLUMN(fare_rule_t, route_id, COL_STR),
+    COLUMN(fare_rule_t, origin_id, COL_STR),
+    COLUMN(fare_rule_t, destination_id, COL_STR),
+    COLUMN(fare_rule_t, contains_id, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _shapes_columns[] = {
+    COLUMN(shape_t, shape_id, COL_ID),
+    COLUMN(shape_t, shape_pt_lat, COL_STR),
+    COLUMN(shape_t, shape_pt_lon, COL_STR),
+    COLUMN(shape_t, shape_pt_sequence, COL_STR),
+    COLUMN(shape_t, shape_dist_traveled, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _frequencies_columns[] = {
+    COLUMN(frequency_t, trip_id, COL_ID),
+    COLUMN(frequency_t, start_time, COL_STR),
+    COLUMN(frequency_t, end_time, COL_STR),
+    COLUMN(frequency_t, headway_secs, COL_STR),
+    COLUMN(frequency_t, exact_times, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _transfers_columns[] = {
+    COLUMN(transfer_t, from_stop_id, COL_ID),
+    COLUMN(transfer_t, to_stop_id, COL_ID),
+    COLUMN(transfer_t, transfer_type, COL_STR),
+    COLUMN(transfer_t, min_transfer_time, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _feed_info_columns[] = {
+    COLUMN(feed_info_t, feed_publisher_name, COL_STR),
+    COLUMN(feed_info_t, feed_publisher_url, COL_STR),
+    COLUMN(feed_info_t, feed_lang, COL_STR),
+    COLUMN(feed_info_t, feed_start_date, COL_STR),
+    COLUMN(feed_info_t, feed_end_date, COL_STR),
+    COLUMN(feed_info_t, feed_version, COL_STR),
+    END_COLUMN
+};
+
+static const struct gtfs_column_t _translations_columns[] = {
+    COLUMN(translation_t, trans_id, COL_STR),
+    COLUMN(translation_t, lang, COL_STR),
+    COLUMN_ALIAS(translation_t, "language", lang),  // gtfs new version(2020/08/19)
+    COLUMN(translation_t, translation, COL_STR),
+    // gtfs new version(2020/08/21)
+    COLUMN(translation_t, table_name, COL_STR),
+    COLUMN(translation_t, field_name, COL_STR),
+    COLUMN(translation_t, record_id, COL_STR),
+    COLUMN(translation_t, record_sub_id, COL_STR),
+    COLUMN(translation_t, field_value, COL_STR),
+    END_COLUMN
+};
+
+/*
+ * 読み込み時に検出した値の書式エラーを記録します。
+ * エラーはチェック時(gtfs_check)に行番号順に出力されます。
+ */
+static void value_error(struct gtfs_t* gtfs, int kind, int lineno, const char* column, const char* value)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int agency_id_index, agency_name_index, agency_url_index, agency_timezone_index;
-    int agency_lang_index, agency_phone_index, agency_fare_url_index, agency_email_index;
-    int lineno = 0;
-
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.agency, trim(tp), sizeof(g_gtfs_label.agency));
-    label_list = split(tp, COMMA_CHAR);
-
-    agency_id_index = find_label_index(label_list, "agency_id");
-    agency_name_index = find_label_index(label_list, "agency_name");
-    agency_url_index = find_label_index(label_list, "agency_url");
-    agency_timezone_index = find_label_index(label_list, "agency_timezone");
-    agency_lang_index = find_label_index(label_list, "agency_lang");
-    agency_phone_index = find_label_index(label_list, "agency_phone");
-    agency_fare_url_index = find_label_index(label_list, "agency_fare_url");
-    agency_email_index = find_label_index(label_list, "agency_email");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct agency_t* agency = calloc(1, sizeof(struct agency_t));
-
-                    if (agency_id_index >= 0 && agency_id_index < n) {
-                        char* p = quote(trim(list[agency_id_index]));
-                        check_id_size(AGENCY, p);
-                        strncpy(agency->agency_id, p, sizeof(agency->agency_id));
-                    }
-                    if (agency_name_index >= 0 && agency_name_index < n) {
-                        char* p = quote(trim(list[agency_name_index]));
-                        strncpy(agency->agency_name, p, sizeof(agency->agency_name));
-                    }
-                    if (agency_url_index >= 0 && agency_url_index < n) {
-                        char* p = quote(trim(list[agency_url_index]));
-                        strncpy(agency->agency_url, p, sizeof(agency->agency_url));
-                    }
-                    if (agency_timezone_index >= 0 && agency_timezone_index < n) {
-                        char* p = quote(trim(list[agency_timezone_index]));
-                        strncpy(agency->agency_timezone, p, sizeof(agency->agency_timezone));
-                    }
-                    if (agency_lang_index >= 0 && agency_lang_index < n) {
-                        char* p = quote(trim(list[agency_lang_index]));
-                        strncpy(agency->agency_lang, p, sizeof(agency->agency_lang));
-                    }
-                    if (agency_phone_index >= 0 && agency_phone_index < n) {
-                        char* p = quote(trim(list[agency_phone_index]));
-                        strncpy(agency->agency_phone, p, sizeof(agency->agency_phone));
-                    }
-                    if (agency_fare_url_index >= 0 && agency_fare_url_index < n) {
-                        char* p = quote(trim(list[agency_fare_url_index]));
-                        strncpy(agency->agency_fare_url, p, sizeof(agency->agency_fare_url));
-                    }
-                    if (agency_email_index >= 0 && agency_email_index < n) {
-                        char* p = quote(trim(list[agency_email_index]));
-                        strncpy(agency->agency_email, p, sizeof(agency->agency_email));
-                    }
-                    agency->lineno = lineno;
-                    vect_append(gtfs->agency_tbl, agency);
-                }
-                list_free(list);
-            }
-        }
-    }
-    list_free(label_list);
-    free(ptr);
+    struct gtfs_value_error_t* ve;
+
+    ve = (struct gtfs_value_error_t*)gtfs_row_alloc(gtfs, kind, sizeof(struct gtfs_value_error_t));
+    ve->kind = kind;
+    ve->lineno = lineno;
+    strncpy(ve->column, column, sizeof(ve->column)-1);
+    strncpy(ve->value, value, sizeof(ve->value)-1);
+    vect_append(gtfs->value_errors, ve);
 }
 
-static void gtfs_agency_jp_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+/*
+ * 実数の文字列を変換します。
+ *
+ * 戻り値
+ *  すべて変換でき、min から max の範囲の場合は 1 を返します。
+ *  それ以外はゼロを返します。
+ */
+static int parse_double(const char* str, double min, double max, double* value)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int agency_id_index, agency_official_name_index, agency_zip_number_index, agency_address_index;
-    int agency_president_pos_index, agency_president_name_index;
-    int lineno = 0;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.agency_jp, trim(tp), sizeof(g_gtfs_label.agency_jp));
-    label_list = split(tp, COMMA_CHAR);
-    
-    agency_id_index = find_label_index(label_list, "agency_id");
-    agency_official_name_index = find_label_index(label_list, "agency_official_name");
-    agency_zip_number_index = find_label_index(label_list, "agency_zip_number");
-    agency_address_index = find_label_index(label_list, "agency_address");
-    agency_president_pos_index = find_label_index(label_list, "agency_president_pos");
-    agency_president_name_index = find_label_index(label_list, "agency_president_name");
-    
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct agency_jp_t* agency_jp = calloc(1, sizeof(struct agency_jp_t));
-                    
-                    if (agency_id_index >= 0 && agency_id_index < n) {
-                        char* p = quote(trim(list[agency_id_index]));
-                        check_id_size(AGENCY_JP, p);
-                        strncpy(agency_jp->agency_id, p, sizeof(agency_jp->agency_id));
-                    }
-                    if (agency_official_name_index >= 0 && agency_official_name_index < n) {
-                        char* p = quote(trim(list[agency_official_name_index]));
-                        strncpy(agency_jp->agency_official_name, p, sizeof(agency_jp->agency_official_name));
-                    }
-                    if (agency_zip_number_index >= 0 && agency_zip_number_index < n) {
-                        char* p = quote(trim(list[agency_zip_number_index]));
-                        strncpy(agency_jp->agency_zip_number, p, sizeof(agency_jp->agency_zip_number));
-                    }
-                    if (agency_address_index >= 0 && agency_address_index < n) {
-                        char* p = quote(trim(list[agency_address_index]));
-                        strncpy(agency_jp->agency_address, p, sizeof(agency_jp->agency_address));
-                    }
-                    if (agency_president_pos_index >= 0 && agency_president_pos_index < n) {
-                        char* p = quote(trim(list[agency_president_pos_index]));
-                        strncpy(agency_jp->agency_president_pos, p, sizeof(agency_jp->agency_president_pos));
-                    }
-                    if (agency_president_name_index >= 0 && agency_president_name_index < n) {
-                        char* p = quote(trim(list[agency_president_name_index]));
-                        strncpy(agency_jp->agency_president_name, p, sizeof(agency_jp->agency_president_name));
-                    }
-                    agency_jp->lineno = lineno;
-                    vect_append(gtfs->agency_jp_tbl, agency_jp);
-                }
-                list_free(list);
-            }
-        }
-    }
-    list_free(label_list);
-    free(ptr);
+    char* endp;
+
+    *value = strtod(str, &endp);
+    return (endp != str && *endp == '\0' && *value >= min && *value <= max);
 }
 
-static void gtfs_stops_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+static void stops_fixup(void* rec, struct gtfs_t* gtfs)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int stop_id_index, stop_code_index, stop_name_index, stop_desc_index;
-    int stop_lat_index, stop_lon_index, zone_id_index;
-    int stop_url_index, location_type_index, parent_station_index;
-    int stop_timezone_index, wheelchair_boarding_index;
-    int lineno = 0;
-
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.stops, trim(tp), sizeof(g_gtfs_label.stops));
-    label_list = split(tp, COMMA_CHAR);
-    
-    stop_id_index = find_label_index(label_list, "stop_id");
-    stop_code_index = find_label_index(label_list, "stop_code");
-    stop_name_index = find_label_index(label_list, "stop_name");
-    stop_desc_index = find_label_index(label_list, "stop_desc");
-    stop_lat_index = find_label_index(label_list, "stop_lat");
-    stop_lon_index = find_label_index(label_list, "stop_lon");
-    zone_id_index = find_label_index(label_list, "zone_id");
-    stop_url_index = find_label_index(label_list, "stop_url");
-    location_type_index = find_label_index(label_list, "location_type");
-    parent_station_index = find_label_index(label_list, "parent_station");
-    stop_timezone_index = find_label_index(label_list, "stop_timezone");
-    wheelchair_boarding_index = find_label_index(label_list, "wheelchair_boarding");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct stop_t* stop = calloc(1, sizeof(struct stop_t));
-
-                    if (stop_id_index >= 0 && stop_id_index < n) {
-                        char* p = quote(trim(list[stop_id_index]));
-                        check_id_size(STOPS, p);
-                        strncpy(stop->stop_id, p, sizeof(stop->stop_id));
-                    }
-                    if (stop_code_index >= 0 && stop_code_index < n) {
-                        char* p = quote(trim(list[stop_code_index]));
-                        strncpy(stop->stop_code, p, sizeof(stop->stop_code));
-                    }
-                    if (stop_name_index >= 0 && stop_name_index < n) {
-                        char* p = quote(trim(list[stop_name_index]));
-                        strncpy(stop->stop_name, p, sizeof(stop->stop_name));
-                    }
-                    if (stop_desc_index >= 0 && stop_desc_index < n) {
-                        char* p = quote(trim(list[stop_desc_index]));
-                        strncpy(stop->stop_desc, p, sizeof(stop->stop_desc));
-                    }
-                    if (stop_lat_index >= 0 && stop_lat_index < n) {
-                        char* p = quote(trim(list[stop_lat_index]));
-                        strncpy(stop->stop_lat, p, sizeof(stop->stop_lat));
-                    }
-                    if (stop_lon_index >= 0 && stop_lon_index < n) {
-                        char* p = quote(trim(list[stop_lon_index]));
-                        strncpy(stop->stop_lon, p, sizeof(stop->stop_lon));
-                    }
-                    if (zone_id_index >= 0 && zone_id_index < n) {
-                        char* p = quote(trim(list[zone_id_index]));
-                        strncpy(stop->zone_id, p, sizeof(stop->zone_id));
-                    }
-                    if (stop_url_index >= 0 && stop_url_index < n) {
-                        char* p = quote(trim(list[stop_url_index]));
-                        strncpy(stop->stop_url, p, sizeof(stop->stop_url));
-                    }
-                    if (location_type_index >= 0 && location_type_index < n) {
-                        char* p = quote(trim(list[location_type_index]));
-                        strncpy(stop->location_type, p, sizeof(stop->location_type));
-                    }
-                    if (parent_station_index >= 0 && parent_station_index < n) {
-                        char* p = quote(trim(list[parent_station_index]));
-                        strncpy(stop->parent_station, p, sizeof(stop->parent_station));
-                    }
-                    if (stop_timezone_index >= 0 && stop_timezone_index < n) {
-                        char* p = quote(trim(list[stop_timezone_index]));
-                        strncpy(stop->stop_timezone, p, sizeof(stop->stop_timezone));
-                    }
-                    if (wheelchair_boarding_index >= 0 && wheelchair_boarding_index < n) {
-                        char* p = quote(trim(list[wheelchair_boarding_index]));
-                        strncpy(stop->wheelchair_boarding, p, sizeof(stop->wheelchair_boarding));
-                    }
-                    stop->lineno = lineno;
-                    vect_append(gtfs->stops_tbl, stop);
-                }
-                list_free(list);
-            }
-        }
-    }
-    list_free(label_list);
-    free(ptr);
+    struct stop_t* stop = (struct stop_t*)rec;
+
+    if (*stop->stop_lat && ! parse_double(stop->stop_lat, -90.0, 90.0, &stop->stop_lat_value))
+        value_error(gtfs, STOPS, stop->lineno, "stop_lat", stop->stop_lat);
+    if (*stop->stop_lon && ! parse_double(stop->stop_lon, -180.0, 180.0, &stop->stop_lon_value))
+        value_error(gtfs, STOPS, stop->lineno, "stop_lon", stop->stop_lon);
+    stop->location_type_value = atoi(stop->location_type);
+    if (*stop->location_type && ! (isdigitstr(stop->location_type) && stop->location_type_value <= 4))
+        value_error(gtfs, STOPS, stop->lineno, "location_type", stop->location_type);
 }
 
-static void gtfs_routes_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+static void fare_attributes_fixup(void* rec, struct gtfs_t* gtfs)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int route_id_index, agency_id_index;
-    int route_short_name_index, route_long_name_index, route_desc_index;
-    int route_type_index, route_url_index, route_color_index, route_text_color_index;
-    int jp_parent_route_id_index;
-    int lineno = 0;
-
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.routes, trim(tp), sizeof(g_gtfs_label.routes));
-    label_list = split(tp, COMMA_CHAR);
-
-    route_id_index = find_label_index(label_list, "route_id");
-    agency_id_index = find_label_index(label_list, "agency_id");
-    route_short_name_index = find_label_index(label_list, "route_short_name");
-    route_long_name_index = find_label_index(label_list, "route_long_name");
-    route_desc_index = find_label_index(label_list, "route_desc");
-    route_type_index = find_label_index(label_list, "route_type");
-    route_url_index = find_label_index(label_list, "route_url");
-    route_color_index = find_label_index(label_list, "route_color");
-    route_text_color_index = find_label_index(label_list, "route_text_color");
-    jp_parent_route_id_index = find_label_index(label_list, "jp_parent_route_id");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct route_t* route = calloc(1, sizeof(struct route_t));
-
-                    if (route_id_index >= 0 && route_id_index < n) {
-                        char* p = quote(trim(list[route_id_index]));
-                        check_id_size(ROUTES, p);
-                        strncpy(route->route_id, p, sizeof(route->route_id));
-                    }
-                    if (agency_id_index >= 0 && agency_id_index < n) {
-                        char* p = quote(trim(list[agency_id_index]));
-                        strncpy(route->agency_id, p, sizeof(route->agency_id));
-                    }
-                    if (route_short_name_index >= 0 && route_short_name_index < n) {
-                        char* p = quote(trim(list[route_short_name_index]));
-                        strncpy(route->route_short_name, p, sizeof(route->route_short_name));
-                    }
-                    if (route_long_name_index >= 0 && route_long_name_index < n) {
-                        char* p = quote(trim(list[route_long_name_index]));
-                        strncpy(route->route_long_name, p, sizeof(route->route_long_name));
-                    }
-                    if (route_desc_index >= 0 && route_desc_index < n) {
-                        char* p = quote(trim(list[route_desc_index]));
-                        strncpy(route->route_desc, p, sizeof(route->route_desc));
-                    }
-                    if (route_type_index >= 0 && route_type_index < n) {
-                        char* p = quote(trim(list[route_type_index]));
-                        strncpy(route->route_type, p, sizeof(route->route_type));
-                    }
-                    if (route_url_index >= 0 && route_url_index < n) {
-                        char* p = quote(trim(list[route_url_index]));
-                        strncpy(route->route_url, p, sizeof(route->route_url));
-                    }
-                    if (route_color_index >= 0 && route_color_index < n) {
-                        char* p = quote(trim(list[route_color_index]));
-                        toupperstr(p);
-                        strncpy(route->route_color, p, sizeof(route->route_color));
-                    }
-                    if (route_text_color_index >= 0 && route_text_color_index < n) {
-                        char* p = quote(trim(list[route_text_color_index]));
-                        toupperstr(p);
-                        strncpy(route->route_text_color, p, sizeof(route->route_text_color));
-                    }
-                    if (jp_parent_route_id_index >= 0 && jp_parent_route_id_index < n) {
-                        char* p = quote(trim(list[jp_parent_route_id_index]));
-                        strncpy(route->jp_parent_route_id, p, sizeof(route->jp_parent_route_id));
-                    }
-                    route->lineno = lineno;
-                    vect_append(gtfs->routes_tbl, route);
-                }
-                list_free(list);
-            }
-        }
-    }
-    list_free(label_list);
-    free(ptr);
+    struct fare_attribute_t* fattr = (struct fare_attribute_t*)rec;
+    double price;
+
+    fattr->price_value = atoi(fattr->price);
+    if (*fattr->price && ! parse_double(fattr->price, 0.0, 1e9, &price))
+        value_error(gtfs, FARE_ATTRIBUTES, fattr->lineno, "price", fattr->price);
 }
 
-static void gtfs_routes_jp_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+static int table_type(const char* table_name)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int route_id_index, route_update_index;
-    int origin_stop_index, via_stop_index, destination_stop_index;
-    int lineno = 0;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.routes_jp, trim(tp), sizeof(g_gtfs_label.routes_jp));
-    label_list = split(tp, COMMA_CHAR);
-    
-    route_id_index = find_label_index(label_list, "route_id");
-    route_update_index = find_label_index(label_list, "route_update_date");
-    origin_stop_index = find_label_index(label_list, "origin_stop");
-    via_stop_index = find_label_index(label_list, "via_stop");
-    destination_stop_index = find_label_index(label_list, "destination_stop");
-    
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct route_jp_t* routejp = calloc(1, sizeof(struct route_jp_t));
-                    
-                    if (route_id_index >= 0 && route_id_index < n) {
-                        char* p = quote(trim(list[route_id_index]));
-                        check_id_size(ROUTES_JP, p);
-                        strncpy(routejp->route_id, p, sizeof(routejp->route_id));
-                    }
-                    if (route_update_index >= 0 && route_update_index < n) {
-                        char* p = quote(trim(list[route_update_index]));
-                        strncpy(routejp->route_update_date, p, sizeof(routejp->route_update_date));
-                    }
-                    if (origin_stop_index >= 0 && origin_stop_index < n) {
-                        char* p = quote(trim(list[origin_stop_index]));
-                        strncpy(routejp->origin_stop, p, sizeof(routejp->origin_stop));
-                    }
-                    if (via_stop_index >= 0 && via_stop_index < n) {
-                        char* p = quote(trim(list[via_stop_index]));
-                        strncpy(routejp->via_stop, p, sizeof(routejp->via_stop));
-                    }
-                    if (destination_stop_index >= 0 && destination_stop_index < n) {
-                        char* p = quote(trim(list[destination_stop_index]));
-                        strncpy(routejp->destination_stop, p, sizeof(routejp->destination_stop));
-                    }
-                    routejp->lineno = lineno;
-                    vect_append(gtfs->routes_jp_tbl, routejp);
-                }
-                list_free(list);
-            }
-        }
-    }
-    list_free(label_list);
-    free(ptr);
+    if (strcmp(table_name, "stops") == 0)
+        return STOPS;
+    return -1;
 }
 
-static void gtfs_trips_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+static void translations_fixup(void* rec, struct gtfs_t* gtfs)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int route_id_index, service_id_index, trip_id_index;
-    int trip_headsign_index, trip_short_name_index, direction_id_index;
-    int block_id_index, shape_id_index, wheelchair_accessible_index, bikes_allowed_index;
-    int jp_trip_desc_index, jp_trip_desc_symbol_index, jp_office_id_index;
-    int lineno = 0;
-
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.trips, trim(tp), sizeof(g_gtfs_label.trips));
-    label_list = split(tp, COMMA_CHAR);
-
-    route_id_index = find_label_index(label_list, "route_id");
-    service_id_index = find_label_index(label_list, "service_id");
-    trip_id_index = find_label_index(label_list, "trip_id");
-    trip_headsign_index = find_label_index(label_list, "trip_headsign");
-    trip_short_name_index = find_label_index(label_list, "trip_short_name");
-    direction_id_index = find_label_index(label_list, "direction_id");
-    block_id_index = find_label_index(label_list, "block_id");
-    shape_id_index = find_label_index(label_list, "shape_id");
-    wheelchair_accessible_index = find_label_index(label_list, "wheelchair_accessible");
-    bikes_allowed_index = find_label_index(label_list, "bikes_allowed");
-    jp_trip_desc_index = find_label_index(label_list, "jp_trip_desc");
-    jp_trip_desc_symbol_index = find_label_index(label_list, "jp_trip_desc_symbol");
-    jp_office_id_index = find_label_index(label_list, "jp_office_id");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct trip_t* trip = calloc(1, sizeof(struct trip_t));
-
-                    if (route_id_index >= 0 && route_id_index < n) {
-                        char* p = quote(trim(list[route_id_index]));
-                        check_id_size(TRIPS, p);
-                        strncpy(trip->route_id, p, sizeof(trip->route_id));
-                    }
-                    if (service_id_index >= 0 && service_id_index < n) {
-                        char* p = quote(trim(list[service_id_index]));
-                        strncpy(trip->service_id, p, sizeof(trip->service_id));
-                    }
-                    if (trip_id_index >= 0 && trip_id_index < n) {
-                        char* p = quote(trim(list[trip_id_index]));
-                        strncpy(trip->trip_id, p, sizeof(trip->trip_id));
-                    }
-                    if (trip_headsign_index >= 0 && trip_headsign_index < n) {
-                        char* p = quote(trim(list[trip_headsign_index]));
-                        strncpy(trip->trip_headsign, p, sizeof(trip->trip_headsign));
-                    }
-                    if (trip_short_name_index >= 0 && trip_short_name_index < n) {
-                        char* p = quote(trim(list[trip_short_name_index]));
-                        strncpy(trip->trip_short_name, p, sizeof(trip->trip_short_name));
-                    }
-                    if (direction_id_index >= 0 && direction_id_index < n) {
-                        char* p = quote(trim(list[direction_id_index]));
-                        strncpy(trip->direction_id, p, sizeof(trip->direction_id));
-                    }
-                    if (block_id_index >= 0 && block_id_index < n) {
-                        char* p = quote(trim(list[block_id_index]));
-                        strncpy(trip->block_id, p, sizeof(trip->block_id));
-                    }
-                    if (shape_id_index >= 0 && shape_id_index < n) {
-                        char* p = quote(trim(list[shape_id_index]));
-                        strncpy(trip->shape_id, p, sizeof(trip->shape_id));
-                    }
-                    if (wheelchair_accessible_index >= 0 && wheelchair_accessible_index < n) {
-                        char* p = quote(trim(list[wheelchair_accessible_index]));
-                        strncpy(trip->wheelchair_accessible, p, sizeof(trip->wheelchair_accessible));
-                    }
-                    if (bikes_allowed_index >= 0 && bikes_allowed_index < n) {
-                        char* p = quote(trim(list[bikes_allowed_index]));
-                        strncpy(trip->bikes_allowed, p, sizeof(trip->bikes_allowed));
-                    }
-                    if (jp_trip_desc_index >= 0 && jp_trip_desc_index < n) {
-                        char* p = quote(trim(list[jp_trip_desc_index]));
-                        strncpy(trip->jp_trip_desc, p, sizeof(trip->jp_trip_desc));
-                    }
-                    if (jp_trip_desc_symbol_index >= 0 && jp_trip_desc_symbol_index < n) {
-                        char* p = quote(trim(list[jp_trip_desc_symbol_index]));
-                        strncpy(trip->jp_trip_desc_symbol, p, sizeof(trip->jp_trip_desc_symbol));
-                    }
-                    if (jp_office_id_index >= 0 && jp_office_id_index < n) {
-                        char* p = quote(trim(list[jp_office_id_index]));
-                        strncpy(trip->jp_office_id, p, sizeof(trip->jp_office_id));
-                    }
-                    trip->lineno = lineno;
-                    vect_append(gtfs->trips_tbl, trip);
-                }
-                list_free(list);
-            }
-        }
-    }
-    list_free(label_list);
-    free(ptr);
+    struct translation_t* trans = (struct translation_t*)rec;
+
+    (void)gtfs;     // 未使用
+    // gtfs new version(2020/08/21)
+    // stops以外は無視します
+    trans->table_type = table_type(trans->table_name);
 }
 
-static void gtfs_office_jp_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+/*
+ * 時刻(H:MM:SS)を0時からの秒数に変換します。
+ * 区切りの':'が連続する場合は一つの区切りとして扱います。
+ */
+static int time_to_seconds(const char* time)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int office_id_index, office_name_index, office_url_index, office_phone_index;
-    int lineno = 0;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.office_jp, trim(tp), sizeof(g_gtfs_label.office_jp));
-    label_list = split(tp, COMMA_CHAR);
-    
-    office_id_index = find_label_index(label_list, "office_id");
-    office_name_index = find_label_index(label_list, "office_name");
-    office_url_index = find_label_index(label_list, "office_url");
-    office_phone_index = find_label_index(label_list, "office_phone");
-    
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct office_jp_t* officejp = calloc(1, sizeof(struct office_jp_t));
-                    
-                    if (office_id_index >= 0 && office_id_index < n) {
-                        char* p = quote(trim(list[office_id_index]));
-                        check_id_size(OFFICE_JP, p);
-                        strncpy(officejp->office_id, p, sizeof(officejp->office_id));
-                    }
-                    if (office_name_index >= 0 && office_name_index < n) {
-                        char* p = quote(trim(list[office_name_index]));
-                        strncpy(officejp->office_name, p, sizeof(officejp->office_name));
-                    }
-                    if (office_url_index >= 0 && office_url_index < n) {
-                        char* p = quote(trim(list[office_url_index]));
-                        strncpy(officejp->office_url, p, sizeof(officejp->office_url));
-                    }
-                    if (office_phone_index >= 0 && office_phone_index < n) {
-                        char* p = quote(trim(list[office_phone_index]));
-                        strncpy(officejp->office_phone, p, sizeof(officejp->office_phone));
-                    }
-                    officejp->lineno = lineno;
-                    vect_append(gtfs->office_jp_tbl, officejp);
-                }
-                list_free(list);
-            }
-        }
+    static const int unit[] = { 3600, 60, 1 };
+    const char* p = time;
+    int seconds = 0;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        while (*p == ':')
+            p++;
+        if (*p == '\0')
+            break;
+        seconds += atoi(p) * unit[i];
+        while (*p && *p != ':')
+            p++;
     }
-    list_free(label_list);
-    free(ptr);
+    return seconds;
 }
 
-static void gtfs_stop_times_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+#define IS_DIGIT(c)     isdigit((unsigned char)(c))
+#define IS_MIN_SEC(p)   ((p)[0] >= '0' && (p)[0] <= '5' && IS_DIGIT((p)[1]))
+
+/*
+ * 時刻の文字列の形式を判定します。
+ *
+ * 戻り値
+ *  HH:MM:SS の場合は 1 を返します。
+ *  時が1桁(H:MM:SS)の場合は 2 を返します。
+ *  時刻として正しいが秒数から同じ文字列に戻せない場合は 3 を返します。
+ *  時刻として正しくない場合はゼロを返します。
+ */
+static int time_format(const char* time)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int trip_id_index, arrival_time_index, departure_time_index;
-    int stop_id_index, stop_sequence_index, stop_headsign_index;
-    int pickup_type_index, drop_off_type_index;
-    int shape_dist_traveled_index, timepoint_index;
-    int lineno = 0;
-
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.stop_times, trim(tp), sizeof(g_gtfs_label.stop_times));
-    label_list = split(tp, COMMA_CHAR);
-    
-    trip_id_index = find_label_index(label_list, "trip_id");
-    arrival_time_index = find_label_index(label_list, "arrival_time");
-    departure_time_index = find_label_index(label_list, "departure_time");
-    stop_id_index = find_label_index(label_list, "stop_id");
-    stop_sequence_index = find_label_index(label_list, "stop_sequence");
-    stop_headsign_index = find_label_index(label_list, "stop_headsign");
-    pickup_type_index = find_label_index(label_list, "pickup_type");
-    drop_off_type_index = find_label_index(label_list, "drop_off_type");
-    shape_dist_traveled_index = find_label_index(label_list, "shape_dist_traveled");
-    timepoint_index = find_label_index(label_list, "timepoint");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct stop_time_t* st = calloc(1, sizeof(struct stop_time_t));
-                    
-                    if (trip_id_index >= 0 && trip_id_index < n) {
-                        char* p = quote(trim(list[trip_id_index]));
-                        check_id_size(STOP_TIMES, p);
-                        strncpy(st->trip_id, p, sizeof(st->trip_id));
-                    }
-                    if (arrival_time_index >= 0 && arrival_time_index < n) {
-                        char* p = quote(trim(list[arrival_time_index]));
-                        strncpy(st->arrival_time, p, sizeof(st->arrival_time));
-                    }
-                    if (departure_time_index >= 0 && departure_time_index < n) {
-                        char* p = quote(trim(list[departure_time_index]));
-                        strncpy(st->departure_time, p, sizeof(st->departure_time));
-                    }
-                    if (stop_id_index >= 0 && stop_id_index < n) {
-                        char* p = quote(trim(list[stop_id_index]));
-                        strncpy(st->stop_id, p, sizeof(st->stop_id));
-                    }
-                    if (stop_sequence_index >= 0 && stop_sequence_index < n) {
-                        char* p = quote(trim(list[stop_sequence_index]));
-                        strncpy(st->stop_sequence, p, sizeof(st->stop_sequence));
-                    }
-                    if (stop_headsign_index >= 0 && stop_headsign_index < n) {
-                        char* p = quote(trim(list[stop_headsign_index]));
-                        strncpy(st->stop_headsign, p, sizeof(st->stop_headsign));
-                    }
-                    if (pickup_type_index >= 0 && pickup_type_index < n) {
-                        char* p = quote(trim(list[pickup_type_index]));
-                        strncpy(st->pickup_type, p, sizeof(st->pickup_type));
-                    }
-                    if (drop_off_type_index >= 0 && drop_off_type_index < n) {
-                        char* p = quote(trim(list[drop_off_type_index]));
-                        strncpy(st->drop_off_type, p, sizeof(st->drop_off_type));
-                    }
-                    if (shape_dist_traveled_index >= 0 && shape_dist_traveled_index < n) {
-                        char* p = quote(trim(list[shape_dist_traveled_index]));
-                        strncpy(st->shape_dist_traveled, p, sizeof(st->shape_dist_traveled));
-                    }
-                    if (timepoint_index >= 0 && timepoint_index < n) {
-                        char* p = quote(trim(list[timepoint_index]));
-                        strncpy(st->timepoint, p, sizeof(st->timepoint));
-                    }
-                    st->lineno = lineno;
-                    vect_append(gtfs->stop_times_tbl, st);
-                }
-                list_free(list);
-            }
-        }
+    const char* p = time;
+    int n = 0;
+
+    while (IS_DIGIT(*p)) {
+        p++;
+        n++;
     }
-    list_free(label_list);
-    free(ptr);
+    if (n < 1 || n > 5)
+        return 0;
+    if (p[0] != ':' || ! IS_MIN_SEC(p+1) || p[3] != ':' || ! IS_MIN_SEC(p+4) || p[6] != '\0')
+        return 0;
+    if (n > 2 && *time == '0')
+        return 3;
+    return (n == 1)? 2 : 1;
 }
 
-static void gtfs_calendar_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+/*
+ * 文字列が数値から同じ文字列に戻せる整数(9桁まで)かを判定します。
+ */
+static int is_plain_int(const char* str)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int service_id_index, monday_index, tuesday_index, wednesday_index;
-    int thursday_index, friday_index, saturday_index, sunday_index;
-    int start_date_index, end_date_index;
-    int lineno = 0;
-
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.calendar, trim(tp), sizeof(g_gtfs_label.calendar));
-    label_list = split(tp, COMMA_CHAR);
-
-    service_id_index = find_label_index(label_list, "service_id");
-    monday_index = find_label_index(label_list, "monday");
-    tuesday_index = find_label_index(label_list, "tuesday");
-    wednesday_index = find_label_index(label_list, "wednesday");
-    thursday_index = find_label_index(label_list, "thursday");
-    friday_index = find_label_index(label_list, "friday");
-    saturday_index = find_label_index(label_list, "saturday");
-    sunday_index = find_label_index(label_list, "sunday");
-    start_date_index = find_label_index(label_list, "start_date");
-    end_date_index = find_label_index(label_list, "end_date");
-    
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct calendar_t* cal = calloc(1, sizeof(struct calendar_t));
-
-                    if (service_id_index >= 0 && service_id_index < n) {
-                        char* p = quote(trim(list[service_id_index]));
-                        check_id_size(CALENDAR, p);
-                        strncpy(cal->service_id, p, sizeof(cal->service_id));
-                    }
-                    if (monday_index >= 0 && monday_index < n) {
-                        char* p = quote(trim(list[monday_index]));
-                        strncpy(cal->monday, p, sizeof(cal->monday));
-                    }
-                    if (tuesday_index >= 0 && tuesday_index < n) {
-                        char* p = quote(trim(list[tuesday_index]));
-                        strncpy(cal->tuesday, p, sizeof(cal->tuesday));
-                    }
-                    if (wednesday_index >= 0 && wednesday_index < n) {
-                        char* p = quote(trim(list[wednesday_index]));
-                        strncpy(cal->wednesday, p, sizeof(cal->wednesday));
-                    }
-                    if (thursday_index >= 0 && thursday_index < n) {
-                        char* p = quote(trim(list[thursday_index]));
-                        strncpy(cal->thursday, p, sizeof(cal->thursday));
-                    }
-                    if (friday_index >= 0 && friday_index < n) {
-                        char* p = quote(trim(list[friday_index]));
-                        strncpy(cal->friday, p, sizeof(cal->friday));
-                    }
-                    if (saturday_index >= 0 && saturday_index < n) {
-                        char* p = quote(trim(list[saturday_index]));
-                        strncpy(cal->saturday, p, sizeof(cal->saturday));
-                    }
-                    if (sunday_index >= 0 && sunday_index < n) {
-                        char* p = quote(trim(list[sunday_index]));
-                        strncpy(cal->sunday, p, sizeof(cal->sunday));
-                    }
-                    if (start_date_index >= 0 && start_date_index < n) {
-                        char* p = quote(trim(list[start_date_index]));
-                        strncpy(cal->start_date, p, sizeof(cal->start_date));
-                    }
-                    if (end_date_index >= 0 && end_date_index < n) {
-                        char* p = quote(trim(list[end_date_index]));
-                        strncpy(cal->end_date, p, sizeof(cal->end_date));
-                    }
-                    cal->lineno = lineno;
-                    vect_append(gtfs->calendar_tbl, cal);
-                }
-                list_free(list);
-            }
-        }
+    const char* p = str;
+    int n = 0;
+
+    if (*p == '-')
+        p++;
+    if (*p == '0')
+        return (p == str && p[1] == '\0');
+    while (IS_DIGIT(*p)) {
+        p++;
+        n++;
     }
-    list_free(label_list);
-    free(ptr);
+    return (n > 0 && n < 10 && *p == '\0');
 }
 
-static void gtfs_calendar_dates_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+static const char* _stop_times_column_name[ST_EXT_COUNT] = {
+    "stop_headsign", "shape_dist_traveled", "timepoint", "arrival_time",
+    "departure_time", "stop_sequence", "pickup_type", "drop_off_type"
+};
+
+static int pack_time(struct stop_time_t* st, int column, const char* time, int short_flag,
+                     const char** ext, struct gtfs_t* gtfs)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int service_id_index, date_index, exception_type_index;
-    int lineno = 0;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.calendar_dates, trim(tp), sizeof(g_gtfs_label.calendar_dates));
-    label_list = split(tp, COMMA_CHAR);
-    
-    service_id_index = find_label_index(label_list, "service_id");
-    date_index = find_label_index(label_list, "date");
-    exception_type_index = find_label_index(label_list, "exception_type");
-    
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct calendar_date_t* cald = calloc(1, sizeof(struct calendar_date_t));
-                    
-                    if (service_id_index >= 0 && service_id_index < n) {
-                        char* p = quote(trim(list[service_id_index]));
-                        check_id_size(CALENDAR_DATES, p);
-                        strncpy(cald->service_id, p, sizeof(cald->service_id));
-                    }
-                    if (date_index >= 0 && date_index < n) {
-                        char* p = quote(trim(list[date_index]));
-                        strncpy(cald->date, p, sizeof(cald->date));
-                    }
-                    if (exception_type_index >= 0 && exception_type_index < n) {
-                        char* p = quote(trim(list[exception_type_index]));
-                        strncpy(cald->exception_type, p, sizeof(cald->exception_type));
-                    }
-                    cald->lineno = lineno;
-                    vect_append(gtfs->calendar_dates_tbl, cald);
-                }
-                list_free(list);
-            }
-        }
+    if (*time == '\0')
+        return 0;
+    st->flags |= ST_HAS(column);
+    switch (time_format(time)) {
+        case 1:
+            break;
+        case 2:
+            st->flags |= short_flag;
+            break;
+        case 0:
+            value_error(gtfs, STOP_TIMES, st->lineno, _stop_times_column_name[column], time);
+            // FALLTHROUGH
+        default:
+            st->flags |= ST_RAW(column);
+            ext[column] = time;
+            break;
     }
-    list_free(label_list);
-    free(ptr);
+    return time_to_seconds(time);
 }
 
-static void gtfs_fare_attributes_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+/*
+ * 整数の項目を変換します。
+ * 負の値、または valid_max を超える値(valid_max がゼロ以外の場合)は書式エラーとして記録します。
+ */
+static int pack_int(struct stop_time_t* st, int column, const char* str, int max_value, int valid_max,
+                    const char** ext, struct gtfs_t* gtfs)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int fare_id_index, price_index, currency_type_index, payment_method_index, transfers_index;
-    int agency_id_index, transfer_duration_index;
-    int lineno = 0;
-
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.fare_attributes, trim(tp), sizeof(g_gtfs_label.fare_attributes));
-    label_list = split(tp, COMMA_CHAR);
-    
-    fare_id_index = find_label_index(label_list, "fare_id");
-    price_index = find_label_index(label_list, "price");
-    currency_type_index = find_label_index(label_list, "currency_type");
-    payment_method_index = find_label_index(label_list, "payment_method");
-    transfers_index = find_label_index(label_list, "transfers");
-    agency_id_index = find_label_index(label_list, "agency_id");
-    transfer_duration_index = find_label_index(label_list, "transfer_duration");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct fare_attribute_t* fattr = calloc(1, sizeof(struct fare_attribute_t));
-                    
-                    if (fare_id_index >= 0 && fare_id_index < n) {
-                        char* p = quote(trim(list[fare_id_index]));
-                        check_id_size(FARE_ATTRIBUTES, p);
-                        strncpy(fattr->fare_id, p, sizeof(fattr->fare_id));
-                    }
-                    if (price_index >= 0 && price_index < n) {
-                        char* p = quote(trim(list[price_index]));
-                        strncpy(fattr->price, p, sizeof(fattr->price));
-                    }
-                    if (currency_type_index >= 0 && currency_type_index < n) {
-                        char* p = quote(trim(list[currency_type_index]));
-                        strncpy(fattr->currency_type, p, sizeof(fattr->currency_type));
-                    }
-                    if (payment_method_index >= 0 && payment_method_index < n) {
-                        char* p = quote(trim(list[payment_method_index]));
-                        strncpy(fattr->payment_method, p, sizeof(fattr->payment_method));
-                    }
-                    if (transfers_index >= 0 && transfers_index < n) {
-                        char* p = quote(trim(list[transfers_index]));
-                        strncpy(fattr->transfers, p, sizeof(fattr->transfers));
-                    }
-                    if (agency_id_index >= 0 && agency_id_index < n) {
-                        char* p = quote(trim(list[agency_id_index]));
-                        strncpy(fattr->agency_id, p, sizeof(fattr->agency_id));
-                    }
-                    if (transfer_duration_index >= 0 && transfer_duration_index < n) {
-                        char* p = quote(trim(list[transfer_duration_index]));
-                        strncpy(fattr->transfer_duration, p, sizeof(fattr->transfer_duration));
-                    }
-                    fattr->lineno = lineno;
-                    vect_append(gtfs->fare_attrs_tbl, fattr);
-                }
-                list_free(list);
-            }
-        }
+    int value;
+
+    if (*str == '\0')
+        return 0;
+    st->flags |= ST_HAS(column);
+    value = atoi(str);
+    if (! isdigitstr(str) || value < 0 || (valid_max > 0 && value > valid_max))
+        value_error(gtfs, STOP_TIMES, st->lineno, _stop_times_column_name[column], str);
+    if (! is_plain_int(str) || (max_value > 0 && (value < 0 || value > max_value))) {
+        st->flags |= ST_RAW(column);
+        ext[column] = str;
     }
-    list_free(label_list);
-    free(ptr);
+    return value;
 }
 
-static void gtfs_fare_rules_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+static void stop_time_pack(const void* rec, void* dst, struct gtfs_t* gtfs)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int fare_id_index, route_id_index, origin_id_index, destination_id_index, contains_id_index;
-    int lineno = 0;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.fare_rules, trim(tp), sizeof(g_gtfs_label.fare_rules));
-    label_list = split(tp, COMMA_CHAR);
-    
-    fare_id_index = find_label_index(label_list, "fare_id");
-    route_id_index = find_label_index(label_list, "route_id");
-    origin_id_index = find_label_index(label_list, "origin_id");
-    destination_id_index = find_label_index(label_list, "destination_id");
-    contains_id_index = find_label_index(label_list, "contains_id");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct fare_rule_t* fare = calloc(1, sizeof(struct fare_rule_t));
-                    
-                    if (fare_id_index >= 0 && fare_id_index < n) {
-                        char* p = quote(trim(list[fare_id_index]));
-                        check_id_size(FARE_RULES, p);
-                        strncpy(fare->fare_id, p, sizeof(fare->fare_id));
-                    }
-                    if (route_id_index >= 0 && route_id_index < n) {
-                        char* p = quote(trim(list[route_id_index]));
-                        strncpy(fare->route_id, p, sizeof(fare->route_id));
-                    }
-                    if (origin_id_index >= 0 && origin_id_index < n) {
-                        char* p = quote(trim(list[origin_id_index]));
-                        strncpy(fare->origin_id, p, sizeof(fare->origin_id));
-                    }
-                    if (destination_id_index >= 0 && destination_id_index < n) {
-                        char* p = quote(trim(list[destination_id_index]));
-                        strncpy(fare->destination_id, p, sizeof(fare->destination_id));
-                    }
-                    if (contains_id_index >= 0 && contains_id_index < n) {
-                        char* p = quote(trim(list[contains_id_index]));
-                        strncpy(fare->contains_id, p, sizeof(fare->contains_id));
-                    }
-                    fare->lineno = lineno;
-                    vect_append(gtfs->fare_rules_tbl, fare);
-                }
-                list_free(list);
-            }
-        }
+    const struct stop_time_row_t* row = (const struct stop_time_row_t*)rec;
+    struct stop_time_t* st = (struct stop_time_t*)dst;
+    const char* ext[ST_EXT_COUNT];
+    char extbuf[sizeof(struct stop_time_row_t)];
+    int len = 0;
+    int i, n;
+
+    st->trip_id = row->trip_id;
+    st->stop_id = row->stop_id;
+    st->lineno = row->lineno;
+
+    for (i = 0; i < ST_EXT_COUNT; i++)
+        ext[i] = "";
+    ext[ST_STOP_HEADSIGN] = row->stop_headsign;
+    ext[ST_SHAPE_DIST_TRAVELED] = row->shape_dist_traveled;
+    ext[ST_TIMEPOINT] = row->timepoint;
+
+    st->arrival_time = pack_time(st, ST_ARRIVAL_TIME, row->arrival_time, ST_SHORT_ARRIVAL, ext, gtfs);
+    st->departure_time = pack_time(st, ST_DEPARTURE_TIME, row->departure_time, ST_SHORT_DEPARTURE, ext, gtfs);
+    st->stop_sequence = pack_int(st, ST_STOP_SEQUENCE, row->stop_sequence, 0, 0, ext, gtfs);
+    st->pickup_type = (uchar)pack_int(st, ST_PICKUP_TYPE, row->pickup_type, 255, 3, ext, gtfs);
+    st->drop_off_type = (uchar)pack_int(st, ST_DROP_OFF_TYPE, row->drop_off_type, 255, 3, ext, gtfs);
+
+    // 末尾の空の項目は格納しません。
+    for (n = ST_EXT_COUNT; n > 0 && *ext[n-1] == '\0'; n--)
+        ;
+    for (i = 0; i < n; i++) {
+        int size = (int)strlen(ext[i]);
+
+        memcpy(extbuf + len, ext[i], size);
+        len += size;
+        if (i < n-1)
+            extbuf[len++] = '\0';
     }
-    list_free(label_list);
-    free(ptr);
+    st->ext = intern_put_len(g_gtfs_strs, extbuf, len);
 }
 
-static void gtfs_shapes_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+struct gtfs_schema_t {
+    int rec_size;                           // レコード(構造体)のサイズ
+    int tbl_offset;                         // struct gtfs_t のテーブルのオフセット
+    int lineno_offset;                      // 行番号のオフセット
+    void* fixed_rec;                        // テーブルを持たない場合の格納先
+    char* label;                            // ラベル行の格納先
+    int label_size;
+    const struct gtfs_column_t* columns;    // 項目定義
+    void (*fixup_func)(void* rec, struct gtfs_t* gtfs);     // 格納後の補正
+    int pack_size;                          // 変換して格納するレコードのサイズ
+    void (*pack_func)(const void* rec, void* dst, struct gtfs_t* gtfs);     // 格納するレコードへの変換
+};
+
+#define SCHEMA(st, tbl, label, columns, fixup) \
+    { (int)sizeof(struct st), (int)offsetof(struct gtfs_t, tbl), (int)offsetof(struct st, lineno), NULL, \
+      g_gtfs_label.label, (int)sizeof(g_gtfs_label.label), columns, fixup, 0, NULL }
+
+// 読み込み用のレコード(row)を変換してテーブルに格納する場合
+#define PACK_SCHEMA(row, st, tbl, label, columns, pack) \
+    { (int)sizeof(struct row), (int)offsetof(struct gtfs_t, tbl), (int)offsetof(struct row, lineno), NULL, \
+      g_gtfs_label.label, (int)sizeof(g_gtfs_label.label), columns, NULL, (int)sizeof(struct st), pack }
+
+// 変換して格納する場合の読み込み用の作業領域
+union pack_work_t {
+    struct stop_time_row_t stop_time;
+};
+
+// ファイルの定義(g_gtfs_filename[]の順)
+static const struct gtfs_schema_t _schema[] = {
+    SCHEMA(agency_t, agency_tbl, agency, _agency_columns, NULL),
+    SCHEMA(stop_t, stops_tbl, stops, _stops_columns, stops_fixup),
+    SCHEMA(route_t, routes_tbl, routes, _routes_columns, NULL),
+    SCHEMA(trip_t, trips_tbl, trips, _trips_columns, NULL),
+    PACK_SCHEMA(stop_time_row_t, stop_time_t, stop_times_tbl, stop_times, _stop_times_columns, stop_time_pack),
+    SCHEMA(calendar_t, calendar_tbl, calendar, _calendar_columns, NULL),
+    SCHEMA(calendar_date_t, calendar_dates_tbl, calendar_dates, _calendar_dates_columns, NULL),
+    SCHEMA(fare_attribute_t, fare_attrs_tbl, fare_attributes, _fare_attributes_columns, fare_attributes_fixup),
+    SCHEMA(fare_rule_t, fare_rules_tbl, fare_rules, _fare_rules_columns, NULL),
+    SCHEMA(shape_t, shapes_tbl, shapes, _shapes_columns, NULL),
+    SCHEMA(frequency_t, frequencies_tbl, frequencies, _frequencies_columns, NULL),
+    SCHEMA(transfer_t, transfers_tbl, transfers, _transfers_columns, NULL),
+    // feed_info.txt は g_feed_info に格納します。
+    { (int)sizeof(struct feed_info_t), -1, (int)offsetof(struct feed_info_t, lineno), &g_feed_info,
+      g_gtfs_label.feed_info, (int)sizeof(g_gtfs_label.feed_info), _feed_info_columns, NULL, 0, NULL },
+    SCHEMA(translation_t, translations_tbl, translations, _translations_columns, translations_fixup),
+    SCHEMA(agency_jp_t, agency_jp_tbl, agency_jp, _agency_jp_columns, NULL),
+    SCHEMA(route_jp_t, routes_jp_tbl, routes_jp, _routes_jp_columns, NULL),
+    SCHEMA(office_jp_t, office_jp_tbl, office_jp, _office_jp_columns, NULL)
+};
+
+// ラベル行から求めた格納する項目の位置
+struct column_map_t {
+    const struct gtfs_schema_t* schema;
+    int kind;
+    int count;                                      // 格納する項目数
+    int field_index[MAX_COLUMNS];                   // csvの項目位置
+    const struct gtfs_column_t* column[MAX_COLUMNS];
+};
+
+/*
+ * ファイル種別のテーブル(vector)の格納場所を返します。
+ * feed_info.txt(FEED_INFO)はテーブルを持たないため指定できません。
+ */
+struct vector_t** gtfs_table(struct gtfs_t* gtfs, int kind)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int shape_id_index, shape_pt_lat_index, shape_pt_lon_index;
-    int shape_pt_sequence_index, shape_dist_traveled_index;
-    int lineno = 0;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.shapes, trim(tp), sizeof(g_gtfs_label.shapes));
-    label_list = split(tp, COMMA_CHAR);
-    
-    shape_id_index = find_label_index(label_list, "shape_id");
-    shape_pt_lat_index = find_label_index(label_list, "shape_pt_lat");
-    shape_pt_lon_index = find_label_index(label_list, "shape_pt_lon");
-    shape_pt_sequence_index = find_label_index(label_list, "shape_pt_sequence");
-    shape_dist_traveled_index = find_label_index(label_list, "shape_dist_traveled");
-    
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct shape_t* shape = calloc(1, sizeof(struct shape_t));
-                    
-                    if (shape_id_index >= 0 && shape_id_index < n) {
-                        char* p = quote(trim(list[shape_id_index]));
-                        check_id_size(SHAPES, p);
-                        strncpy(shape->shape_id, p, sizeof(shape->shape_id));
-                    }
-                    if (shape_pt_lat_index >= 0 && shape_pt_lat_index < n) {
-                        char* p = quote(trim(list[shape_pt_lat_index]));
-                        strncpy(shape->shape_pt_lat, p, sizeof(shape->shape_pt_lat));
-                    }
-                    if (shape_pt_lon_index >= 0 && shape_pt_lon_index < n) {
-                        char* p = quote(trim(list[shape_pt_lon_index]));
-                        strncpy(shape->shape_pt_lon, p, sizeof(shape->shape_pt_lon));
-                    }
-                    if (shape_pt_sequence_index >= 0 && shape_pt_sequence_index < n) {
-                        char* p = quote(trim(list[shape_pt_sequence_index]));
-                        strncpy(shape->shape_pt_sequence, p, sizeof(shape->shape_pt_sequence));
-                    }
-                    if (shape_dist_traveled_index >= 0 && shape_dist_traveled_index < n) {
-                        char* p = quote(trim(list[shape_dist_traveled_index]));
-                        strncpy(shape->shape_dist_traveled, p, sizeof(shape->shape_dist_traveled));
-                    }
-                    shape->lineno = lineno;
-                    vect_append(gtfs->shapes_tbl, shape);
-                }
-                list_free(list);
-            }
-        }
-    }
-    list_free(label_list);
-    free(ptr);
+    return (struct vector_t**)((char*)gtfs + _schema[kind].tbl_offset);
 }
 
-static void gtfs_frequencies_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+/*
+ * g_gtfs_columns で指定された読み込む項目かどうかを判定します。
+ * ファイルの指定がない場合はすべての項目を読み込みます。
+ */
+static int is_column_used(int kind, const char* name)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int trip_id_index, start_time_index, end_time_index, headway_secs_index, exact_times_index;
-    int lineno = 0;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.frequencies, trim(tp), sizeof(g_gtfs_label.frequencies));
-    label_list = split(tp, COMMA_CHAR);
-    
-    trip_id_index = find_label_index(label_list, "trip_id");
-    start_time_index = find_label_index(label_list, "start_time");
-    end_time_index = find_label_index(label_list, "end_time");
-    headway_secs_index = find_label_index(label_list, "headway_secs");
-    exact_times_index = find_label_index(label_list, "exact_times");
-    
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct frequency_t* freq = calloc(1, sizeof(struct frequency_t));
-                    
-                    if (trip_id_index >= 0 && trip_id_index < n) {
-                        char* p = quote(trim(list[trip_id_index]));
-                        check_id_size(FREQUENCIES, p);
-                        strncpy(freq->trip_id, p, sizeof(freq->trip_id));
-                    }
-                    if (start_time_index >= 0 && start_time_index < n) {
-                        char* p = quote(trim(list[start_time_index]));
-                        strncpy(freq->start_time, p, sizeof(freq->start_time));
-                    }
-                    if (end_time_index >= 0 && end_time_index < n) {
-                        char* p = quote(trim(list[end_time_index]));
-                        strncpy(freq->end_time, p, sizeof(freq->end_time));
-                    }
-                    if (headway_secs_index >= 0 && headway_secs_index < n) {
-                        char* p = quote(trim(list[headway_secs_index]));
-                        strncpy(freq->headway_secs, p, sizeof(freq->headway_secs));
-                    }
-                    if (exact_times_index >= 0 && exact_times_index < n) {
-                        char* p = quote(trim(list[exact_times_index]));
-                        strncpy(freq->exact_times, p, sizeof(freq->exact_times));
-                    }
-                    freq->lineno = lineno;
-                    vect_append(gtfs->frequencies_tbl, freq);
-                }
-                list_free(list);
+    const struct gtfs_columns_t* gc;
+    int len;
+
+    if (g_gtfs_columns == NULL)
+        return 1;
+
+    len = (int)strlen(name);
+    for (gc = g_gtfs_columns; gc->kind >= 0; gc++) {
+        if (gc->kind == kind) {
+            const char* p = gc->columns;
+
+            while (*p) {
+                const char* endp = strchr(p, ',');
+                int n = (endp)? (int)(endp - p) : (int)strlen(p);
+
+                if (n == len && strncmp(p, name, len) == 0)
+                    return 1;
+                p += n;
+                if (*p == ',')
+                    p++;
             }
+            return 0;
         }
     }
-    list_free(label_list);
-    free(ptr);
+    return 1;
 }
 
-static void gtfs_transfers_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+static void column_map_init(struct column_map_t* map, int kind)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int from_stop_id_index, to_stop_id_index, transfer_type_index, min_transfer_time_index;
-    int lineno = 0;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.transfers, trim(tp), sizeof(g_gtfs_label.transfers));
-    label_list = split(tp, COMMA_CHAR);
-    
-    from_stop_id_index = find_label_index(label_list, "from_stop_id");
-    to_stop_id_index = find_label_index(label_list, "to_stop_id");
-    transfer_type_index = find_label_index(label_list, "transfer_type");
-    min_transfer_time_index = find_label_index(label_list, "min_transfer_time");
-    
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct transfer_t* transfer = calloc(1, sizeof(struct transfer_t));
-                    
-                    if (from_stop_id_index >= 0 && from_stop_id_index < n) {
-                        char* p = quote(trim(list[from_stop_id_index]));
-                        check_id_size(TRANSFERS, p);
-                        strncpy(transfer->from_stop_id, p, sizeof(transfer->from_stop_id));
-                    }
-                    if (to_stop_id_index >= 0 && to_stop_id_index < n) {
-                        char* p = quote(trim(list[to_stop_id_index]));
-                        check_id_size(TRANSFERS, p);
-                        strncpy(transfer->to_stop_id, p, sizeof(transfer->to_stop_id));
-                    }
-                    if (transfer_type_index >= 0 && transfer_type_index < n) {
-                        char* p = quote(trim(list[transfer_type_index]));
-                        strncpy(transfer->transfer_type, p, sizeof(transfer->transfer_type));
-                    }
-                    if (min_transfer_time_index >= 0 && min_transfer_time_index < n) {
-                        char* p = quote(trim(list[min_transfer_time_index]));
-                        strncpy(transfer->min_transfer_time, p, sizeof(transfer->min_transfer_time));
-                    }
-                    transfer->lineno = lineno;
-                    vect_append(gtfs->transfers_tbl, transfer);
-                }
-                list_free(list);
-            }
+    memset(map, '\0', sizeof(struct column_map_t));
+    map->schema = &_schema[kind];
+    map->kind = kind;
+}
+
+static void schema_label(struct csv_reader_t* csv, struct column_map_t* map)
+{
+    const struct gtfs_schema_t* schema = map->schema;
+    const struct gtfs_column_t* col;
+    int prev_index = -1;
+    int prev_used = 0;
+
+    get_label(csv, schema->label, schema->label_size);
+
+    map->count = 0;
+    for (col = schema->columns; col->name; col++) {
+        int index, used;
+
+        index = find_field_index(csv, col->name);
+        if (col->type & COL_ALIAS) {
+            if (prev_index >= 0)
+                index = -1;
+            used = prev_used;
+        } else {
+            used = is_column_used(map->kind, col->name);
+            prev_index = index;
+            prev_used = used;
+        }
+        if (index >= 0 && used && map->count < MAX_COLUMNS) {
+            map->field_index[map->count] = index;
+            map->column[map->count] = col;
+            map->count++;
         }
     }
-    list_free(label_list);
-    free(ptr);
 }
 
-static void gtfs_feed_info_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+static void schema_record(struct csv_reader_t* csv, const struct column_map_t* map, struct gtfs_t* gtfs)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int feed_publisher_name_index, feed_publisher_url_index, feed_lang_index;
-    int feed_start_date_index, feed_end_date_index, feed_version_index;
-    
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    strncpy(g_gtfs_label.feed_info, trim(tp), sizeof(g_gtfs_label.feed_info));
-    label_list = split(tp, COMMA_CHAR);
-    
-    feed_publisher_name_index = find_label_index(label_list, "feed_publisher_name");
-    feed_publisher_url_index = find_label_index(label_list, "feed_publisher_url");
-    feed_lang_index = find_label_index(label_list, "feed_lang");
-    feed_start_date_index = find_label_index(label_list, "feed_start_date");
-    feed_end_date_index = find_label_index(label_list, "feed_end_date");
-    feed_version_index = find_label_index(label_list, "feed_version");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    if (feed_publisher_name_index >= 0 && feed_publisher_name_index < n) {
-                        char* p = quote(trim(list[feed_publisher_name_index]));
-                        strncpy(g_feed_info.feed_publisher_name, p, sizeof(g_feed_info.feed_publisher_name));
-                    }
-                    if (feed_publisher_url_index >= 0 && feed_publisher_url_index < n) {
-                        char* p = quote(trim(list[feed_publisher_url_index]));
-                        strncpy(g_feed_info.feed_publisher_url, p, sizeof(g_feed_info.feed_publisher_url));
-                    }
-                    if (feed_lang_index >= 0 && feed_lang_index < n) {
-                        char* p = quote(trim(list[feed_lang_index]));
-                        strncpy(g_feed_info.feed_lang, p, sizeof(g_feed_info.feed_lang));
-                    }
-                    if (feed_start_date_index >= 0 && feed_start_date_index < n) {
-                        char* p = quote(trim(list[feed_start_date_index]));
-                        strncpy(g_feed_info.feed_start_date, p, sizeof(g_feed_info.feed_start_date));
-                    }
-                    if (feed_end_date_index >= 0 && feed_end_date_index < n) {
-                        char* p = quote(trim(list[feed_end_date_index]));
-                        strncpy(g_feed_info.feed_end_date, p, sizeof(g_feed_info.feed_end_date));
-                    }
-                    if (feed_version_index >= 0 && feed_version_index < n) {
-                        char* p = quote(trim(list[feed_version_index]));
-                        strncpy(g_feed_info.feed_version, p, sizeof(g_feed_info.feed_version));
-                    }
-                }
-                list_free(list);
+    const struct gtfs_schema_t* schema = map->schema;
+    union pack_work_t work;
+    char* rec;
+    int i;
+
+    if (schema->fixed_rec)
+        rec = (char*)schema->fixed_rec;
+    else if (schema->pack_func)
+        rec = (char*)memset(&work, '\0', schema->rec_size);
+    else
+        rec = (char*)gtfs_row_alloc(gtfs, map->kind, schema->rec_size);
+
+    for (i = 0; i < map->count; i++) {
+        const struct gtfs_column_t* col = map->column[i];
+        const struct csv_field_t* fld;
+        char* dst = rec + col->offset;
+        int len;
+
+        if (map->field_index[i] >= csv->count)
+            continue;
+        fld = &csv->fields[map->field_index[i]];
+        if (col->type & COL_SYM) {
+            char id[GTFS_ID_SIZE];
+
+            if (! fld->escaped && fld->len < GTFS_ID_SIZE) {
+                // バッファにコピーせずに登録します。
+                *(uint32*)dst = intern_put_len(g_gtfs_ids, fld->ptr, fld->len);
+                continue;
             }
+            len = csv_field_copy(id, sizeof(id), fld);
+            if ((col->type & COL_ID) && len > GTFS_ID_SIZE)
+                err_write("%s: [%s] size over.\n", g_gtfs_filename[map->kind], id);
+            *(uint32*)dst = intern_put(g_gtfs_ids, id);
+            continue;
+        }
+        len = csv_field_copy(dst, col->size, fld);
+        if (col->type & COL_ID) {
+            if (len > GTFS_ID_SIZE)
+                err_write("%s: [%s] size over.\n", g_gtfs_filename[map->kind], dst);
+        } else if (col->type & COL_UPPER) {
+            toupperstr(dst);
         }
     }
-    list_free(label_list);
-    free(ptr);
+    *(int*)(rec + schema->lineno_offset) = csv->lineno;
+    if (schema->fixup_func)
+        (*schema->fixup_func)(rec, gtfs);
+    if (schema->pack_func) {
+        char* dst = (char*)gtfs_row_alloc(gtfs, map->kind, schema->pack_size);
+
+        (*schema->pack_func)(rec, dst, gtfs);
+        rec = dst;
+    }
+    // テーブルはファイルを読み込むスレッドだけが使用するためロックしません。
+    if (! schema->fixed_rec)
+        vect_append_unlocked(*gtfs_table(gtfs, map->kind), rec);
 }
 
-static int table_type(const char* table_name)
+/*
+ * IDを文字列プールに登録してシンボルを返します。
+ */
+uint32 gtfs_id_sym(const char* id)
 {
-    if (strcmp(table_name, "stops") == 0)
-        return STOPS;
-    return -1;
+    return intern_put(g_gtfs_ids, id);
 }
 
-static void gtfs_translations_reader(const char* csvptr, size_t size, struct gtfs_t* gtfs)
+/*
+ * 登録されているIDのシンボルを返します。
+ * 登録されていない場合は INTERN_NONE を返します。
+ */
+uint32 gtfs_id_find(const char* id)
 {
-    char* ptr;
-    char* tp;
-    char** label_list;
-    int trans_id_index, lang_index, translation_index;
-    int table_name_index, field_name_index, record_id_index, record_sub_id_index, field_value_index;
-    int lineno = 0;
-
-    ptr = malloc(size+1);
-    memcpy(ptr, csvptr, size);
-    ptr[size] = '\0';
-    
-    tp = strtok(ptr, LF_STR);   // ラベル行
-    lineno++;
-    strncpy(g_gtfs_label.translations, trim(tp), sizeof(g_gtfs_label.translations));
-    label_list = split(tp, COMMA_CHAR);
-    
-    trans_id_index = find_label_index(label_list, "trans_id");
-    lang_index = find_label_index(label_list, "lang");
-    if (lang_index < 0) {
-        // gtfs new version(2020/08/19)
-        lang_index = find_label_index(label_list, "language");
+    return intern_get(g_gtfs_ids, id);
+}
+
+/*
+ * シンボルのID文字列を返します。
+ */
+const char* gtfs_id(uint32 sym)
+{
+    return intern_str(g_gtfs_ids, sym);
+}
+
+/*
+ * テーブルのレコードの領域をファイル種別ごとのアリーナから確保します。
+ * 領域はゼロで初期化されていて、gtfs_free() でまとめて解放されます。
+ * 同じファイル種別の領域を複数のスレッドから同時に確保することはできません。
+ *
+ * gtfs: GTFS構造体のポインタ
+ * kind: ファイル種別
+ * size: レコードのバイト数
+ *
+ * 戻り値
+ *  確保した領域のポインタを返します。
+ */
+void* gtfs_row_alloc(struct gtfs_t* gtfs, int kind, int size)
+{
+    if (gtfs->row_arena[kind] == NULL)
+        gtfs->row_arena[kind] = arena_initialize(0);
+    return arena_alloc(gtfs->row_arena[kind], size);
+}
+
+/*
+ * ext に格納された項目の文字列を返します。
+ */
+static const char* ext_text(const struct stop_time_t* st, int column)
+{
+    const char* p = intern_str(g_gtfs_strs, st->ext);
+    const char* endp = p + intern_len(g_gtfs_strs, st->ext);
+    int i;
+
+    for (i = 0; i < column && p < endp; i++)
+        p += strlen(p) + 1;
+    return (p < endp)? p : "";
+}
+
+/*
+ * stop_times.txt の項目の文字列を取得します。
+ * 読み込んだ時の文字列と同じ文字列を返します。
+ *
+ * st: stop_time_t のポインタ
+ * column: 項目(ST_ARRIVAL_TIME など)
+ * buf: 数値を文字列に変換する場合のバッファ(ST_TEXT_SIZE以上)
+ *
+ * 戻り値
+ *  文字列のポインタを返します。
+ *  値がない場合は空文字列を返します。
+ */
+const char* gtfs_stop_time_text(const struct stop_time_t* st, int column, char* buf)
+{
+    int value;
+
+    if (column < ST_ARRIVAL_TIME)
+        return ext_text(st, column);
+    if (! (st->flags & ST_HAS(column)))
+        return "";
+    if (st->flags & ST_RAW(column))
+        return ext_text(st, column);
+
+    switch (column) {
+        case ST_ARRIVAL_TIME:
+        case ST_DEPARTURE_TIME:
+            value = (column == ST_ARRIVAL_TIME)? st->arrival_time : st->departure_time;
+            if (st->flags & ((column == ST_ARRIVAL_TIME)? ST_SHORT_ARRIVAL : ST_SHORT_DEPARTURE))
+                snprintf(buf, ST_TEXT_SIZE, "%d:%02d:%02d", value / 3600, value / 60 % 60, value % 60);
+            else
+                snprintf(buf, ST_TEXT_SIZE, "%02d:%02d:%02d", value / 3600, value / 60 % 60, value % 60);
+            return buf;
+        case ST_STOP_SEQUENCE:
+            value = st->stop_sequence;
+            break;
+        case ST_PICKUP_TYPE:
+            value = st->pickup_type;
+            break;
+        default:
+            value = st->drop_off_type;
+            break;
     }
-    translation_index = find_label_index(label_list, "translation");
+    snprintf(buf, ST_TEXT_SIZE, "%d", value);
+    return buf;
+}
 
-    // gtfs new version(2020/08/21)
-    table_name_index = find_label_index(label_list, "table_name");
-    field_name_index = find_label_index(label_list, "field_name");
-    record_id_index = find_label_index(label_list, "record_id");
-    record_sub_id_index = find_label_index(label_list, "record_sub_id");
-    field_value_index = find_label_index(label_list, "field_value");
-
-    while (tp) {
-        tp = strtok(NULL, LF_STR);
-        lineno++;
-        if (tp && strlen(trim(tp)) > 0) {
-            char** list = split(tp, COMMA_CHAR);
-            if (list) {
-                int n = list_count((const char**)list);
-                if (n > 0) {
-                    struct translation_t* trans = calloc(1, sizeof(struct translation_t));
-
-                    if (trans_id_index >= 0 && trans_id_index < n) {
-                        char* p = quote(trim(list[trans_id_index]));
-                        strncpy(trans->trans_id, p, sizeof(trans->trans_id));
-                    }
-                    if (lang_index >= 0 && lang_index < n) {
-                        char* p = quote(trim(list[lang_index]));
-                        strncpy(trans->lang, p, sizeof(trans->lang));
-                    }
-                    if (translation_index >= 0 && translation_index < n) {
-                        char* p = quote(trim(list[translation_index]));
-                        strncpy(trans->translation, p, sizeof(trans->translation));
-                    }
-                    // gtfs new version(2020/08/21)
-                    if (table_name_index >= 0 && table_name_index < n) {
-                        char* p = quote(trim(list[table_name_index]));
-                        // stops以外は無視します
-                        trans->table_type = table_type(p);
-                        strncpy(trans->table_name, p, sizeof(trans->table_name));
-                    }
-                    if (field_name_index >= 0 && field_name_index < n) {
-                        char* p = quote(trim(list[field_name_index]));
-                        strncpy(trans->field_name, p, sizeof(trans->field_name));
-                    }
-                    if (record_id_index >= 0 && record_id_index < n) {
-                        char* p = quote(trim(list[record_id_index]));
-                        strncpy(trans->record_id, p, sizeof(trans->record_id));
-                    }
-                    if (record_sub_id_index >= 0 && record_sub_id_index < n) {
-                        char* p = quote(trim(list[record_sub_id_index]));
-                        strncpy(trans->record_sub_id, p, sizeof(trans->record_sub_id));
-                    }
-                    if (field_value_index >= 0 && field_value_index < n) {
-                        char* p = quote(trim(list[field_value_index]));
-                        strncpy(trans->field_value, p, sizeof(trans->field_value));
-                    }
-                    trans->lineno = lineno;
-                    vect_append(gtfs->translations_tbl, trans);
-                }
-                list_free(list);
-            }
-        }
+/*
+ * 乗車区分の値を取得します。
+ * 数値以外の文字列の場合は atoi() で変換した値を返します。
+ */
+int gtfs_stop_time_pickup_type(const struct stop_time_t* st)
+{
+    if (st->flags & ST_RAW(ST_PICKUP_TYPE))
+        return atoi(ext_text(st, ST_PICKUP_TYPE));
+    return st->pickup_type;
+}
+
+/*
+ * 降車区分の値を取得します。
+ * 数値以外の文字列の場合は atoi() で変換した値を返します。
+ */
+int gtfs_stop_time_drop_off_type(const struct stop_time_t* st)
+{
+    if (st->flags & ST_RAW(ST_DROP_OFF_TYPE))
+        return atoi(ext_text(st, ST_DROP_OFF_TYPE));
+    return st->drop_off_type;
+}
+
+// 件数の見積りに使用する１行あたりの平均的なバイト数(g_gtfs_filename[]の順)
+static const int _row_bytes[] = {
+    100,    // agency.txt
+    48,     // stops.txt
+    48,     // routes.txt
+    40,     // trips.txt
+    32,     // stop_times.txt
+    40,     // calendar.txt
+    20,     // calendar_dates.txt
+    24,     // fare_attributes.txt
+    24,     // fare_rules.txt
+    28,     // shapes.txt
+    32,     // frequencies.txt
+    24,     // transfers.txt
+    0,      // feed_info.txt(テーブルなし)
+    40,     // translations.txt
+    60,     // agency_jp.txt
+    40,     // routes_jp.txt
+    40      // office_jp.txt
+};
+
+/*
+ * ファイルのサイズ(展開後)から件数を見積もってテーブルの領域を確保します。
+ * 大きなファイルを読み込む間に領域の再確保が繰り返されないようにします。
+ */
+static void table_reserve(struct gtfs_t* gtfs, int kind, size_t size)
+{
+    size_t rows;
+
+    if (_row_bytes[kind] == 0)
+        return;
+    rows = size / _row_bytes[kind] + 1;
+    if (rows > INT_MAX / 2)
+        rows = INT_MAX / 2;
+    vect_reserve(*gtfs_table(gtfs, kind), vect_count(*gtfs_table(gtfs, kind)) + (int)rows);
+}
+
+static void gtfs_table_reader(const char* csvptr, size_t size, struct column_map_t* map, struct gtfs_t* gtfs)
+{
+    struct csv_reader_t csv;
+
+    csv_reader_init(&csv, csvptr, size);
+    if (csv_read_record(&csv) < 1) {    // ラベル行
+        csv_reader_free(&csv);
+        return;
     }
-    list_free(label_list);
-    free(ptr);
+    schema_label(&csv, map);
+
+    while (csv_read_record(&csv) > 0)
+        schema_record(&csv, map, gtfs);
+    csv_reader_free(&csv);
 }
 
 static int is_http_url(const char* zippath)
@@ -1419,178 +966,853 @@ static int utf8_bom(char* str)
     return 0;
 }
 
-int gtfs_zip_archive_reader(const char* zippath, struct gtfs_t* gtfs)
+/*
+ * 大きなファイル(stop_times.txt, shapes.txt)はヒープに全体を展開せずに
+ * miniz のコールバックで展開された単位ごとに解析します。
+ * 途中で切れている行は次の展開データと連結して解析されます。
+ */
+struct csv_stream_t {
+    struct csv_reader_t csv;
+    int label_done;
+    struct column_map_t* map;
+    struct gtfs_t* gtfs;
+};
+
+static void csv_stream_parse(struct csv_stream_t* cs)
 {
-    static mz_zip_archive zip_archive;
-    mz_bool done = 0;
-    char* csvptr;
-    size_t csvsize;
-    char* resptr = NULL;
+    if (! cs->label_done) {
+        if (csv_read_record(&cs->csv) < 1)  // ラベル行
+            return;
+        schema_label(&cs->csv, cs->map);
+        cs->label_done = 1;
+    }
+    while (csv_read_record(&cs->csv) > 0)
+        schema_record(&cs->csv, cs->map, cs->gtfs);
+}
 
-    memset(&zip_archive, '\0', sizeof(zip_archive));
-    if (is_http_url(zippath)) {
-        size_t ressize;
+static size_t csv_stream_callback(void* opaque, mz_uint64 file_ofs, const void* buf, size_t n)
+{
+    struct csv_stream_t* cs = (struct csv_stream_t*)opaque;
+    const char* ptr = (const char*)buf;
+    size_t size = n;
+
+    if (file_ofs == 0 && n >= 3) {
+        int bomsize = utf8_bom((char*)ptr);
+        ptr += bomsize;
+        size -= bomsize;
+    }
+    if (csv_reader_feed(&cs->csv, ptr, size) < 0)
+        return 0;   // 展開を中止します。
+    csv_stream_parse(cs);
+    return n;
+}
 
-        resptr = url_request(zippath, &ressize);
-        if (resptr) {
-            int status;
+/*
+ * 大きなファイルの分割並列解析(-j)
+ *
+ * 展開したデータを行の先頭で区切ったチャンクに分けて、チャンクごとに
+ * ワーカースレッドで解析します。
+ * 各チャンクの開始行番号は、チャンクごとの改行数を数えて累積した値から求めるため、
+ * 逐次で解析した場合と同じ行番号になります。
+ * チャンクの境界が引用符で囲まれたフィールド内の改行だった場合は、
+ * 前のチャンクがそのレコードを最後まで読み込むため、後のチャンクの解析結果を
+ * 破棄して正しい位置から読み直します。
+ */
+#define CHUNK_PARSE_MIN_SIZE    (4*1024*1024)
+#define CHUNK_MIN_SIZE          (1024*1024)
+
+struct csv_chunk_t {
+    const char* startptr;       // チャンクの先頭(行の先頭)
+    const char* limitptr;       // 次のチャンクの先頭
+    const char* endptr;         // 解析が終了した位置
+    int lineno;                 // チャンクの開始行番号
+    int end_lineno;             // 解析が終了した位置の行番号
+    int lf_count;               // チャンク内の改行数
+    struct gtfs_t gtfs;         // チャンクのテーブル
+};
+
+struct chunk_parser_t {
+    const char* csvendptr;
+    int kind;
+    const struct column_map_t* map;
+    int count;
+    struct csv_chunk_t* chunks;
+};
+
+static void chunk_lf_count_job(int job_no, int worker_no, void* arg)
+{
+    struct chunk_parser_t* cp = (struct chunk_parser_t*)arg;
+    struct csv_chunk_t* chunk = &cp->chunks[job_no];
+    const char* p = chunk->startptr;
+    int n = 0;
+
+    (void)worker_no;    // 未使用
+    while (p < chunk->limitptr) {
+        p = memchr(p, '\n', chunk->limitptr - p);
+        if (p == NULL)
+            break;
+        n++;
+        p++;
+    }
+    chunk->lf_count = n;
+}
 
-            status = url_http_status(resptr);
-            if (status == 200) {
-                const char* zipptr;
-                size_t zipsize;
-                
-                zipptr = body_contents((const char*)resptr, ressize, &zipsize);
-                if (zipptr)
-                    done = mz_zip_reader_init_mem(&zip_archive, zipptr, zipsize, 0);
-            } else {
-                err_write("%s unsupport status=%d\n", zippath, status);
+static void chunk_parse(struct chunk_parser_t* cp, struct csv_chunk_t* chunk, const char* startptr, int lineno)
+{
+    struct csv_reader_t csv;
+
+    csv_reader_init(&csv, startptr, cp->csvendptr - startptr);
+    csv.next_lineno = lineno;
+    if (startptr < chunk->limitptr) {
+        // チャンクの範囲内で完結するレコード
+        csv.endptr = chunk->limitptr;
+        csv.eof = (chunk->limitptr == cp->csvendptr);
+        while (csv_read_record(&csv) > 0)
+            schema_record(&csv, cp->map, &chunk->gtfs);
+
+        if (csv.ptr < chunk->limitptr) {
+            // 次のチャンクにまたがるレコード
+            csv.endptr = cp->csvendptr;
+            csv.eof = 1;
+            if (csv_read_record(&csv) > 0)
+                schema_record(&csv, cp->map, &chunk->gtfs);
+        }
+    }
+    chunk->endptr = csv.ptr;
+    chunk->end_lineno = csv.next_lineno;
+    csv_reader_free(&csv);
+}
+
+static void chunk_parse_job(int job_no, int worker_no, void* arg)
+{
+    struct chunk_parser_t* cp = (struct chunk_parser_t*)arg;
+    struct csv_chunk_t* chunk = &cp->chunks[job_no];
+
+    (void)worker_no;    // 未使用
+    chunk_parse(cp, chunk, chunk->startptr, chunk->lineno);
+}
+
+static void gtfs_chunk_parser(const char* csvptr,
+                              size_t size,
+                              int kind,
+                              struct column_map_t* map,
+                              struct gtfs_t* gtfs)
+{
+    struct csv_reader_t csv;
+    struct chunk_parser_t cp;
+    const char* dataptr;
+    const char* endptr = csvptr + size;
+    size_t chunk_size;
+    int nthreads;
+    int lineno;
+    int i;
+
+    csv_reader_init(&csv, csvptr, size);
+    if (csv_read_record(&csv) < 1) {    // ラベル行
+        csv_reader_free(&csv);
+        return;
+    }
+    schema_label(&csv, map);
+    dataptr = csv.ptr;
+    lineno = csv.next_lineno;
+    csv_reader_free(&csv);
+
+    nthreads = (g_load_threads > 0)? g_load_threads : mt_cpu_count();
+    memset(&cp, '\0', sizeof(cp));
+    cp.count = nthreads * 2;
+    chunk_size = (endptr - dataptr) / cp.count + 1;
+    if (chunk_size < CHUNK_MIN_SIZE) {
+        chunk_size = CHUNK_MIN_SIZE;
+        cp.count = (int)((endptr - dataptr) / chunk_size) + 1;
+    }
+    cp.csvendptr = endptr;
+    cp.kind = kind;
+    cp.map = map;
+    cp.chunks = (struct csv_chunk_t*)calloc(cp.count, sizeof(struct csv_chunk_t));
+
+    // チャンクの境界(行の先頭)
+    for (i = 0; i < cp.count; i++) {
+        struct csv_chunk_t* chunk = &cp.chunks[i];
+        const char* p;
+
+        chunk->startptr = (i == 0)? dataptr : cp.chunks[i-1].limitptr;
+        p = chunk->startptr + chunk_size;
+        if (p >= endptr || i == cp.count-1) {
+            p = endptr;
+        } else {
+            p = memchr(p, '\n', endptr - p);
+            p = (p)? p + 1 : endptr;
+        }
+        chunk->limitptr = p;
+        *gtfs_table(&chunk->gtfs, kind) = vect_initialize((int)((p - chunk->startptr) / 32 + 1));
+        chunk->gtfs.value_errors = vect_initialize(16);
+    }
+
+    // チャンクごとの改行数から開始行番号を求めます。
+    mt_parallel(nthreads, cp.count, chunk_lf_count_job, &cp);
+    for (i = 0; i < cp.count; i++) {
+        cp.chunks[i].lineno = lineno;
+        lineno += cp.chunks[i].lf_count;
+    }
+    // 改行数から件数がわかるので連結先のテーブルを確保しておきます。
+    vect_reserve(*gtfs_table(gtfs, kind),
+                 vect_count(*gtfs_table(gtfs, kind)) + (lineno - cp.chunks[0].lineno) + 1);
+
+    mt_parallel(nthreads, cp.count, chunk_parse_job, &cp);
+
+    // 前のチャンクの終了位置と一致しない場合は読み直して、順番に連結します。
+    for (i = 0; i < cp.count; i++) {
+        struct csv_chunk_t* chunk = &cp.chunks[i];
+        struct vector_t* vt = *gtfs_table(&chunk->gtfs, kind);
+        int n, j;
+
+        if (i > 0 && chunk->startptr != cp.chunks[i-1].endptr) {
+            struct csv_chunk_t* prev = &cp.chunks[i-1];
+
+            arena_finalize(chunk->gtfs.row_arena[kind]);
+            chunk->gtfs.row_arena[kind] = NULL;
+            vect_finalize(vt);
+            vt = vect_initialize((int)((chunk->limitptr - chunk->startptr) / 32 + 1));
+            *gtfs_table(&chunk->gtfs, kind) = vt;
+            vect_finalize(chunk->gtfs.value_errors);
+            chunk->gtfs.value_errors = vect_initialize(16);
+            chunk_parse(&cp, chunk, prev->endptr, prev->end_lineno);
+        }
+        n = vect_count(vt);
+        for (j = 0; j < n; j++)
+            vect_append_unlocked(*gtfs_table(gtfs, kind), vect_get_unlocked(vt, j));
+        vect_finalize(vt);
+        n = vect_count(chunk->gtfs.value_errors);
+        for (j = 0; j < n; j++)
+            vect_append(gtfs->value_errors, vect_get(chunk->gtfs.value_errors, j));
+        vect_finalize(chunk->gtfs.value_errors);
+
+        // チャンクのレコードの領域を引き継ぎます。
+        if (chunk->gtfs.row_arena[kind]) {
+            if (gtfs->row_arena[kind] == NULL)
+                gtfs->row_arena[kind] = arena_initialize(0);
+            arena_move(gtfs->row_arena[kind], chunk->gtfs.row_arena[kind]);
+            arena_finalize(chunk->gtfs.row_arena[kind]);
+        }
+    }
+    free(cp.chunks);
+}
+
+static int gtfs_zip_stream_reader(mz_zip_archive* zip_archive,
+                                  int kind,
+                                  struct column_map_t* map,
+                                  struct gtfs_t* gtfs)
+{
+    struct csv_stream_t cs;
+    int file_index;
+    mz_bool done;
+
+    file_index = mz_zip_reader_locate_file(zip_archive, g_gtfs_filename[kind], NULL, 0);
+    if (file_index < 0)
+        return -1;
+
+    if (g_load_threads != 1) {
+        mz_zip_archive_file_stat st;
+
+        if (mz_zip_reader_file_stat(zip_archive, file_index, &st) &&
+            st.m_uncomp_size >= CHUNK_PARSE_MIN_SIZE) {
+            char* csvptr;
+            size_t csvsize;
+
+            // 分割して並列に解析します。
+            csvptr = mz_zip_reader_extract_to_heap(zip_archive, file_index, &csvsize, 0);
+            if (csvptr == NULL) {
+                err_write("%s: extract error.\n", g_gtfs_filename[kind]);
+                return -1;
+            }
+            if (csvsize > 0) {
+                int bomsize = (csvsize >= 3)? utf8_bom(csvptr) : 0;
+                gtfs_chunk_parser(csvptr+bomsize, csvsize-bomsize, kind, map, gtfs);
             }
+            mz_free(csvptr);
+            return 0;
         }
+    }
+
+    memset(&cs, '\0', sizeof(cs));
+    csv_reader_stream_init(&cs.csv);
+    cs.map = map;
+    cs.gtfs = gtfs;
+
+    done = mz_zip_reader_extract_to_callback(zip_archive, file_index, csv_stream_callback, &cs, 0);
+    if (done) {
+        // 最終行に改行がない場合の残りのデータ
+        csv_reader_feed_end(&cs.csv);
+        csv_stream_parse(&cs);
     } else {
-        done = mz_zip_reader_init_file(&zip_archive, zippath, 0);
+        err_write("%s: extract error.\n", g_gtfs_filename[kind]);
     }
-    if (! done)
-        return -1;
+    csv_reader_free(&cs.csv);
+    return done? 0 : -1;
+}
+
+/*
+ * メモリ上のCSVデータ(マッピングしたファイル、無圧縮のzipエントリ)を
+ * コピーせずにそのまま解析します。大きなファイルは分割して並列に解析します。
+ */
+static void gtfs_mem_reader(const char* csvptr, size_t csvsize, int kind, struct gtfs_t* gtfs)
+{
+    struct column_map_t map;
+    int bomsize;
+
+    if (csvsize == 0)
+        return;
+    table_reserve(gtfs, kind, csvsize);
+    column_map_init(&map, kind);
+    bomsize = (csvsize >= 3)? utf8_bom((char*)csvptr) : 0;
+    if (g_load_threads != 1 && csvsize >= CHUNK_PARSE_MIN_SIZE)
+        gtfs_chunk_parser(csvptr+bomsize, csvsize-bomsize, kind, &map, gtfs);
+    else
+        gtfs_table_reader(csvptr+bomsize, csvsize-bomsize, &map, gtfs);
+}
+
+// zipのローカルファイルヘッダ
+#define ZIP_LOCAL_HEADER_SIG        0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE       30
+#define ZIP_LOCAL_FILENAME_LEN_OFS  26
+#define ZIP_LOCAL_EXTRA_LEN_OFS     28
+
+#define ZIP_LE16(p)  ((mz_uint32)(p)[0] | ((mz_uint32)(p)[1] << 8))
+#define ZIP_LE32(p)  (ZIP_LE16(p) | (ZIP_LE16((p)+2) << 16))
+
+/*
+ * zipアーカイブがメモリ上にあり、ファイルが無圧縮(stored)で格納されている場合は
+ * アーカイブ内のデータの位置を返します。
+ *
+ * 戻り値
+ *  データの先頭ポインタを返します。
+ *  展開が必要な場合は NULL を返します。
+ */
+static const char* zip_stored_data(mz_zip_archive* zip_archive,
+                                   const char* zipptr,
+                                   size_t zipsize,
+                                   int file_index,
+                                   size_t* size)
+{
+    mz_zip_archive_file_stat st;
+    const mz_uint8* hdr;
+    mz_uint64 ofs;
+
+    if (zipptr == NULL || ! mz_zip_reader_file_stat(zip_archive, file_index, &st))
+        return NULL;
+    if (st.m_method != 0 || (st.m_bit_flag & 1) || st.m_comp_size != st.m_uncomp_size)
+        return NULL;    // 圧縮または暗号化されています。
+
+    ofs = st.m_local_header_ofs;
+    if (ofs + ZIP_LOCAL_HEADER_SIZE > zipsize)
+        return NULL;
+    hdr = (const mz_uint8*)zipptr + ofs;
+    if (ZIP_LE32(hdr) != ZIP_LOCAL_HEADER_SIG)
+        return NULL;
+    ofs += ZIP_LOCAL_HEADER_SIZE + ZIP_LE16(hdr + ZIP_LOCAL_FILENAME_LEN_OFS) +
+           ZIP_LE16(hdr + ZIP_LOCAL_EXTRA_LEN_OFS);
+    if (ofs + st.m_comp_size > zipsize)
+        return NULL;
+    *size = (size_t)st.m_comp_size;
+    return zipptr + ofs;
+}
+
+// 読み込み順
+static const int _read_order[] = {
+    AGENCY, AGENCY_JP, STOPS, ROUTES, ROUTES_JP, TRIPS, OFFICE_JP, STOP_TIMES,
+    CALENDAR, CALENDAR_DATES, FARE_ATTRIBUTES, FARE_RULES, SHAPES,
+    FREQUENCIES, TRANSFERS, TRANSLATIONS, FEED_INFO
+};
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[AGENCY], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_agency_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_AGENCY;
+#define GTFS_FILE_COUNT  (int)(sizeof(_read_order) / sizeof(int))
+
+/*
+ * zipアーカイブから一つのファイルを読み込みます。
+ *
+ * 戻り値
+ *  ファイルが存在して読み込めた場合はゼロを返します。
+ *  ファイルが存在しない場合は -1 を返します。
+ */
+static int gtfs_zip_file_reader(mz_zip_archive* zip_archive,
+                                const char* zipptr,
+                                size_t zipsize,
+                                int kind,
+                                struct gtfs_t* gtfs)
+{
+    struct column_map_t map;
+    mz_zip_archive_file_stat st;
+    const char* dataptr;
+    char* csvptr;
+    size_t csvsize;
+    int file_index;
+
+    file_index = mz_zip_reader_locate_file(zip_archive, g_gtfs_filename[kind], NULL, 0);
+    if (file_index < 0)
+        return -1;
+    dataptr = zip_stored_data(zip_archive, zipptr, zipsize, file_index, &csvsize);
+    if (dataptr) {
+        // 無圧縮の場合は展開せずにアーカイブのデータを直接解析します。
+        gtfs_mem_reader(dataptr, csvsize, kind, gtfs);
+        return 0;
     }
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[AGENCY_JP], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_agency_jp_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_AGENCY_JP;
+    if (mz_zip_reader_file_stat(zip_archive, file_index, &st))
+        table_reserve(gtfs, kind, (size_t)st.m_uncomp_size);
+
+    column_map_init(&map, kind);
+    if (kind == STOP_TIMES || kind == SHAPES)
+        return gtfs_zip_stream_reader(zip_archive, kind, &map, gtfs);
+
+    csvptr = mz_zip_reader_extract_to_heap(zip_archive, file_index, &csvsize, 0);
+    if (csvptr == NULL)
+        return -1;
+    if (csvsize > 0) {
+        int bomsize = (csvsize >= 3)? utf8_bom(csvptr) : 0;
+        gtfs_table_reader(csvptr+bomsize, csvsize-bomsize, &map, gtfs);
     }
+    mz_free(csvptr);
+    return 0;
+}
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[STOPS], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_stops_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_STOPS;
+/*
+ * 展開済みのディレクトリから一つのファイルを読み込みます。
+ * ファイルはメモリにマッピングしてコピーせずに解析します。
+ *
+ * 戻り値
+ *  ファイルが存在して読み込めた場合はゼロを返します。
+ *  ファイルが存在しない場合は -1 を返します。
+ */
+static int gtfs_dir_file_reader(const char* dirpath, int kind, struct gtfs_t* gtfs)
+{
+    char path[MAX_PATH];
+    char* csvptr;
+    int64 csvsize;
+
+    if (strlen(dirpath) + strlen(g_gtfs_filename[kind]) + 2 > sizeof(path))
+        return -1;
+    strcpy(path, dirpath);
+    catpath(path, g_gtfs_filename[kind]);
+    csvptr = file_map(path, &csvsize);
+    if (csvsize < 0)
+        return -1;
+    gtfs_mem_reader(csvptr, (size_t)csvsize, kind, gtfs);
+    file_unmap(csvptr, csvsize);
+    return 0;
+}
+
+/*
+ * 並列読み込み(-j)
+ *
+ * ファイルごとにワーカースレッドで展開と解析を行います。
+ * miniz のファイル読み込みは一つのアーカイブを複数スレッドから使用できないため、
+ * ワーカーごとにアーカイブを開きます。メモリ上のアーカイブ(マッピングしたファイル、
+ * httpで取得したデータ)は読み込み専用のため、同じ領域を共有します。
+ * テーブル(vector)とラベルはファイルごとに別の領域のため、読み込み中に競合しません。
+ * ファイルの存在情報はすべての読み込みが終わった後にまとめて設定します。
+ * 分割並列解析を行う大きなファイルは、スレッド数が -j を超えないように
+ * ファイルごとの並列読み込みが終わった後に一つずつ読み込みます。
+ */
+struct parallel_reader_t {
+    const char* zippath;        // zipファイル名または展開済みのディレクトリ
+    int is_dir;
+    const char* zipptr;         // メモリ上のzipデータ
+    size_t zipsize;
+    struct gtfs_t* gtfs;
+    unsigned int file_bits;     // 読み込むファイル(GTFS_FILE_*のビット)
+    int jobs[GTFS_FILE_COUNT];  // ジョブ番号→ファイル種別(サイズの大きい順)
+    int first_job;              // 並列に読み込む最初のジョブ(それより前は大きなファイル)
+    int exists[GTFS_FILE_COUNT];
+};
+
+static void parallel_reader_job(int job_no, int worker_no, void* arg)
+{
+    struct parallel_reader_t* pr = (struct parallel_reader_t*)arg;
+    mz_zip_archive zip_archive;
+    mz_bool done;
+    int kind;
+
+    (void)worker_no;    // 未使用
+    kind = pr->jobs[pr->first_job + job_no];
+    if (! (pr->file_bits & g_gtfs_filemap[kind]))
+        return;
+    if (pr->is_dir) {
+        if (gtfs_dir_file_reader(pr->zippath, kind, pr->gtfs) == 0)
+            pr->exists[kind] = 1;
+        return;
     }
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[ROUTES], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_routes_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_ROUTES;
+    memset(&zip_archive, '\0', sizeof(zip_archive));
+    if (pr->zipptr)
+        done = mz_zip_reader_init_mem(&zip_archive, pr->zipptr, pr->zipsize, 0);
+    else
+        done = mz_zip_reader_init_file(&zip_archive, pr->zippath, 0);
+    if (! done) {
+        err_write("%s: zip open error.\n", pr->zippath);
+        return;
     }
+    if (gtfs_zip_file_reader(&zip_archive, pr->zipptr, pr->zipsize, kind, pr->gtfs) == 0)
+        pr->exists[kind] = 1;
+    mz_zip_reader_end(&zip_archive);
+}
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[ROUTES_JP], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_routes_jp_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_ROUTES_JP;
+/*
+ * ファイルのサイズ(展開後)が大きい順にジョブを並べて並列に読み込みます。
+ * 分割並列解析を行う大きなファイルは、最後に一つずつ読み込みます。
+ */
+static void gtfs_parallel_reader(struct parallel_reader_t* pr, const mz_uint64* fsize)
+{
+    int nthreads;
+    int nlarge;
+    int i, j;
+
+    for (i = 0; i < GTFS_FILE_COUNT; i++) {
+        int kind = _read_order[i];
+
+        for (j = i; j > 0 && fsize[pr->jobs[j-1]] < fsize[kind]; j--)
+            pr->jobs[j] = pr->jobs[j-1];
+        pr->jobs[j] = kind;
     }
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[TRIPS], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_trips_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_TRIPS;
+    // サイズの大きい順のため、大きなファイルは先頭に並んでいます。
+    for (nlarge = 0; nlarge < GTFS_FILE_COUNT; nlarge++) {
+        if (fsize[pr->jobs[nlarge]] < CHUNK_PARSE_MIN_SIZE)
+            break;
     }
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[OFFICE_JP], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_office_jp_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_OFFICE_JP;
+    nthreads = (g_load_threads > 0)? g_load_threads : mt_cpu_count();
+    pr->first_job = nlarge;
+    mt_parallel(nthreads, GTFS_FILE_COUNT - nlarge, parallel_reader_job, pr);
+
+    // 大きなファイルはファイルの中を分割して並列に解析します。
+    pr->first_job = 0;
+    for (i = 0; i < nlarge; i++)
+        parallel_reader_job(i, 0, pr);
+
+    for (i = 0; i < GTFS_FILE_COUNT; i++) {
+        int kind = _read_order[i];
+        if (pr->exists[kind])
+            pr->gtfs->file_exist_bits |= g_gtfs_filemap[kind];
     }
+}
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[STOP_TIMES], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_stop_times_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_STOP_TIMES;
+static void gtfs_zip_parallel_reader(mz_zip_archive* zip_archive,
+                                     const char* zippath,
+                                     const char* zipptr,
+                                     size_t zipsize,
+                                     unsigned int file_bits,
+                                     struct gtfs_t* gtfs)
+{
+    struct parallel_reader_t pr;
+    mz_uint64 fsize[GTFS_FILE_COUNT];
+    int i;
+
+    memset(&pr, '\0', sizeof(pr));
+    pr.zippath = zippath;
+    pr.zipptr = zipptr;
+    pr.zipsize = zipsize;
+    pr.gtfs = gtfs;
+    pr.file_bits = file_bits;
+
+    for (i = 0; i < GTFS_FILE_COUNT; i++) {
+        int kind = _read_order[i];
+        int file_index;
+        mz_zip_archive_file_stat st;
+
+        fsize[kind] = 0;
+        file_index = mz_zip_reader_locate_file(zip_archive, g_gtfs_filename[kind], NULL, 0);
+        if (file_index >= 0 && mz_zip_reader_file_stat(zip_archive, file_index, &st))
+            fsize[kind] = st.m_uncomp_size;
     }
+    gtfs_parallel_reader(&pr, fsize);
+}
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[CALENDAR], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_calendar_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_CALENDAR;
+/*
+ * zipアーカイブから file_bits のファイルを読み込みます。
+ */
+static void gtfs_zip_files_reader(mz_zip_archive* zip_archive,
+                                  const char* zippath,
+                                  const char* zipptr,
+                                  size_t zipsize,
+                                  unsigned int file_bits,
+                                  struct gtfs_t* gtfs)
+{
+    int i;
+
+    if (g_load_threads != 1) {
+        gtfs_zip_parallel_reader(zip_archive, zippath, zipptr, zipsize, file_bits, gtfs);
+        return;
     }
+    for (i = 0; i < GTFS_FILE_COUNT; i++) {
+        int kind = _read_order[i];
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[CALENDAR_DATES], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_calendar_dates_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_CALENDAR_DATES;
+        if (! (file_bits & g_gtfs_filemap[kind]))
+            continue;
+        if (gtfs_zip_file_reader(zip_archive, zipptr, zipsize, kind, gtfs) == 0)
+            gtfs->file_exist_bits |= g_gtfs_filemap[kind];
     }
+}
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[FARE_ATTRIBUTES], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_fare_attributes_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_FARE_ATTRIBUTES;
+/*
+ * 展開済みのディレクトリから file_bits のファイルを読み込みます。
+ */
+static void gtfs_dir_reader(const char* dirpath, unsigned int file_bits, struct gtfs_t* gtfs)
+{
+    int i;
+
+    if (g_load_threads != 1) {
+        struct parallel_reader_t pr;
+        mz_uint64 fsize[GTFS_FILE_COUNT];
+
+        memset(&pr, '\0', sizeof(pr));
+        pr.zippath = dirpath;
+        pr.is_dir = 1;
+        pr.gtfs = gtfs;
+        pr.file_bits = file_bits;
+
+        for (i = 0; i < GTFS_FILE_COUNT; i++) {
+            int kind = _read_order[i];
+            char path[MAX_PATH];
+            struct stat sb;
+
+            fsize[kind] = 0;
+            if (strlen(dirpath) + strlen(g_gtfs_filename[kind]) + 2 > sizeof(path))
+                continue;
+            strcpy(path, dirpath);
+            catpath(path, g_gtfs_filename[kind]);
+            if (stat(path, &sb) == 0)
+                fsize[kind] = (mz_uint64)sb.st_size;
+        }
+        gtfs_parallel_reader(&pr, fsize);
+    } else {
+        for (i = 0; i < GTFS_FILE_COUNT; i++) {
+            int kind = _read_order[i];
+
+            if (! (file_bits & g_gtfs_filemap[kind]))
+                continue;
+            if (gtfs_dir_file_reader(dirpath, kind, gtfs) == 0)
+                gtfs->file_exist_bits |= g_gtfs_filemap[kind];
+        }
     }
+}
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[FARE_RULES], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_fare_rules_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_FARE_RULES;
+static int value_error_compare(const void* a, const void* b)
+{
+    const struct gtfs_value_error_t* ve1 = *(const struct gtfs_value_error_t**)a;
+    const struct gtfs_value_error_t* ve2 = *(const struct gtfs_value_error_t**)b;
+
+    if (ve1->kind != ve2->kind)
+        return ve1->kind - ve2->kind;
+    if (ve1->lineno != ve2->lineno)
+        return ve1->lineno - ve2->lineno;
+    return strcmp(ve1->column, ve2->column);
+}
+
+static void value_errors_sort(struct gtfs_t* gtfs)
+{
+    // 並列で読み込んだ場合も同じ順序で出力するために並べ替えます。
+    if (vect_count(gtfs->value_errors) > 1)
+        qsort(gtfs->value_errors->ptr, vect_count(gtfs->value_errors), sizeof(void*), value_error_compare);
+}
+
+/*
+ * スナップショットのキーとしてzipの内容を表すCRCを求めます。
+ * 中央ディレクトリの各ファイルの名前、CRC、展開後のサイズから求めるため、
+ * ファイルを展開せずに内容の変更を検出できます。
+ */
+static uint32 zip_content_key(mz_zip_archive* zip_archive)
+{
+    mz_ulong crc = MZ_CRC32_INIT;
+    mz_uint files, i;
+
+    files = mz_zip_reader_get_num_files(zip_archive);
+    for (i = 0; i < files; i++) {
+        mz_zip_archive_file_stat st;
+
+        if (! mz_zip_reader_file_stat(zip_archive, i, &st))
+            continue;
+        crc = mz_crc32(crc, (const mz_uint8*)st.m_filename, strlen(st.m_filename));
+        crc = mz_crc32(crc, (const mz_uint8*)&st.m_crc32, sizeof(st.m_crc32));
+        crc = mz_crc32(crc, (const mz_uint8*)&st.m_uncomp_size, sizeof(st.m_uncomp_size));
     }
+    return (uint32)crc;
+}
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[SHAPES], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_shapes_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_SHAPES;
+/*
+ * zipの各GTFSファイルの内容を表すキーを求めます。
+ * 中央ディレクトリのCRCと展開後のサイズから求めるため、ファイルを展開せずに
+ * ファイルごとの変更を検出できます。（整合性チェックのキャッシュで使用します）
+ */
+static void zip_file_keys(mz_zip_archive* zip_archive, struct gtfs_t* gtfs)
+{
+    int kind;
+
+    for (kind = 0; kind < GTFS_KIND_COUNT; kind++) {
+        mz_zip_archive_file_stat st;
+        mz_ulong crc = MZ_CRC32_INIT;
+        int file_index;
+
+        gtfs->file_keys[kind] = 0;
+        file_index = mz_zip_reader_locate_file(zip_archive, g_gtfs_filename[kind], NULL, 0);
+        if (file_index < 0 || ! mz_zip_reader_file_stat(zip_archive, file_index, &st))
+            continue;
+        crc = mz_crc32(crc, (const mz_uint8*)&st.m_crc32, sizeof(st.m_crc32));
+        crc = mz_crc32(crc, (const mz_uint8*)&st.m_uncomp_size, sizeof(st.m_uncomp_size));
+        gtfs->file_keys[kind] = (crc == 0)? 1 : (uint32)crc;
     }
+    gtfs->has_file_keys = 1;
+}
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[FREQUENCIES], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_frequencies_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_FREQUENCIES;
+/*
+ * GTFSを読み込みます。
+ * zippath には zipファイル、URL(http)、展開済みのディレクトリを指定できます。
+ * ローカルのzipファイルはメモリにマッピングして読み込みます。
+ * スナップショットを使用する場合(g_snapshot_dir)は、zipの内容が同じスナップショットが
+ * あればそれを読み込み、なければ読み込んだ後にスナップショットを作成します。
+ *
+ * 戻り値
+ *  正常に読み込めた場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+int gtfs_zip_archive_reader(const char* zippath, struct gtfs_t* gtfs)
+{
+    static mz_zip_archive zip_archive;
+    mz_bool done = 0;
+    char* resptr = NULL;
+    char* mapptr = NULL;
+    int64 mapsize = 0;
+    const char* zipptr = NULL;
+    size_t zipsize = 0;
+    int is_snapshot = 0;
+    uint32 key = 0;
+    const struct gtfs_columns_t* columns = g_gtfs_columns;
+    unsigned int file_bits = GTFS_FILE_ALL;
+
+    // 動作モードで使用しないファイルは読み込まずに、参照された時に読み込みます。
+    // URLの場合は再度取得することになるため、すべてのファイルを読み込みます。
+    if (g_gtfs_files && ! is_http_url(zippath) && strlen(zippath) < sizeof(gtfs->source_path)) {
+        file_bits = g_gtfs_files;
+        strcpy(gtfs->source_path, zippath);
+        gtfs->deferred_bits = GTFS_FILE_ALL & ~file_bits;
     }
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[TRANSFERS], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_transfers_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_TRANSFERS;
+    if (! is_http_url(zippath) && is_directory(zippath)) {
+        gtfs_dir_reader(zippath, file_bits, gtfs);
+        value_errors_sort(gtfs);
+        return 0;
     }
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[TRANSLATIONS], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_translations_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_TRANSLATIONS;
+    memset(&zip_archive, '\0', sizeof(zip_archive));
+    if (is_http_url(zippath)) {
+        size_t ressize;
+
+        resptr = url_request(zippath, &ressize);
+        if (resptr) {
+            int status;
+
+            status = url_http_status(resptr);
+            if (status == 200) {
+                zipptr = body_contents((const char*)resptr, ressize, &zipsize);
+                if (zipptr)
+                    done = mz_zip_reader_init_mem(&zip_archive, zipptr, zipsize, 0);
+            } else {
+                err_write("%s unsupport status=%d\n", zippath, status);
+            }
+        }
+    } else {
+        mapptr = file_map(zippath, &mapsize);
+        if (mapptr) {
+            zipptr = mapptr;
+            zipsize = (size_t)mapsize;
+            done = mz_zip_reader_init_mem(&zip_archive, zipptr, zipsize, 0);
+        } else {
+            done = mz_zip_reader_init_file(&zip_archive, zippath, 0);
+        }
+    }
+    if (! done) {
+        if (resptr)
+            recv_free(resptr);
+        file_unmap(mapptr, mapsize);
+        return -1;
+    }
+    zip_file_keys(&zip_archive, gtfs);
+
+    // 文字列プールのシンボルを復元するため、最初に読み込むGTFSだけが対象です。
+    if (g_snapshot_dir && mapptr && intern_count(g_gtfs_ids) == 0 && intern_count(g_gtfs_strs) == 0) {
+        key = zip_content_key(&zip_archive);
+        if (gtfs_snapshot_load(zippath, mapsize, key, gtfs) == 0) {
+            gtfs->deferred_bits = 0;
+            mz_zip_reader_end(&zip_archive);
+            file_unmap(mapptr, mapsize);
+            return 0;
+        }
+        // スナップショットはすべての動作モードで使用するため、すべてのファイルと項目を読み込みます。
+        is_snapshot = 1;
+        g_gtfs_columns = NULL;
+        file_bits = GTFS_FILE_ALL;
+        gtfs->deferred_bits = 0;
     }
 
-    csvptr = mz_zip_reader_extract_file_to_heap(&zip_archive, g_gtfs_filename[FEED_INFO], &csvsize, 0);
-    if (csvptr) {
-        int bomsize = utf8_bom(csvptr);
-        gtfs_feed_info_reader(csvptr+bomsize, csvsize-bomsize, gtfs);
-        mz_free(csvptr);
-        gtfs->file_exist_bits |= GTFS_FILE_FEED_INFO;
+    gtfs_zip_files_reader(&zip_archive, zippath, zipptr, zipsize, file_bits, gtfs);
+    value_errors_sort(gtfs);
+    if (is_snapshot) {
+        g_gtfs_columns = columns;
+        gtfs_snapshot_save(zippath, mapsize, key, gtfs);
     }
 
     done = mz_zip_reader_end(&zip_archive);
     if (resptr)
         recv_free(resptr);
+    file_unmap(mapptr, mapsize);
     return (done == MZ_TRUE)? 0 : -1;
 }
+
+/*
+ * 読み込みを後回しにしたファイルを読み込みます。
+ * 動作モードで使用するファイル(g_gtfs_files)以外は gtfs_zip_archive_reader() で
+ * 読み込まないため、それ以外のファイルを参照する場合に呼び出します。
+ * すでに読み込まれているファイルは何もしません。
+ * スレッドセーフではないため、テーブルを参照する前に呼び出してください。
+ *
+ * gtfs: GTFS構造体のポインタ
+ * file_bits: 読み込むファイル(GTFS_FILE_*のビット)
+ *
+ * 戻り値
+ *  正常に読み込めた場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+int gtfs_table_load(struct gtfs_t* gtfs, unsigned int file_bits)
+{
+    mz_zip_archive zip_archive;
+    char* mapptr;
+    int64 mapsize;
+    mz_bool done;
+    unsigned int bits;
+
+    bits = gtfs->deferred_bits & file_bits;
+    if (bits == 0)
+        return 0;
+    gtfs->deferred_bits &= ~bits;
+
+    if (is_directory(gtfs->source_path)) {
+        gtfs_dir_reader(gtfs->source_path, bits, gtfs);
+        value_errors_sort(gtfs);
+        return 0;
+    }
+
+    memset(&zip_archive, '\0', sizeof(zip_archive));
+    mapptr = file_map(gtfs->source_path, &mapsize);
+    if (mapptr)
+        done = mz_zip_reader_init_mem(&zip_archive, mapptr, (size_t)mapsize, 0);
+    else
+        done = mz_zip_reader_init_file(&zip_archive, gtfs->source_path, 0);
+    if (! done) {
+        err_write("%s: zip open error.\n", gtfs->source_path);
+        file_unmap(mapptr, mapsize);
+        return -1;
+    }
+    gtfs_zip_files_reader(&zip_archive, gtfs->source_path, mapptr, (size_t)mapsize, bits, gtfs);
+    value_errors_sort(gtfs);
+    mz_zip_reader_end(&zip_archive);
+    file_unmap(mapptr, mapsize);
+    return 0;
+}
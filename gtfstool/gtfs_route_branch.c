@@ -31,6 +31,7 @@ static void copy_fare_rules_route(const char* route_id, const char* new_route_id
     int count, i;
     
     count = vect_count(g_gtfs->fare_rules_tbl);
+    hash_reserve(g_gtfs_hash->fare_rules_htbl, count);
     for (i = 0; i < count; i++) {
         struct fare_rule_t* frule;
         
@@ -39,7 +40,7 @@ static void copy_fare_rules_route(const char* route_id, const char* new_route_id
             struct fare_rule_t* bfrule;
             char hkey[128];
 
-            bfrule = malloc(sizeof(struct fare_rule_t));
+            bfrule = gtfs_row_alloc(g_gtfs, FARE_RULES, sizeof(struct fare_rule_t));
             memcpy(bfrule, frule, sizeof(struct fare_rule_t));
             // 新しいroute_idでfare_ruleを追加
             strncpy(bfrule->route_id, new_route_id, sizeof(bfrule->route_id));
@@ -84,7 +85,7 @@ static void branch_route_id(const char* route_id, const char* trip_id)
     if (route) {
         struct route_t* broute;
         
-        broute = malloc(sizeof(struct route_t));
+        broute = gtfs_row_alloc(g_gtfs, ROUTES, sizeof(struct route_t));
         memcpy(broute, route, sizeof(struct route_t));
         // 新しいroute_idでrouteを追加
         strncpy(broute->route_id, branch_route_id, sizeof(broute->route_id));
@@ -105,64 +106,28 @@ static void branch_route_id(const char* route_id, const char* trip_id)
 static int check_route_stop_pattern()
 {
     int result = 0;
-    char** keylist;
-    char** keys;        // route_id
+    int route_no;
     
-    keylist = keys = hash_keylist(g_route_trips_htbl);
-    while (*keys) {
-        char* route_id;
-        struct vector_t* trips_tbl;
+    for (route_no = 0; route_no < g_route_trips.count; route_no++) {
+        const char* route_id;
+        struct trip_t** trips;
+        int* trip_nos;
         int count, i;
         int base_index = -1;
-        struct vector_t* base_stop_time_tbl = NULL;
-        int base_stops_count = 0;
+        int base_pattern = -1;
         
-        route_id = *keys;
-        trips_tbl = (struct vector_t*)hash_get(g_route_trips_htbl, route_id);
+        route_id = g_route_trips.routes[route_no]->route_id;
+        trips = gtfs_route_trip_list(route_no, &trip_nos, &count);
+        base_index = gtfs_trips_base_index(route_no);
+        if (base_index >= 0)
+            base_pattern = gtfs_trip_pattern(trip_nos[base_index]);
 
-        base_index = gtfs_trips_base_index(trips_tbl);
-        if (base_index >= 0) {
-            struct trip_t* trip;
-
-            trip = (struct trip_t*)vect_get(trips_tbl, base_index);
-            base_stop_time_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-            base_stops_count = vect_count(base_stop_time_tbl);
-        }
-
-        count = vect_count(trips_tbl);
         for (i = 0; i < count; i++) {
-            struct trip_t* trip;
-            struct vector_t* stop_time_tbl;
-            int stop_count, j;
-            
-            trip = (struct trip_t*)vect_get(trips_tbl, i);
-            stop_time_tbl = (struct vector_t*)hash_get(g_vehicle_timetable, trip->trip_id);
-            stop_count = vect_count(stop_time_tbl);
-            
-            if (base_stops_count != stop_count) {
-                // 新たなroute_idとして分割します。
-                branch_route_id(route_id, trip->trip_id);
-                continue;
-            }
-
-            // 停車パターンチェック
-            for (j = 0; j < stop_count; j++) {
-                struct stop_time_t* bst = NULL;
-                struct stop_time_t* st = NULL;
-
-                if (j < base_stops_count)
-                    bst = (struct stop_time_t*)vect_get(base_stop_time_tbl, j);
-                st = (struct stop_time_t*)vect_get(stop_time_tbl, j);
-                if (equals_stop_times_stop_id(bst, st) == 0) {
-                    // 新たなroute_idとして分割します。
-                    branch_route_id(route_id, st->trip_id);
-                    break;
-                }
-            }
+            // 停車数または停車パターンが基準の便と違う場合は新たなroute_idとして分割します。
+            if (gtfs_trip_pattern(trip_nos[i]) != base_pattern)
+                branch_route_id(route_id, trips[i]->trip_id);
         }
-        keys++;
     }
-    hash_list_free((void**)keylist);
     return result;
 }
 
@@ -190,6 +155,8 @@ static void output_gtfs()
     
     // GTFSファイルをzip形式でアーカイブ
     path_filename(zipname, g_gtfs_zip);
+    if (is_directory(g_gtfs_zip))
+        strcat(zipname, ".zip");    // 展開済みのディレクトリの場合
     gtfs_zip_archive_writer(g_output_dir, zipname, g_gtfs);
     gtfs_feed_delete(g_output_dir, g_gtfs);
 }
@@ -0,0 +1,391 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * The MIT License
+ *
+ * Copyright (c) 2018-2021 Val Laboratory Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "gtfstool.h"
+
+/*
+ * 読み込んだGTFSのスナップショット(.gtfsbin)
+ *
+ * 解析済みのテーブルのレコード、ラベル行、feed_info、値の書式エラー、
+ * IDと stop_times の任意項目の文字列プールをそのまま出力します。
+ * 次回以降は zip の内容(サイズと各ファイルのCRC)が同じ場合にスナップショットを
+ * メモリにマッピングして、テーブルのレコードとしてそのまま参照します。
+ * マッピングはコピーオンライトのため、レコードを書き換える処理(マージなど)でも
+ * スナップショットのファイルは変更されません。
+ *
+ * レコードの構造体の配置が変わった場合はバージョンまたはレコードサイズが
+ * 一致しないため、スナップショットを作り直します。
+ */
+
+#define SNAPSHOT_MAGIC      "GTFSBIN"
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_ALIGN      8
+#define SNAPSHOT_EXT        ".gtfsbin"
+
+struct snapshot_section_t {
+    int64 offset;               // ファイルの先頭からの位置
+    int64 size;                 // バイト数
+    int count;                  // レコード数
+    int rec_size;               // レコードのバイト数
+};
+
+struct snapshot_header_t {
+    char magic[8];
+    int version;
+    int header_size;
+    int64 source_size;          // zipファイルのサイズ
+    uint32 source_key;          // zipの各ファイルのCRCから求めたキー
+    uint32 file_exist_bits;
+    struct snapshot_section_t tables[GTFS_KIND_COUNT];
+    struct snapshot_section_t value_errors;
+    struct snapshot_section_t label;
+    struct snapshot_section_t feed_info;
+    struct snapshot_section_t ids;
+    struct snapshot_section_t strs;
+};
+
+// ファイル種別ごとのレコードのバイト数(feed_info.txtはテーブルを持たない)
+static const int _row_size[GTFS_KIND_COUNT] = {
+    (int)sizeof(struct agency_t),
+    (int)sizeof(struct stop_t),
+    (int)sizeof(struct route_t),
+    (int)sizeof(struct trip_t),
+    (int)sizeof(struct stop_time_t),
+    (int)sizeof(struct calendar_t),
+    (int)sizeof(struct calendar_date_t),
+    (int)sizeof(struct fare_attribute_t),
+    (int)sizeof(struct fare_rule_t),
+    (int)sizeof(struct shape_t),
+    (int)sizeof(struct frequency_t),
+    (int)sizeof(struct transfer_t),
+    0,
+    (int)sizeof(struct translation_t),
+    (int)sizeof(struct agency_jp_t),
+    (int)sizeof(struct route_jp_t),
+    (int)sizeof(struct office_jp_t)
+};
+
+/*
+ * スナップショットなどのキャッシュのファイル名を作成します。
+ * キャッシュディレクトリ(g_snapshot_dir)が NULL または空文字列の場合は入力ファイルと同じ場所に、
+ * それ以外はキャッシュディレクトリに「入力ファイル名(.zipを除く)+拡張子」で作成します。
+ *
+ * zippath: 入力のzipファイル名
+ * ext: 拡張子(.gtfsbinなど)
+ * path: ファイル名の格納先(MAX_PATH)
+ *
+ * 戻り値
+ *  path を返します。ファイル名が長すぎる場合は NULL を返します。
+ */
+char* gtfs_cache_path(const char* zippath, const char* ext, char* path)
+{
+    const char* name = zippath;
+    size_t len;
+
+    if (g_snapshot_dir && *g_snapshot_dir) {
+        const char* p = strrchr(zippath, '/');
+#ifdef _WIN32
+        const char* q = strrchr(zippath, '\\');
+        if (q && (p == NULL || q > p))
+            p = q;
+#endif
+        if (p)
+            name = p + 1;
+        if (strlen(g_snapshot_dir) + strlen(name) + strlen(ext) + 2 > MAX_PATH)
+            return NULL;
+        strcpy(path, g_snapshot_dir);
+        catpath(path, name);
+    } else {
+        if (strlen(zippath) + strlen(ext) + 1 > MAX_PATH)
+            return NULL;
+        strcpy(path, zippath);
+    }
+    len = strlen(path);
+    if (len > 4 && stricmp(path + len - 4, ".zip") == 0)
+        path[len-4] = '\0';
+    strcat(path, ext);
+    return path;
+}
+
+static int is_valid_section(const struct snapshot_section_t* sec, int64 file_size)
+{
+    return (sec->offset >= (int64)sizeof(struct snapshot_header_t) && sec->size >= 0 &&
+            sec->offset % SNAPSHOT_ALIGN == 0 && sec->offset + sec->size <= file_size);
+}
+
+static int is_valid_header(const struct snapshot_header_t* hdr,
+                           int64 file_size,
+                           int64 source_size,
+                           uint32 source_key)
+{
+    int kind;
+
+    if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        hdr->version != SNAPSHOT_VERSION ||
+        hdr->header_size != (int)sizeof(struct snapshot_header_t))
+        return 0;
+    if (hdr->source_size != source_size || hdr->source_key != source_key)
+        return 0;   // zipの内容が変わっています。
+
+    for (kind = 0; kind < GTFS_KIND_COUNT; kind++) {
+        const struct snapshot_section_t* sec = &hdr->tables[kind];
+
+        if (sec->rec_size != _row_size[kind] || ! is_valid_section(sec, file_size) ||
+            (int64)sec->count * sec->rec_size != sec->size)
+            return 0;
+    }
+    if (hdr->value_errors.rec_size != (int)sizeof(struct gtfs_value_error_t) ||
+        ! is_valid_section(&hdr->value_errors, file_size) ||
+        (int64)hdr->value_errors.count * hdr->value_errors.rec_size != hdr->value_errors.size)
+        return 0;
+    if (hdr->label.size != (int64)sizeof(struct gtfs_label_t) || ! is_valid_section(&hdr->label, file_size))
+        return 0;
+    if (hdr->feed_info.size != (int64)sizeof(struct feed_info_t) || ! is_valid_section(&hdr->feed_info, file_size))
+        return 0;
+    if (! is_valid_section(&hdr->ids, file_size) || ! is_valid_section(&hdr->strs, file_size))
+        return 0;
+    return 1;
+}
+
+/*
+ * スナップショットを読み込みます。
+ * テーブルのレコードはマッピングした領域を参照するため、領域は gtfs を
+ * 解放するまで保持します。
+ * 文字列プールは空の場合にだけ復元できます。
+ *
+ * zippath: 入力のzipファイル名
+ * source_size: zipファイルのサイズ
+ * source_key: zipの各ファイルのCRCから求めたキー
+ * gtfs: 格納先
+ *
+ * 戻り値
+ *  読み込めた場合はゼロを返します。
+ *  スナップショットがない場合、または古い場合は -1 を返します。
+ */
+int gtfs_snapshot_load(const char* zippath, int64 source_size, uint32 source_key, struct gtfs_t* gtfs)
+{
+    char path[MAX_PATH];
+    char* ptr;
+    int64 size;
+    const struct snapshot_header_t* hdr;
+    struct gtfs_mapping_t* mp;
+    int kind, i;
+
+    if (gtfs_cache_path(zippath, SNAPSHOT_EXT, path) == NULL)
+        return -1;
+    ptr = file_map_private(path, &size);
+    if (ptr == NULL)
+        return -1;
+
+    hdr = (const struct snapshot_header_t*)ptr;
+    if (size < (int64)sizeof(struct snapshot_header_t) ||
+        ! is_valid_header(hdr, size, source_size, source_key)) {
+        file_unmap(ptr, size);
+        return -1;
+    }
+
+    // 文字列プールを復元します。
+    if (intern_read(g_gtfs_ids, ptr + hdr->ids.offset, hdr->ids.size) < 0) {
+        file_unmap(ptr, size);
+        return -1;
+    }
+    if (intern_read(g_gtfs_strs, ptr + hdr->strs.offset, hdr->strs.size) < 0) {
+        err_write("%s: snapshot string pool error.\n", path);
+        file_unmap(ptr, size);
+        return -1;
+    }
+
+    for (kind = 0; kind < GTFS_KIND_COUNT; kind++) {
+        const struct snapshot_section_t* sec = &hdr->tables[kind];
+        struct vector_t* tbl;
+
+        if (kind == FEED_INFO)
+            continue;
+        tbl = *gtfs_table(gtfs, kind);
+        for (i = 0; i < sec->count; i++)
+            vect_append(tbl, ptr + sec->offset + (int64)i * sec->rec_size);
+    }
+    for (i = 0; i < hdr->value_errors.count; i++)
+        vect_append(gtfs->value_errors, ptr + hdr->value_errors.offset + (int64)i * hdr->value_errors.rec_size);
+    memcpy(&g_gtfs_label, ptr + hdr->label.offset, sizeof(struct gtfs_label_t));
+    memcpy(&g_feed_info, ptr + hdr->feed_info.offset, sizeof(struct feed_info_t));
+    gtfs->file_exist_bits |= hdr->file_exist_bits;
+
+    mp = (struct gtfs_mapping_t*)calloc(1, sizeof(struct gtfs_mapping_t));
+    mp->ptr = ptr;
+    mp->size = size;
+    mp->next = gtfs->mappings;
+    gtfs->mappings = mp;
+    return 0;
+}
+
+static int write_padding(FILE* fp, int64* pos)
+{
+    static const char zero[SNAPSHOT_ALIGN];
+    int n = (int)((SNAPSHOT_ALIGN - *pos % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN);
+
+    if (n > 0 && fwrite(zero, n, 1, fp) != 1)
+        return -1;
+    *pos += n;
+    return 0;
+}
+
+static int write_rows(FILE* fp, int64* pos, struct vector_t* tbl, int rec_size, struct snapshot_section_t* sec)
+{
+    int count, i;
+
+    if (write_padding(fp, pos) < 0)
+        return -1;
+    count = vect_count(tbl);
+    sec->offset = *pos;
+    sec->count = count;
+    sec->rec_size = rec_size;
+    sec->size = (int64)count * rec_size;
+    for (i = 0; i < count; i++) {
+        if (fwrite(vect_get(tbl, i), rec_size, 1, fp) != 1)
+            return -1;
+    }
+    *pos += sec->size;
+    return 0;
+}
+
+static int write_data(FILE* fp, int64* pos, const void* data, int size, struct snapshot_section_t* sec)
+{
+    if (write_padding(fp, pos) < 0)
+        return -1;
+    sec->offset = *pos;
+    sec->count = 1;
+    sec->rec_size = size;
+    sec->size = size;
+    if (fwrite(data, size, 1, fp) != 1)
+        return -1;
+    *pos += size;
+    return 0;
+}
+
+static int write_intern(FILE* fp, int64* pos, struct intern_t* in, struct snapshot_section_t* sec)
+{
+    int64 n;
+
+    if (write_padding(fp, pos) < 0)
+        return -1;
+    n = intern_write(in, fp);
+    if (n < 0)
+        return -1;
+    sec->offset = *pos;
+    sec->count = intern_count(in);
+    sec->size = n;
+    *pos += n;
+    return 0;
+}
+
+/*
+ * 読み込んだ直後のGTFSをスナップショットに出力します。
+ * 一時ファイルに出力してから名前を変更するため、出力中のスナップショットを
+ * 他のプロセスが読み込むことはありません。
+ *
+ * zippath: 入力のzipファイル名
+ * source_size: zipファイルのサイズ
+ * source_key: zipの各ファイルのCRCから求めたキー
+ * gtfs: 出力するGTFS
+ *
+ * 戻り値
+ *  出力できた場合はゼロを返します。
+ *  エラーの場合は -1 を返します。
+ */
+int gtfs_snapshot_save(const char* zippath, int64 source_size, uint32 source_key, struct gtfs_t* gtfs)
+{
+    char path[MAX_PATH];
+    char tmppath[MAX_PATH+8];
+    struct snapshot_header_t hdr;
+    FILE* fp;
+    int64 pos;
+    int kind;
+    int result = -1;
+
+    if (gtfs_cache_path(zippath, SNAPSHOT_EXT, path) == NULL)
+        return -1;
+    if (*g_snapshot_dir)
+        makedir(g_snapshot_dir);
+    snprintf(tmppath, sizeof(tmppath), "%s.%d", path, (int)getpid());
+    fp = fopen(tmppath, "wb");
+    if (fp == NULL) {
+        err_write("%s: snapshot create error.\n", tmppath);
+        return -1;
+    }
+
+    memset(&hdr, '\0', sizeof(hdr));
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.header_size = (int)sizeof(hdr);
+    hdr.source_size = source_size;
+    hdr.source_key = source_key;
+    hdr.file_exist_bits = gtfs->file_exist_bits;
+
+    // ヘッダは各領域の位置が決まった後に書き直します。
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+        goto final;
+    pos = sizeof(hdr);
+
+    for (kind = 0; kind < GTFS_KIND_COUNT; kind++) {
+        if (kind == FEED_INFO) {
+            if (write_padding(fp, &pos) < 0)
+                goto final;
+            hdr.tables[kind].offset = pos;
+            continue;
+        }
+        if (write_rows(fp, &pos, *gtfs_table(gtfs, kind), _row_size[kind], &hdr.tables[kind]) < 0)
+            goto final;
+    }
+    if (write_rows(fp, &pos, gtfs->value_errors, (int)sizeof(struct gtfs_value_error_t), &hdr.value_errors) < 0)
+        goto final;
+    if (write_data(fp, &pos, &g_gtfs_label, (int)sizeof(struct gtfs_label_t), &hdr.label) < 0)
+        goto final;
+    if (write_data(fp, &pos, &g_feed_info, (int)sizeof(struct feed_info_t), &hdr.feed_info) < 0)
+        goto final;
+    if (write_intern(fp, &pos, g_gtfs_ids, &hdr.ids) < 0)
+        goto final;
+    if (write_intern(fp, &pos, g_gtfs_strs, &hdr.strs) < 0)
+        goto final;
+
+    if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+        goto final;
+    result = 0;
+
+final:
+    if (fclose(fp) != 0)
+        result = -1;
+    if (result == 0) {
+#ifdef _WIN32
+        remove(path);
+#endif
+        if (rename(tmppath, path) != 0)
+            result = -1;
+    }
+    if (result < 0) {
+        err_write("%s: snapshot write error.\n", path);
+        remove(tmppath);
+    }
+    return result;
+}
@@ -105,7 +105,7 @@ static void extract_stops(struct hash_t* stop_id_htbl)
         stop = (struct stop_t*)vect_get(g_gtfs->stops_tbl, i);
         if (hash_get(stop_id_htbl, stop->stop_id)) {
             vect_append(_ext_gtfs->stops_tbl, stop);
-            if (atoi(stop->location_type) == 0 && strlen(stop->parent_station) > 0) {
+            if (stop->location_type_value == 0 && strlen(stop->parent_station) > 0) {
                 // 標柱で親停留所が設定されている場合
                 if (! hash_get(parent_htbl, stop->parent_station))
                     hash_put(parent_htbl, stop->parent_station, stop);
@@ -150,10 +150,10 @@ static void extract_stop_times(struct hash_t* trip_id_htbl)
         struct stop_time_t* st;
         
         st = (struct stop_time_t*)vect_get(g_gtfs->stop_times_tbl, i);
-        if (hash_get(trip_id_htbl, st->trip_id)) {
+        if (hash_get(trip_id_htbl, gtfs_id(st->trip_id))) {
             vect_append(_ext_gtfs->stop_times_tbl, st);
-            if (! hash_get(stop_id_htbl, st->stop_id))
-                hash_put(stop_id_htbl, st->stop_id, st);
+            if (! hash_get(stop_id_htbl, gtfs_id(st->stop_id)))
+                hash_put(stop_id_htbl, gtfs_id(st->stop_id), st);
         }
     }
     
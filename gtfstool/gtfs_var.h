@@ -103,4 +103,34 @@ extern
 #endif
 unsigned int g_proxy_port;
 
+#ifndef _MAIN
+extern
+#endif
+int g_load_threads;     // GTFSファイルを並列に読み込むスレッド数(0:CPU数)
+
+#ifndef _MAIN
+extern
+#endif
+const char* g_snapshot_dir;     // スナップショットの格納先(NULL:使用しない、空文字列:入力ファイルと同じ場所)
+
+#ifndef _MAIN
+extern
+#endif
+const struct gtfs_columns_t* g_gtfs_columns;    // 読み込む項目(NULL:すべての項目)
+
+#ifndef _MAIN
+extern
+#endif
+unsigned int g_gtfs_files;      // 読み込むファイル(GTFS_FILE_*のビット、0:すべてのファイル)
+
+#ifndef _MAIN
+extern
+#endif
+struct intern_t* g_gtfs_ids;    // IDの文字列プール(IDのシンボル)
+
+#ifndef _MAIN
+extern
+#endif
+struct intern_t* g_gtfs_strs;   // stop_timesの任意項目の文字列プール
+
 #endif /* _GTFS_VAR_H */
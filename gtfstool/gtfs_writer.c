@@ -34,21 +34,26 @@
 
 static int is_necessary_quote(const char* str)
 {
-    int index;
-
-    index = indexof(str, ',');
-    return (index < 0)? 0 : 1;
+    return (strpbrk(str, "\",\r\n") != NULL)? 1 : 0;
 }
 
+/*
+ * '"'、','、改行を含む文字列を '"' で囲み、埋め込まれた '"' を二重化します。
+ * qstr には QUOTED_SIZE(元のバッファサイズ) 以上の領域が必要です。
+ */
 char* add_quote(char* qstr, const char* str)
 {
-    *qstr = '\0';
     if (is_necessary_quote(str)) {
-        if (strlen(str) > 0) {
-            strcpy(qstr, "\"");
-            strcat(qstr, str);
-            strcat(qstr, "\"");
+        char* p = qstr;
+
+        *p++ = '"';
+        while (*str) {
+            if (*str == '"')
+                *p++ = '"';
+            *p++ = *str++;
         }
+        *p++ = '"';
+        *p = '\0';
     } else {
         strcpy(qstr, str);
     }
@@ -68,7 +73,7 @@ static void gtfs_agency_writer(const char* dir, struct vector_t* tbl)
     char csvpath[MAX_PATH];
     int count, i;
 
-    char agency_name[256];
+    char agency_name[QUOTED_SIZE(256)];
 
     strcpy(csvpath, dir);
     catpath(csvpath, g_gtfs_filename[AGENCY]);
@@ -106,12 +111,12 @@ static void gtfs_agency_jp_writer(const char* dir, struct vector_t* tbl)
     char csvpath[MAX_PATH];
     int count, i;
 
-    char agency_id[64];
-    char agency_official_name[256];
-    char agency_zip_number[16];
-    char agency_address[256];
-    char agency_president_pos[128];
-    char agency_president_name[128];
+    char agency_id[QUOTED_SIZE(GTFS_ID_SIZE)];
+    char agency_official_name[QUOTED_SIZE(256)];
+    char agency_zip_number[QUOTED_SIZE(64)];
+    char agency_address[QUOTED_SIZE(256)];
+    char agency_president_pos[QUOTED_SIZE(256)];
+    char agency_president_name[QUOTED_SIZE(256)];
     
     strcpy(csvpath, dir);
     catpath(csvpath, g_gtfs_filename[AGENCY_JP]);
@@ -165,7 +170,7 @@ static void gtfs_stops_writer(const char* dir, struct vector_t* tbl)
     count = vect_count(tbl);
     for (i = 0; i < count; i++) {
         struct stop_t* s;
-        char stop_name[MAX_STATION_NAME*2];
+        char stop_name[QUOTED_SIZE(MAX_STATION_NAME)];
 
         s = (struct stop_t*)vect_get(tbl, i);
 
@@ -205,9 +210,9 @@ static void gtfs_routes_writer(const char* dir, struct vector_t* tbl)
     count = vect_count(tbl);
     for (i = 0; i < count; i++) {
         struct route_t* r;
-        char route_short_name[MAX_RAIL_NAME];
-        char route_long_name[MAX_RAIL_NAME];
-        char route_desc[256];
+        char route_short_name[QUOTED_SIZE(MAX_RAIL_NAME)];
+        char route_long_name[QUOTED_SIZE(512)];
+        char route_desc[QUOTED_SIZE(256)];
 
         r = (struct route_t*)vect_get(tbl, i);
 
@@ -250,9 +255,9 @@ static void gtfs_trips_writer(const char* dir, struct vector_t* tbl)
     count = vect_count(tbl);
     for (i = 0; i < count; i++) {
         struct trip_t* t;
-        char trip_headsign[256];
-        char trip_short_name[256];
-        char jp_trip_desc[512];
+        char trip_headsign[QUOTED_SIZE(256)];
+        char trip_short_name[QUOTED_SIZE(256)];
+        char jp_trip_desc[QUOTED_SIZE(256)];
         
         t = (struct trip_t*)vect_get(tbl, i);
         
@@ -294,16 +299,25 @@ static void gtfs_stop_times_writer(const char* dir, struct vector_t* tbl)
     count = vect_count(tbl);
     for (i = 0; i < count; i++) {
         struct stop_time_t* s;
-        char headsign[256];
+        char headsign[QUOTED_SIZE(256)];
+        char arrv[ST_TEXT_SIZE], dept[ST_TEXT_SIZE], seq[ST_TEXT_SIZE];
+        char pickup[ST_TEXT_SIZE], drop_off[ST_TEXT_SIZE];
         
         s = (struct stop_time_t*)vect_get(tbl, i);
         
-        add_quote(headsign, s->stop_headsign);
+        add_quote(headsign, gtfs_stop_time_text(s, ST_STOP_HEADSIGN, NULL));
         
         csv_write("%s,%s,%s,%s,%s,%s,%s,%s,%s,%s%s",
-                  s->trip_id, s->arrival_time, s->departure_time, s->stop_id,
-                  s->stop_sequence, headsign, s->pickup_type, s->drop_off_type,
-                  s->shape_dist_traveled, s->timepoint,
+                  gtfs_id(s->trip_id),
+                  gtfs_stop_time_text(s, ST_ARRIVAL_TIME, arrv),
+                  gtfs_stop_time_text(s, ST_DEPARTURE_TIME, dept),
+                  gtfs_id(s->stop_id),
+                  gtfs_stop_time_text(s, ST_STOP_SEQUENCE, seq),
+                  headsign,
+                  gtfs_stop_time_text(s, ST_PICKUP_TYPE, pickup),
+                  gtfs_stop_time_text(s, ST_DROP_OFF_TYPE, drop_off),
+                  gtfs_stop_time_text(s, ST_SHAPE_DIST_TRAVELED, NULL),
+                  gtfs_stop_time_text(s, ST_TIMEPOINT, NULL),
                   CRLF);
     }
     
@@ -555,12 +569,12 @@ static void gtfs_feed_info_writer(const char* dir, struct feed_info_t* feed_info
 {
     char csvpath[MAX_PATH];
     
-    char feed_publisher_name[256];
-    char feed_publisher_url[256];
-    char feed_lang[4];
-    char feed_start_date[16];
-    char feed_end_date[16];
-    char feed_version[256];
+    char feed_publisher_name[QUOTED_SIZE(256)];
+    char feed_publisher_url[QUOTED_SIZE(256)];
+    char feed_lang[QUOTED_SIZE(64)];
+    char feed_start_date[QUOTED_SIZE(64)];
+    char feed_end_date[QUOTED_SIZE(64)];
+    char feed_version[QUOTED_SIZE(256)];
     
     strcpy(csvpath, dir);
     catpath(csvpath, g_gtfs_filename[FEED_INFO]);
@@ -604,8 +618,8 @@ static void gtfs_old_translations_writer(const char* dir, struct vector_t* tbl)
     count = vect_count(tbl);
     for (i = 0; i < count; i++) {
         struct translation_t* t;
-        char trans_id[256];
-        char translation[512];
+        char trans_id[QUOTED_SIZE(256)];
+        char translation[QUOTED_SIZE(512)];
 
         t = (struct translation_t*)vect_get(tbl, i);
 
@@ -641,8 +655,8 @@ static void gtfs_translations_writer(const char* dir, struct vector_t* tbl)
     count = vect_count(tbl);
     for (i = 0; i < count; i++) {
         struct translation_t* t;
-        char trans_id[256];
-        char translation[512];
+        char trans_id[QUOTED_SIZE(256)];
+        char translation[QUOTED_SIZE(512)];
 
         t = (struct translation_t*)vect_get(tbl, i);
 
@@ -716,7 +730,7 @@ static void gtfs_office_jp_writer(const char* dir, struct vector_t* tbl)
     count = vect_count(tbl);
     for (i = 0; i < count; i++) {
         struct office_jp_t* o;
-        char office_name[256];
+        char office_name[QUOTED_SIZE(256)];
 
         o = (struct office_jp_t*)vect_get(tbl, i);
 
@@ -24,6 +24,84 @@
  */
 #include "gtfstool.h"
 
+// 診断メッセージの出力先（NULL:標準出力）
+#ifdef _WIN32
+static __declspec(thread) struct gtfs_report_t* _report = NULL;
+#else
+static __thread struct gtfs_report_t* _report = NULL;
+#endif
+
+static void report_write(const char* level, const char* msg)
+{
+    if (_report) {
+        mb_append(_report->mb, level, (int)strlen(level));
+        mb_append(_report->mb, " ", 1);
+        mb_append(_report->mb, msg, (int)strlen(msg));
+        mb_append(_report->mb, "\n", 1);
+    } else {
+        printf("%s %s\n", level, msg);
+    }
+}
+
+/*
+ * 呼び出したスレッドの診断メッセージをバッファに出力するようにします。
+ * gtfs_report_end() を呼び出すまでのエラーと警告の件数もバッファで数えます。
+ *
+ * rp: 診断メッセージのバッファ
+ */
+void gtfs_report_begin(struct gtfs_report_t* rp)
+{
+    rp->mb = mb_alloc(4096);
+    rp->error_count = 0;
+    rp->warning_count = 0;
+    rp->prev = _report;
+    _report = rp;
+}
+
+/*
+ * 呼び出したスレッドの診断メッセージを gtfs_report_begin() の前の出力先に戻します。
+ */
+void gtfs_report_end()
+{
+    if (_report)
+        _report = _report->prev;
+}
+
+/*
+ * バッファの診断メッセージを呼び出したスレッドの出力先に出力して、件数を加算します。
+ * 呼び出したスレッドもバッファに出力している場合はそのバッファに追加します。
+ * 出力したバッファは解放されます。
+ *
+ * rp: 診断メッセージのバッファ
+ */
+void gtfs_report_flush(struct gtfs_report_t* rp)
+{
+    if (! rp->mb)
+        return;
+    if (_report) {
+        mb_append(_report->mb, rp->mb->buf, rp->mb->size);
+        _report->error_count += rp->error_count;
+        _report->warning_count += rp->warning_count;
+    } else {
+        if (rp->mb->size > 0)
+            fwrite(rp->mb->buf, 1, rp->mb->size, stdout);
+        g_error_count += rp->error_count;
+        g_warning_count += rp->warning_count;
+    }
+    gtfs_report_discard(rp);
+}
+
+/*
+ * バッファの診断メッセージを出力せずに解放します。
+ *
+ * rp: 診断メッセージのバッファ
+ */
+void gtfs_report_discard(struct gtfs_report_t* rp)
+{
+    mb_free(rp->mb);
+    rp->mb = NULL;
+}
+
 int gtfs_fatal_error(const char* fmt, ...)
 {
     char outbuf[1024];
@@ -31,7 +109,7 @@ int gtfs_fatal_error(const char* fmt, ...)
     
     va_start(argptr, fmt);
     vsnprintf(outbuf, sizeof(outbuf), fmt, argptr);
-    printf("[致命的エラー] %s\n", outbuf);
+    report_write("[致命的エラー]", outbuf);
     return GTFS_FATAL_ERROR;
 }
 
@@ -42,8 +120,11 @@ int gtfs_error(const char* fmt, ...)
     
     va_start(argptr, fmt);
     vsnprintf(outbuf, sizeof(outbuf), fmt, argptr);
-    printf("[エラー] %s\n", outbuf);
-    mt_increment(&g_error_count);
+    report_write("[エラー]", outbuf);
+    if (_report)
+        _report->error_count++;
+    else
+        mt_increment(&g_error_count);
     return GTFS_ERROR;
 }
 
@@ -57,13 +138,19 @@ int gtfs_warning(const char* fmt, ...)
 
     va_start(argptr, fmt);
     vsnprintf(outbuf, sizeof(outbuf), fmt, argptr);
-    printf("[警告] %s\n", outbuf);
-    mt_increment(&g_warning_count);
+    report_write("[警告]", outbuf);
+    if (_report)
+        _report->warning_count++;
+    else
+        mt_increment(&g_warning_count);
     return GTFS_WARNING;
 }
 
 int is_gtfs_file_exist(struct gtfs_t* gtfs, unsigned int file_kind)
 {
+    // 読み込みを後回しにしたファイルはここで読み込みます。
+    if (gtfs->deferred_bits & file_kind)
+        gtfs_table_load(gtfs, file_kind);
     return (gtfs->file_exist_bits & file_kind);
 }
 
@@ -36,10 +36,8 @@
 #define MAX_PATH  PATH_MAX
 #endif
 
-#ifdef _MAIN
 #define PROGRAM_NAME        "gtfstool"
 #define PROGRAM_VERSION     "1.1"
-#endif
 
 #define GTFS_SUCCESS        0
 #define GTFS_FATAL_ERROR    (-2)
@@ -60,6 +58,62 @@ struct merge_gtfs_prefix_t {
     char prefix[256];
 };
 
+// 診断メッセージのバッファ（gtfs_report_begin〜gtfs_report_end の間のスレッドの出力）
+struct gtfs_report_t {
+    struct membuf_t* mb;                // 出力する文字列
+    long error_count;                   // エラー件数
+    long warning_count;                 // 警告件数
+    struct gtfs_report_t* prev;         // gtfs_report_begin() の前の出力先
+};
+
+// 便ごとの通過時刻表（便番号 0..count-1 で参照します）
+// 便番号 n の通過時刻は stop_times[offsets[n]] から stop_times[offsets[n+1]-1] までです。
+struct trip_timetable_t {
+    int count;                          // 便の数
+    struct trip_t** trips;              // 便番号 → trips.txtで最初に現れた便
+    int* offsets;                       // 便ごとの通過時刻の開始位置（count+1個）
+    struct stop_time_t** stop_times;    // 便ごとに stop_sequence の順に並べた通過時刻
+    struct hash_t* trip_no_htbl;        // key:trip_id value:便番号+1
+    int* sym_trip_no;                   // trip_idのシンボル → 便番号（-1:便なし）
+    int sym_count;                      // sym_trip_no の要素数
+};
+
+// 経路ごとの便（経路番号 0..count-1 で参照します）
+// 経路番号 n の便は trips[offsets[n]] から trips[offsets[n+1]-1] までです。
+struct route_trips_t {
+    int count;                          // 経路の数
+    struct route_t** routes;            // 経路番号 → routes.txtで最初に現れた経路
+    int* offsets;                       // 経路ごとの便の開始位置（count+1個）
+    struct trip_t** trips;              // 経路ごとに trips.txt の順に並べた便
+    int* trip_nos;                      // trips の便番号
+    int* base_index;                    // 経路ごとの基準となる便の位置（-1:便なし）
+    struct hash_t* route_no_htbl;       // key:route_id value:経路番号+1
+};
+
+// 停車パターン（停留所の並びが同じ便をひとつにまとめます）
+struct stop_pattern_t {
+    uint64 fingerprint;                 // 停留所の並びのハッシュ値
+    int trip_no;                        // 最初に現れた便（停留所の並びの参照用）
+    int stop_count;                     // 停車数
+    int trip_count;                     // パターンの便の数
+};
+
+// 停車パターン表（パターン番号 0..count-1 で参照します）
+struct stop_pattern_table_t {
+    int count;                          // パターンの数
+    struct stop_pattern_t* patterns;    // パターン番号 → 停車パターン
+    int* trip_pattern;                  // 便番号 → パターン番号
+};
+
+// 停留所ごとの参照件数（停留所番号 0..count-1 で参照します）
+struct stop_usage_t {
+    int count;                          // 停留所の数
+    struct stop_t** stops;              // 停留所番号 → stops.txtで最初に現れた停留所
+    int* stop_times_count;              // stop_times.txtで参照されている件数
+    int* child_count;                   // parent_stationとして参照されている件数
+    struct hash_t* stop_no_htbl;        // key:stop_id value:停留所番号+1
+};
+
 // macros
 #define TRACE(fmt, ...) \
 if (g_trace_mode) { \
@@ -147,12 +201,22 @@ char g_gtfs_zip[256];
 #ifndef _MAIN
 extern
 #endif
-struct hash_t* g_vehicle_timetable;     // key:trip_id value:pointer of vector(struct stop_time_t)
+struct trip_timetable_t g_vehicle_timetable;    // 便ごとの通過時刻表
 
 #ifndef _MAIN
 extern
 #endif
-struct hash_t* g_route_trips_htbl;     // ket:route_id value:pointer of vector(struct trip_t)
+struct route_trips_t g_route_trips;     // 経路ごとの便
+
+#ifndef _MAIN
+extern
+#endif
+struct stop_usage_t g_stop_usage;       // 停留所ごとの参照件数
+
+#ifndef _MAIN
+extern
+#endif
+struct stop_pattern_table_t g_stop_patterns;    // 便ごとの停車パターン
 
 #ifndef _MAIN
 extern
@@ -297,6 +361,11 @@ extern
 #endif
 int g_same_stops_fare_rule_check;
 
+#ifndef _MAIN
+extern
+#endif
+int g_check_cache;      // 整合性チェックの結果をキャッシュ(.gtfschk)する場合は1
+
 // prototypes
 #ifdef __cplusplus
 extern "C" {
@@ -305,6 +374,7 @@ extern "C" {
 // main.c
 struct gtfs_t* gtfs_alloc(void);
 void gtfs_free(struct gtfs_t* gtfs, int is_element_free);
+void gtfs_move_rows(struct gtfs_t* dst, struct gtfs_t* src);
 struct gtfs_hash_t* gtfs_hash_alloc(void);
 void gtfs_hash_free(struct gtfs_hash_t* gtfs_hash);
 
@@ -315,6 +385,10 @@ int merge_config(const char* conf_fname);
 int gtfs_fatal_error(const char* fmt, ...);
 int gtfs_error(const char* fmt, ...);
 int gtfs_warning(const char* fmt, ...);
+void gtfs_report_begin(struct gtfs_report_t* rp);
+void gtfs_report_end(void);
+void gtfs_report_flush(struct gtfs_report_t* rp);
+void gtfs_report_discard(struct gtfs_report_t* rp);
 int is_gtfs_file_exist(struct gtfs_t* gtfs, unsigned int file_kind);
 char* utf8_conv(const char* str, char* enc_buf, int enc_bufsize);
 
@@ -323,12 +397,29 @@ char* fare_rule_key(const char* route_id, const char* origin_id, const char* des
 int gtfs_hash_table_key_check(void);
 int gtfs_vehicle_timetable(void);
 int gtfs_route_trips(void);
-int gtfs_trips_base_index(struct vector_t* trips_tbl);
+void gtfs_timetable_free(void);
+int gtfs_trip_no(const char* trip_id);
+struct stop_time_t** gtfs_trip_timetable(int trip_no, int* count);
+int gtfs_route_no(const char* route_id);
+struct trip_t** gtfs_route_trip_list(int route_no, int** trip_nos, int* count);
+int gtfs_trips_base_index(int route_no);
+int gtfs_trip_pattern(int trip_no);
+struct stop_pattern_t* gtfs_stop_pattern(int pattern_no);
+int gtfs_stop_no(const char* stop_id);
+int gtfs_stop_times_use_count(const char* stop_id);
+int gtfs_stop_child_count(const char* stop_id);
 int equals_stop_times_stop_id(struct stop_time_t* bst, struct stop_time_t* st);
 int is_pickup_stop(struct stop_time_t* st);
 int is_dropoff_stop(struct stop_time_t* st);
 int gtfs_check(void);
 
+// gtfs_check_cache.c
+int gtfs_check_cache_open(const char* zippath, struct gtfs_t* gtfs);
+uint32 gtfs_check_cache_key(unsigned int file_bits);
+int gtfs_check_cache_replay(const char* title, uint32 deps_key, struct gtfs_report_t* rp, int* result);
+void gtfs_check_cache_put(const char* title, uint32 deps_key, struct gtfs_report_t* rp, int result);
+int gtfs_check_cache_close(const char* zippath);
+
 // gtfs_split.c
 int gtfs_split(void);
 
@@ -35,7 +35,7 @@ static void version()
 static void usage()
 {
     version();
-    fprintf(stdout, "\n使い方: %s [action] [options]  gtfs.zip ...\n", PROGRAM_NAME);
+    fprintf(stdout, "\n使い方: %s [action] [options]  gtfs.zip|gtfs_dir ...\n", PROGRAM_NAME);
     fprintf(stdout, "action:  [-c] GTFS-JPの整合性チェックを行います(default)\n");
     fprintf(stdout, "         [-d] GTFS-JPのルート別にバス時刻表を表示します\n");
     fprintf(stdout, "         [-u] GTFS-JPのルート別の運賃三角表を表示します\n");
@@ -51,6 +51,14 @@ static void usage()
     fprintf(stdout, "         [-a] 発着が同じバス停名でも運賃区間が登録されているかチェックします\n");
     fprintf(stdout, "         [-p proxy_server:port] プロキシサーバとポート番号を指定します\n");
     fprintf(stdout, "         [-e error_file] システムエラーを出力するファイルを指定します\n");
+    fprintf(stdout, "         [-j threads] GTFS-JPの読み込みと整合性チェックを並列に実行する\n"
+                    "              スレッド数を指定します(0はCPU数、省略時は1)\n");
+    fprintf(stdout, "         [-k] 読み込んだGTFS-JPをzipと同じ場所のスナップショット(.gtfsbin)に\n"
+                    "              保存して、zipが変更されていなければ次回から使用します\n");
+    fprintf(stdout, "         [-K cache_dir] スナップショットを保存するディレクトリを指定します\n");
+    fprintf(stdout, "         [-C] 整合性チェックの結果をzipと同じ場所(-Kの指定がある場合はcache_dir)の\n"
+                    "              キャッシュ(.gtfschk)に保存して、次回から変更されていないファイル\n"
+                    "              だけに依存するチェックは前回の結果を出力します\n");
     fprintf(stdout, "         [-t] トレースモードをオンにして実行します\n");
 }
 
@@ -63,11 +71,17 @@ static int startup()
 
     /* エラーファイルの初期化 */
     err_initialize(g_error_file);
+
+    /* IDの文字列プールの初期化 */
+    g_gtfs_ids = intern_initialize();
+    g_gtfs_strs = intern_initialize();
     return 0;
 }
 
 static void cleanup()
 {
+    intern_finalize(g_gtfs_strs);
+    intern_finalize(g_gtfs_ids);
     err_finalize();
     sock_finalize();
     mt_finalize();
@@ -94,6 +108,7 @@ struct gtfs_t* gtfs_alloc()
     gtfs->transfers_tbl = vect_initialize(100);
     gtfs->routes_jp_tbl = vect_initialize(300);
     gtfs->office_jp_tbl = vect_initialize(20);
+    gtfs->value_errors = vect_initialize(16);
     return gtfs;
 }
 
@@ -109,7 +124,7 @@ struct gtfs_hash_t* gtfs_hash_alloc()
     gtfs_hash->calendar_htbl = hash_initialize(41);
     gtfs_hash->calendar_dates_htbl = hash_initialize(211);
     gtfs_hash->fare_attrs_htbl = hash_initialize(1009);
-    gtfs_hash->fare_rules_htbl = hash_initialize(999983);
+    gtfs_hash->fare_rules_htbl = hash_initialize(1009);
     gtfs_hash->translations_htbl = hash_initialize(1009);
     gtfs_hash->routes_jp_htbl = hash_initialize(307);
     return gtfs_hash;
@@ -120,9 +135,6 @@ static void init_gtfs()
     g_gtfs = gtfs_alloc();
     g_gtfs_hash = gtfs_hash_alloc();
 
-    g_vehicle_timetable = hash_initialize(1009);
-    g_route_trips_htbl = hash_initialize(1009);
-
     g_error_count = 0;
     g_warning_count = 0;
 }
@@ -141,104 +153,86 @@ static void vector_elements_free(struct vector_t* vect)
     }
 }
 
-static void hash_elements_free(struct hash_t* hash)
-{
-    void** ptbl = hash_list(hash);
-    if (ptbl) {
-        int i = 0;
-        
-        while (ptbl[i]) {
-            vect_finalize(ptbl[i++]);
-        }
-        hash_list_free(ptbl);
-    }
-}
-
 void gtfs_free(struct gtfs_t* gtfs, int is_element_free)
 {
-    if (gtfs->agency_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->agency_tbl);
+    if (gtfs->agency_tbl)
         vect_finalize(gtfs->agency_tbl);
-    }
-    if (gtfs->agency_jp_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->agency_jp_tbl);
+    if (gtfs->agency_jp_tbl)
         vect_finalize(gtfs->agency_jp_tbl);
-    }
-    if (gtfs->routes_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->routes_tbl);
+    if (gtfs->routes_tbl)
         vect_finalize(gtfs->routes_tbl);
-    }
-    if (gtfs->stops_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->stops_tbl);
+    if (gtfs->stops_tbl)
         vect_finalize(gtfs->stops_tbl);
-    }
-    if (gtfs->fare_rules_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->fare_rules_tbl);
+    if (gtfs->fare_rules_tbl)
         vect_finalize(gtfs->fare_rules_tbl);
-    }
-    if (gtfs->fare_attrs_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->fare_attrs_tbl);
+    if (gtfs->fare_attrs_tbl)
         vect_finalize(gtfs->fare_attrs_tbl);
-    }
-    if (gtfs->trips_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->trips_tbl);
+    if (gtfs->trips_tbl)
         vect_finalize(gtfs->trips_tbl);
-    }
-    if (gtfs->stop_times_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->stop_times_tbl);
+    if (gtfs->stop_times_tbl)
         vect_finalize(gtfs->stop_times_tbl);
-    }
-    if (gtfs->calendar_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->calendar_tbl);
+    if (gtfs->calendar_tbl)
         vect_finalize(gtfs->calendar_tbl);
-    }
-    if (gtfs->calendar_dates_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->calendar_dates_tbl);
+    if (gtfs->calendar_dates_tbl)
         vect_finalize(gtfs->calendar_dates_tbl);
-    }
-    if (gtfs->translations_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->translations_tbl);
+    if (gtfs->translations_tbl)
         vect_finalize(gtfs->translations_tbl);
-    }
-    if (gtfs->shapes_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->shapes_tbl);
+    if (gtfs->shapes_tbl)
         vect_finalize(gtfs->shapes_tbl);
-    }
-    if (gtfs->frequencies_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->frequencies_tbl);
+    if (gtfs->frequencies_tbl)
         vect_finalize(gtfs->frequencies_tbl);
-    }
-    if (gtfs->transfers_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->transfers_tbl);
+    if (gtfs->transfers_tbl)
         vect_finalize(gtfs->transfers_tbl);
-    }
-    if (gtfs->routes_jp_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->routes_jp_tbl);
+    if (gtfs->routes_jp_tbl)
         vect_finalize(gtfs->routes_jp_tbl);
-    }
-    if (gtfs->office_jp_tbl) {
-        if (is_element_free)
-            vector_elements_free(gtfs->office_jp_tbl);
+    if (gtfs->office_jp_tbl)
         vect_finalize(gtfs->office_jp_tbl);
+    if (gtfs->value_errors)
+        vect_finalize(gtfs->value_errors);
+    if (is_element_free) {
+        struct gtfs_mapping_t* mp;
+        int i;
+
+        // レコードはアリーナごとにまとめて解放します。
+        for (i = 0; i < GTFS_KIND_COUNT; i++)
+            arena_finalize(gtfs->row_arena[i]);
+        mp = gtfs->mappings;
+        while (mp) {
+            struct gtfs_mapping_t* next = mp->next;
+            file_unmap(mp->ptr, mp->size);
+            free(mp);
+            mp = next;
+        }
     }
     free(gtfs);
 }
 
+/*
+ * src のレコードの領域を dst に移します。
+ * src のテーブルのレコードは dst を解放するまで有効です。
+ */
+void gtfs_move_rows(struct gtfs_t* dst, struct gtfs_t* src)
+{
+    int i;
+
+    for (i = 0; i < GTFS_KIND_COUNT; i++) {
+        if (src->row_arena[i]) {
+            if (dst->row_arena[i] == NULL)
+                dst->row_arena[i] = arena_initialize(0);
+            arena_move(dst->row_arena[i], src->row_arena[i]);
+        }
+    }
+    if (src->mappings) {
+        struct gtfs_mapping_t* tail;
+
+        for (tail = src->mappings; tail->next; tail = tail->next)
+            ;
+        tail->next = dst->mappings;
+        dst->mappings = src->mappings;
+        src->mappings = NULL;
+    }
+}
+
 void gtfs_hash_free(struct gtfs_hash_t* gtfs_hash)
 {
     if (gtfs_hash->agency_htbl)
@@ -276,14 +270,7 @@ void gtfs_hash_free(struct gtfs_hash_t* gtfs_hash)
 
 static void final_gtfs()
 {
-    if (g_vehicle_timetable) {
-        hash_elements_free(g_vehicle_timetable);
-        hash_finalize(g_vehicle_timetable);
-    }
-    if (g_route_trips_htbl) {
-        hash_elements_free(g_route_trips_htbl);
-        hash_finalize(g_route_trips_htbl);
-    }
+    gtfs_timetable_free();
 
     if (g_gtfs_hash)
         gtfs_hash_free(g_gtfs_hash);
@@ -304,6 +291,7 @@ static int args(int argc, const char * argv[])
     g_exec_mode = GTFS_CHECK_MODE;
     g_ignore_warning = 0;
     g_same_stops_fare_rule_check = 0;
+    g_load_threads = 1;
 
     for (i = 1; i < argc; i++) {
         if (argv[i][0] == '-') {
@@ -325,6 +313,25 @@ static int args(int argc, const char * argv[])
                         g_proxy_server[index] = '\0';
                     }
                 }
+            } else if (strcmp(argv[i], "-j") == 0) {
+                // 0以上の整数のみ受け付けます（0はCPU数）
+                if (i < argc-1 && *argv[i+1] != '\0' && isdigitstr(argv[i+1])) {
+                    g_load_threads = atoi(argv[++i]);
+                } else {
+                    usage();
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "-k") == 0) {
+                g_snapshot_dir = "";
+            } else if (strcmp(argv[i], "-K") == 0) {
+                if (i < argc-1) {
+                    g_snapshot_dir = argv[++i];
+                } else {
+                    usage();
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "-C") == 0) {
+                g_check_cache = 1;
             } else if (strcmp(argv[i], "-w") == 0) {
                 g_ignore_warning = 1;
             } else if (strcmp(argv[i], "-i") == 0) {
@@ -505,7 +512,8 @@ static int is_skip_argument(const char* argv)
 {
     if (strcmp(argv, "-s") == 0 || strcmp(argv, "-m") == 0 ||
         strcmp(argv, "-e") == 0 || strcmp(argv, "-p") == 0 ||
-        strcmp(argv, "-b") == 0 || strcmp(argv, "-f") == 0)
+        strcmp(argv, "-b") == 0 || strcmp(argv, "-f") == 0 ||
+        strcmp(argv, "-j") == 0 || strcmp(argv, "-K") == 0)
         return 1;
     return 0;
 }